@@ -11,7 +11,7 @@
 #include <iostream>
 #include <unordered_map>
 %}
-%module csogmaneo
+%module(directors="1") csogmaneo
 
 %{
 #include "system/SharedLib.h"
@@ -27,16 +27,150 @@
 namespace std {
     %template(vectorf) vector<float>;
     %template(vectorvf) vector<ogmaneo::ValueField2D>;
+    %template(vectorkt) vector<ogmaneo::KernelTiming>;
+    %template(vectorks) vector<ogmaneo::KernelStats>;
+    %template(vectorts) vector<ogmaneo::TransferStats>;
+    %template(vectormu) vector<ogmaneo::MemoryUsage>;
+    %template(vectorms) vector<ogmaneo::MetricStats>;
 };
 
+// Profiling timestamps (KernelTiming), cl2.hpp is not parsed
+typedef unsigned long long cl_ulong;
+
 %include "std_shared_ptr.i"
 %shared_ptr(ogmaneo::Resources)
 %shared_ptr(ogmaneo::ComputeSystem)
 %shared_ptr(ogmaneo::ComputeProgram)
 %shared_ptr(ogmaneo::Hierarchy)
+%shared_ptr(ogmaneo::MetricsSink)
+%shared_ptr(ogmaneo::MetricsAggregator)
+
+// Raw input/output, passed as the address of pinned managed memory.
+// These are wrapped below by float[]/Span<float> overloads that pin with
+// `fixed` for the duration of the (blocking) transfer, so frames go straight
+// from managed memory to OpenCL without proxy objects or element-wise copies.
+// The typemaps only match the PINNED parameters of the methods added below.
+%typemap(ctype) const float* PINNED, float* PINNED "void*"
+%typemap(imtype) const float* PINNED, float* PINNED "global::System.IntPtr"
+%typemap(cstype) const float* PINNED, float* PINNED "global::System.IntPtr"
+%typemap(csin) const float* PINNED, float* PINNED "$csinput"
+%typemap(in) const float* PINNED, float* PINNED %{ $1 = ($1_ltype)$input; %}
+
+%ignore ogmaneo::Hierarchy::writeInputFeed(int, const float*);
+%ignore ogmaneo::Hierarchy::writeInputPredict(int, const float*);
+%ignore ogmaneo::Hierarchy::readPredictions(int, float*);
+%csmethodmodifiers ogmaneo::Hierarchy::writeInputFeedPtr "internal";
+%csmethodmodifiers ogmaneo::Hierarchy::writeInputPredictPtr "internal";
+%csmethodmodifiers ogmaneo::Hierarchy::readPredictionsPtr "internal";
+
+%extend ogmaneo::Hierarchy {
+    void writeInputFeedPtr(int i, const float* PINNED) {
+        $self->writeInputFeed(i, PINNED);
+    }
+
+    void writeInputPredictPtr(int i, const float* PINNED) {
+        $self->writeInputPredict(i, PINNED);
+    }
+
+    void readPredictionsPtr(int i, float* PINNED) {
+        $self->readPredictions(i, PINNED);
+    }
+}
+
+%typemap(cscode) ogmaneo::Hierarchy %{
+  private void checkCount(int count) {
+    if (count != getNumInputs())
+      throw new global::System.ArgumentException("Expected one buffer per input layer (" + getNumInputs() + "), got " + count);
+  }
+
+  private void checkLength(int i, int length) {
+    if (i < 0 || i >= getNumInputs())
+      throw new global::System.ArgumentOutOfRangeException("i");
+
+    // Only an exact length, a longer buffer most likely belongs to another layer (slice a Span otherwise)
+    Vec2i size = getInputSize(i);
+
+    if (length != size.x * size.y)
+      throw new global::System.ArgumentException("Buffer of " + length + " values for input layer " + i + " of " + size.x + "x" + size.y);
+  }
+
+  public unsafe void writeInputFeed(int i, global::System.ReadOnlySpan<float> data) {
+    checkLength(i, data.Length);
+    fixed (float* p = data) {
+      writeInputFeedPtr(i, (global::System.IntPtr)p);
+    }
+  }
+
+  public unsafe void writeInputPredict(int i, global::System.ReadOnlySpan<float> data) {
+    checkLength(i, data.Length);
+    fixed (float* p = data) {
+      writeInputPredictPtr(i, (global::System.IntPtr)p);
+    }
+  }
+
+  public unsafe void readPredictions(int i, global::System.Span<float> data) {
+    checkLength(i, data.Length);
+    fixed (float* p = data) {
+      readPredictionsPtr(i, (global::System.IntPtr)p);
+    }
+  }
+
+  public void activate(float[][] inputsFeed) {
+    checkCount(inputsFeed.Length);
+
+    for (int i = 0; i < inputsFeed.Length; i++)
+      writeInputFeed(i, inputsFeed[i]);
+
+    activate();
+  }
+
+  public void learn(float[][] inputsPredict, float tdError = 0.0f) {
+    checkCount(inputsPredict.Length);
+
+    for (int i = 0; i < inputsPredict.Length; i++)
+      writeInputPredict(i, inputsPredict[i]);
+
+    learn(tdError);
+  }
+
+  public void getPredictions(float[][] predictions) {
+    checkCount(predictions.Length);
+
+    for (int i = 0; i < predictions.Length; i++)
+      readPredictions(i, predictions[i]);
+  }
+%}
 
 %include "system/SharedLib.h"
+
+// Hot path metrics are read through a MetricsAggregator, or a MetricsSink subclassed in the target language
+// (called back from the stepping thread). MetricScope is only used by the instrumentation macros
+%include "stdint.i"
+%feature("director") ogmaneo::MetricsSink;
+%ignore ogmaneo::MetricScope;
+%include "system/Metrics.h"
+
 %include "system/ComputeSystem.h"
 %include "system/ComputeProgram.h"
+
+// Only these types of neo/Helpers.h are part of the interface (Hierarchy::exportInference, memory reports)
+namespace ogmaneo {
+    enum WeightPrecision {
+        _float32 = 0, _float16 = 1, _int8 = 2
+    };
+
+    struct MemoryUsage {
+        std::string _scope;
+        int _layer;
+        size_t _weights;
+        size_t _samples;
+        size_t _states;
+        size_t _temps;
+        size_t _largestImage;
+
+        size_t getTotal() const;
+    };
+}
+
 %include "neo/Hierarchy.h"
 %include "neo/Architect.h"
@@ -10,8 +10,9 @@
 #include <cmath>
 #include <iostream>
 #include <unordered_map>
+#include <stdexcept>
 %}
-%module jogmaneo
+%module(directors="1") jogmaneo
 
 %{
 #include "system/SharedLib.h"
@@ -27,20 +28,132 @@
 namespace std {
     %template(vectorf) vector<float>;
     %template(vectorvf) vector<ogmaneo::ValueField2D>;
+    %template(vectorkt) vector<ogmaneo::KernelTiming>;
+    %template(vectorks) vector<ogmaneo::KernelStats>;
+    %template(vectorts) vector<ogmaneo::TransferStats>;
+    %template(vectormu) vector<ogmaneo::MemoryUsage>;
+    %template(vectorms) vector<ogmaneo::MetricStats>;
 };
 
+// Profiling timestamps (KernelTiming), cl2.hpp is not parsed
+typedef unsigned long long cl_ulong;
+
 %include "std_shared_ptr.i"
 %shared_ptr(ogmaneo::Resources)
 %shared_ptr(ogmaneo::ComputeSystem)
 %shared_ptr(ogmaneo::ComputeProgram)
 %shared_ptr(ogmaneo::Hierarchy)
+%shared_ptr(ogmaneo::MetricsSink)
+%shared_ptr(ogmaneo::MetricsAggregator)
+
+// Handle STL exceptions
+%include "exception.i"
+
+%exception {
+  try {
+    $action
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+}
+
+// Direct (off heap) java.nio.FloatBuffer inputs and outputs.
+// The buffer address is handed straight to OpenCL, so no JNI copy or
+// intermediate std::vector is made. Direct buffers are never moved by the
+// GC, so they stay valid for the duration of the (blocking) transfer.
+// Values are read or written from the position() of the buffer, and at least
+// width * height of them must remain (sliced and offset buffers work as expected).
+%typemap(jni) (const float* DIRECTBUFFER, long long CAPACITY), (float* DIRECTBUFFER, long long CAPACITY) "jobject"
+%typemap(jtype) (const float* DIRECTBUFFER, long long CAPACITY), (float* DIRECTBUFFER, long long CAPACITY) "java.nio.FloatBuffer"
+%typemap(jstype) (const float* DIRECTBUFFER, long long CAPACITY), (float* DIRECTBUFFER, long long CAPACITY) "java.nio.FloatBuffer"
+%typemap(javain, pre="    if (!$javainput.isDirect() || $javainput.order() != java.nio.ByteOrder.nativeOrder())\n      throw new IllegalArgumentException(\"Expected a direct FloatBuffer in native byte order\");") (const float* DIRECTBUFFER, long long CAPACITY), (float* DIRECTBUFFER, long long CAPACITY) "$javainput"
+%typemap(in) (const float* DIRECTBUFFER, long long CAPACITY), (float* DIRECTBUFFER, long long CAPACITY) {
+  $1 = ($1_ltype)JCALL1(GetDirectBufferAddress, jenv, $input);
+
+  if ($1 == NULL || JCALL1(GetDirectBufferCapacity, jenv, $input) < 0) {
+    SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException, "Unable to access FloatBuffer memory, is it direct?");
+    return $null;
+  }
+
+  // The address is that of element 0, the values start at position()
+  jclass bufferClass = JCALL1(FindClass, jenv, "java/nio/Buffer");
+  jmethodID positionMethod = JCALL3(GetMethodID, jenv, bufferClass, "position", "()I");
+  jmethodID remainingMethod = JCALL3(GetMethodID, jenv, bufferClass, "remaining", "()I");
+
+  if (positionMethod == NULL || remainingMethod == NULL)
+    return $null;
+
+  $1 += JCALL2(CallIntMethod, jenv, $input, positionMethod);
+  $2 = (long long)JCALL2(CallIntMethod, jenv, $input, remainingMethod);
+}
+
+%{
+static void checkDirectBuffer(const ogmaneo::Hierarchy* h, int i, long long remaining) {
+    if (i < 0 || i >= h->getNumInputs())
+        throw std::out_of_range("Input index out of range");
+
+    ogmaneo::Vec2i size = h->getInputSize(i);
+
+    if (remaining < static_cast<long long>(size.x) * size.y)
+        throw std::invalid_argument("FloatBuffer has fewer values remaining than the input layer");
+}
+%}
+
+%ignore ogmaneo::Hierarchy::writeInputFeed(int, const float*);
+%ignore ogmaneo::Hierarchy::writeInputPredict(int, const float*);
+%ignore ogmaneo::Hierarchy::readPredictions(int, float*);
+
+%extend ogmaneo::Hierarchy {
+    void writeInputFeed(int i, const float* DIRECTBUFFER, long long CAPACITY) {
+        checkDirectBuffer($self, i, CAPACITY);
+        $self->writeInputFeed(i, DIRECTBUFFER);
+    }
+
+    void writeInputPredict(int i, const float* DIRECTBUFFER, long long CAPACITY) {
+        checkDirectBuffer($self, i, CAPACITY);
+        $self->writeInputPredict(i, DIRECTBUFFER);
+    }
+
+    void readPredictions(int i, float* DIRECTBUFFER, long long CAPACITY) {
+        checkDirectBuffer($self, i, CAPACITY);
+        $self->readPredictions(i, DIRECTBUFFER);
+    }
+}
 
 // Handle operator overloading
 %rename(get) operator();
 
 %include "system/SharedLib.h"
+
+// Hot path metrics are read through a MetricsAggregator, or a MetricsSink subclassed in the target language
+// (called back from the stepping thread). MetricScope is only used by the instrumentation macros
+%include "stdint.i"
+%feature("director") ogmaneo::MetricsSink;
+%ignore ogmaneo::MetricScope;
+%include "system/Metrics.h"
+
 %include "system/ComputeSystem.h"
 %include "system/ComputeProgram.h"
+
+// Only these types of neo/Helpers.h are part of the interface (Hierarchy::exportInference, memory reports)
+namespace ogmaneo {
+    enum WeightPrecision {
+        _float32 = 0, _float16 = 1, _int8 = 2
+    };
+
+    struct MemoryUsage {
+        std::string _scope;
+        int _layer;
+        size_t _weights;
+        size_t _samples;
+        size_t _states;
+        size_t _temps;
+        size_t _largestImage;
+
+        size_t getTotal() const;
+    };
+}
+
 %include "neo/Hierarchy.h"
 %include "neo/Architect.h"
 
@@ -0,0 +1,134 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
+import java.util.Arrays;
+import com.ogmacorp.ogmaneo.*;
+
+/**
+ * Throughput benchmark comparing ValueField2D marshalling against direct FloatBuffers.
+ *
+ * Follows the JMH structure (forked warm up iterations, then timed measurement
+ * iterations, reporting ops/s and per step latency percentiles) without
+ * requiring the JMH harness on the classpath.
+ *
+ * Usage: java Benchmark [inputSize] [warmupIterations] [measureIterations] [stepsPerIteration]
+ */
+public class Benchmark {
+
+    interface Step {
+        void run();
+    }
+
+    static int inputSize = 64;
+    static int warmupIterations = 5;
+    static int measureIterations = 10;
+    static int stepsPerIteration = 100;
+
+    static FloatBuffer allocateDirect(int numFloats) {
+        return ByteBuffer.allocateDirect(numFloats * 4).order(ByteOrder.nativeOrder()).asFloatBuffer();
+    }
+
+    static void measure(String name, Step step) {
+        for (int i = 0; i < warmupIterations; i++)
+            for (int s = 0; s < stepsPerIteration; s++)
+                step.run();
+
+        long[] latencies = new long[measureIterations * stepsPerIteration];
+        double[] opsPerSecond = new double[measureIterations];
+
+        for (int i = 0; i < measureIterations; i++) {
+            long iterationStart = System.nanoTime();
+
+            for (int s = 0; s < stepsPerIteration; s++) {
+                long start = System.nanoTime();
+                step.run();
+                latencies[i * stepsPerIteration + s] = System.nanoTime() - start;
+            }
+
+            opsPerSecond[i] = stepsPerIteration / ((System.nanoTime() - iterationStart) * 1e-9);
+        }
+
+        Arrays.sort(latencies);
+
+        double mean = 0.0;
+        for (double ops : opsPerSecond)
+            mean += ops;
+        mean /= measureIterations;
+
+        double variance = 0.0;
+        for (double ops : opsPerSecond)
+            variance += (ops - mean) * (ops - mean);
+        double error = Math.sqrt(variance / Math.max(1, measureIterations - 1));
+
+        System.out.printf("%-14s %10.1f +- %8.1f ops/s   p50 %8.1f us   p99 %8.1f us%n", name, mean, error,
+            latencies[latencies.length / 2] * 1e-3, latencies[(int)(latencies.length * 0.99)] * 1e-3);
+    }
+
+    public static void main(String[] args) {
+        if (args.length > 0) inputSize = Integer.parseInt(args[0]);
+        if (args.length > 1) warmupIterations = Integer.parseInt(args[1]);
+        if (args.length > 2) measureIterations = Integer.parseInt(args[2]);
+        if (args.length > 3) stepsPerIteration = Integer.parseInt(args[3]);
+
+        Resources res = new Resources();
+        res.create(ComputeSystem.DeviceType._gpu);
+
+        Architect arch = new Architect();
+        arch.initialize(1234, res);
+
+        arch.addInputLayer(new Vec2i(inputSize, inputSize));
+
+        for (int i = 0; i < 2; i++)
+            arch.addHigherLayer(new Vec2i(64, 64), SparseFeaturesType._chunk);
+
+        Hierarchy hierarchy = arch.generateHierarchy();
+
+        int numInputs = inputSize * inputSize;
+
+        // Marshalled path
+        final ValueField2D inputField = new ValueField2D(new Vec2i(inputSize, inputSize));
+
+        for (int y = 0; y < inputSize; y++)
+            for (int x = 0; x < inputSize; x++)
+                inputField.setValue(new Vec2i(x, y), ((x + y) % 4) * 0.25f);
+
+        final vectorvf inputVector = new vectorvf();
+        inputVector.add(inputField);
+
+        // Direct path
+        final FloatBuffer input = allocateDirect(numInputs);
+        final FloatBuffer prediction = allocateDirect(numInputs);
+
+        for (int y = 0; y < inputSize; y++)
+            for (int x = 0; x < inputSize; x++)
+                input.put(x + y * inputSize, ((x + y) % 4) * 0.25f);
+
+        System.out.println("Input " + inputSize + "x" + inputSize + ", " + warmupIterations + " warm up and "
+            + measureIterations + " measured iterations of " + stepsPerIteration + " steps");
+
+        measure("ValueField2D", () -> {
+            hierarchy.activate(inputVector);
+            hierarchy.learn(inputVector);
+
+            ValueField2D p = hierarchy.getPredictions().get(0);
+            p.getValue(new Vec2i(0, 0));
+        });
+
+        measure("FloatBuffer", () -> {
+            hierarchy.writeInputFeed(0, input);
+            hierarchy.activate();
+            hierarchy.readPredictions(0, prediction);
+
+            hierarchy.writeInputPredict(0, input);
+            hierarchy.learn();
+        });
+    }
+}
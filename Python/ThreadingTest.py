@@ -0,0 +1,133 @@
+# ----------------------------------------------------------------------------
+#  OgmaNeo
+#  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+#
+#  This copy of OgmaNeo is licensed to you under the terms described
+#  in the OGMANEO_LICENSE.md file included in this distribution.
+# ----------------------------------------------------------------------------
+
+# -*- coding: utf-8 -*-
+
+""" Steps several hierarchies from separate Python threads and reports scaling """
+
+import sys
+import threading
+import time
+import ogmaneo
+
+numHierarchies = 4
+numSimSteps = 50
+
+if len(sys.argv) > 1:
+    numHierarchies = int(sys.argv[1])
+
+if len(sys.argv) > 2:
+    numSimSteps = int(sys.argv[2])
+
+
+def createHierarchy(seed):
+    # One Resources (and so one command queue) per hierarchy,
+    # programs are cached per Resources and are not shared across threads
+    res = ogmaneo.Resources()
+    res.create(ogmaneo.ComputeSystem._cpu)
+
+    arch = ogmaneo.Architect()
+    arch.initialize(seed, res)
+
+    arch.addInputLayer(ogmaneo.Vec2i(16, 16))
+
+    for l in range(0, 2):
+        arch.addHigherLayer(ogmaneo.Vec2i(48, 48), ogmaneo._chunk)
+
+    inputField = ogmaneo.ValueField2D(ogmaneo.Vec2i(16, 16))
+
+    for y in range(16):
+        for x in range(16):
+            inputField.setValue(ogmaneo.Vec2i(x, y), ((x + y) % 4) * 0.25)
+
+    inputVector = ogmaneo.vectorvf()
+    inputVector.push_back(inputField)
+
+    return res, arch.generateHierarchy(), inputVector
+
+
+def step(hierarchy, inputVector):
+    for i in range(0, numSimSteps):
+        hierarchy.activate(inputVector)
+        hierarchy.learn(inputVector)
+
+
+models = [createHierarchy(1234 + i) for i in range(numHierarchies)]
+
+# Warm up (first enqueues include lazy driver work)
+for res, hierarchy, inputVector in models:
+    hierarchy.activate(inputVector)
+
+# Sequential baseline
+start = time.time()
+for res, hierarchy, inputVector in models:
+    step(hierarchy, inputVector)
+sequentialTime = time.time() - start
+
+threads = [threading.Thread(target=step, args=(hierarchy, inputVector)) for res, hierarchy, inputVector in models]
+
+start = time.time()
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+threadedTime = time.time() - start
+
+speedup = sequentialTime / threadedTime
+
+print("Hierarchies     : " + str(numHierarchies))
+print("Sequential (s)  : {0:.3f}".format(sequentialTime))
+print("Threaded (s)    : {0:.3f}".format(threadedTime))
+print("Speedup         : {0:.2f}x (ideal {1}x)".format(speedup, numHierarchies))
+
+# Overlap check: a pure Python thread records timestamps while this thread steps.
+# With the GIL held for the whole call it can only run between calls,
+# so (almost) none of its timestamps fall inside an activate/learn call.
+res, hierarchy, inputVector = models[0]
+
+ticks = []
+stopTicking = threading.Event()
+
+
+def tick():
+    while not stopTicking.is_set():
+        ticks.append(time.perf_counter())
+
+
+calls = []
+
+ticker = threading.Thread(target=tick)
+ticker.start()
+
+for i in range(0, numSimSteps):
+    callStart = time.perf_counter()
+    hierarchy.activate(inputVector)
+    hierarchy.learn(inputVector)
+    calls.append((callStart, time.perf_counter()))
+
+stopTicking.set()
+ticker.join()
+
+callIndex = 0
+ticksInCalls = 0
+
+for t in ticks:
+    while callIndex < len(calls) and calls[callIndex][1] <= t:
+        callIndex += 1
+
+    if callIndex < len(calls) and calls[callIndex][0] < t:
+        ticksInCalls += 1
+
+ticksPerCall = ticksInCalls / float(len(calls))
+
+print("Ticks per step  : {0:.1f} (other thread progress during activate/learn)".format(ticksPerCall))
+
+# A few ticks can land at the call boundaries even with the GIL held
+assert ticksPerCall > 10.0, "the Python thread made no progress during activate/learn, is the GIL being released?"
+
+print("Done")
@@ -11,7 +11,7 @@
 #include <iostream>
 #include <unordered_map>
 %}
-%module ogmaneo
+%module(threads="1", directors="1") ogmaneo
 
 %{
 #include "system/SharedLib.h"
@@ -27,13 +27,23 @@
 namespace std {
     %template(vectorf) vector<float>;
     %template(vectorvf) vector<ogmaneo::ValueField2D>;
+    %template(vectorkt) vector<ogmaneo::KernelTiming>;
+    %template(vectorks) vector<ogmaneo::KernelStats>;
+    %template(vectorts) vector<ogmaneo::TransferStats>;
+    %template(vectormu) vector<ogmaneo::MemoryUsage>;
+    %template(vectorms) vector<ogmaneo::MetricStats>;
 };
 
+// Profiling timestamps (KernelTiming), cl2.hpp is not parsed
+typedef unsigned long long cl_ulong;
+
 %include "std_shared_ptr.i"
 %shared_ptr(ogmaneo::Resources)
 %shared_ptr(ogmaneo::ComputeSystem)
 %shared_ptr(ogmaneo::ComputeProgram)
 %shared_ptr(ogmaneo::Hierarchy)
+%shared_ptr(ogmaneo::MetricsSink)
+%shared_ptr(ogmaneo::MetricsAggregator)
 
 // Handle STL exceptions
 %include "exception.i"
@@ -67,8 +77,56 @@ namespace std {
  }
 }
 
+// Release the GIL around compute and I/O bound calls only, so that
+// separate hierarchies can be stepped from separate Python threads
+%nothread;
+%thread ogmaneo::Resources::create;
+%thread ogmaneo::Architect::generateHierarchy;
+%thread ogmaneo::Hierarchy::activate;
+%thread ogmaneo::Hierarchy::learn;
+%thread ogmaneo::Hierarchy::readChunkStates;
+%thread ogmaneo::Hierarchy::load;
+%thread ogmaneo::Hierarchy::loadLazy;
+%thread ogmaneo::Hierarchy::loadLazyLayers;
+%thread ogmaneo::Hierarchy::loadLayers;
+%thread ogmaneo::Hierarchy::save;
+%thread ogmaneo::Hierarchy::saveCheckpoint;
+%thread ogmaneo::Hierarchy::saveBaseCheckpoint;
+%thread ogmaneo::Hierarchy::saveDeltaCheckpoint;
+%thread ogmaneo::Hierarchy::exportInference;
+%thread ogmaneo::Hierarchy::clone;
+%thread ogmaneo::Hierarchy::saveTrace;
+
 %include "system/SharedLib.h"
+
+// Hot path metrics are read through a MetricsAggregator, or a MetricsSink subclassed in the target language
+// (called back from the stepping thread). MetricScope is only used by the instrumentation macros
+%include "stdint.i"
+%feature("director") ogmaneo::MetricsSink;
+%ignore ogmaneo::MetricScope;
+%include "system/Metrics.h"
+
 %include "system/ComputeSystem.h"
 %include "system/ComputeProgram.h"
+
+// Only these types of neo/Helpers.h are part of the interface (Hierarchy::exportInference, memory reports)
+namespace ogmaneo {
+    enum WeightPrecision {
+        _float32 = 0, _float16 = 1, _int8 = 2
+    };
+
+    struct MemoryUsage {
+        std::string _scope;
+        int _layer;
+        size_t _weights;
+        size_t _samples;
+        size_t _states;
+        size_t _temps;
+        size_t _largestImage;
+
+        size_t getTotal() const;
+    };
+}
+
 %include "neo/Hierarchy.h"
 %include "neo/Architect.h"
@@ -0,0 +1,242 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// End to end benchmark: builds hierarchies through the Architect over a matrix of configurations,
+// times activate, learn and full steps, and writes the results as JSON
+
+#include "HierarchyBench.h"
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ogmaneo;
+using bench::Config;
+
+namespace {
+    void printUsage(const char* name) {
+        fprintf(stderr, "Usage: %s [options]\n", name);
+        fprintf(stderr, "Lists are comma separated, every combination is run.\n");
+        fprintf(stderr, "  --device <cpu|gpu|all>    OpenCL device type (default cpu)\n");
+        fprintf(stderr, "  --platform <index>        platform index (default last)\n");
+        fprintf(stderr, "  --device-index <index>    device index (default last)\n");
+        fprintf(stderr, "  --input-sizes <list>      width and height of the input layer (default 32)\n");
+        fprintf(stderr, "  --layers <list>           number of higher layers (default 2)\n");
+        fprintf(stderr, "  --encoders <list>         chunk and/or distance (default chunk,distance)\n");
+        fprintf(stderr, "  --radii <list>            encoder and predictor radius (default 6)\n");
+        fprintf(stderr, "  --samples <list>          encoder samples (default 2)\n");
+        fprintf(stderr, "  --chunk-sizes <list>      encoder chunk width and height (default 6)\n");
+        fprintf(stderr, "  --hidden-size <size>      width and height of the higher layers (default 64)\n");
+        fprintf(stderr, "  --warmup <steps>          untimed steps per configuration (default 20)\n");
+        fprintf(stderr, "  --steps <steps>           timed steps per configuration (default 200)\n");
+        fprintf(stderr, "  --seed <seed>             architect seed (default 1234)\n");
+        fprintf(stderr, "  --output <file>           JSON results, - for stdout (default ogmaneo_bench.json)\n");
+        fprintf(stderr, "  --profile                 also record per kernel timings (slows down the steps)\n");
+        fprintf(stderr, "  --metrics                 also record the hot path metrics (built with OGMANEO_INSTRUMENTATION)\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+
+    if (!options.parse(argc, argv, { "help", "profile", "metrics" }) || options.has("help") || !options.getUnknown().empty()) {
+        printUsage(argv[0]);
+        return options.has("help") ? 0 : 1;
+    }
+
+    ComputeSystem::DeviceType deviceType;
+
+    if (!bench::parseDeviceType(options.get("device", "cpu"), deviceType)) {
+        fprintf(stderr, "Unknown device type %s\n", options.get("device", "").c_str());
+        return 1;
+    }
+
+    std::vector<int> inputSizes = options.getInts("input-sizes", { 32 });
+    std::vector<int> layerCounts = options.getInts("layers", { 2 });
+    std::vector<std::string> encoders = options.getStrings("encoders", { "chunk", "distance" });
+    std::vector<int> radii = options.getInts("radii", { 6 });
+    std::vector<int> sampleCounts = options.getInts("samples", { 2 });
+    std::vector<int> chunkSizes = options.getInts("chunk-sizes", { 6 });
+    int hiddenSize = options.getInt("hidden-size", 64);
+    int warmup = options.getInt("warmup", 20);
+    int steps = options.getInt("steps", 200);
+    unsigned int seed = static_cast<unsigned int>(options.getInt("seed", 1234));
+    std::string output = options.get("output", "ogmaneo_bench.json");
+    bool profile = options.has("profile");
+    bool metrics = options.has("metrics");
+
+    std::vector<Config> configs;
+
+    for (int inputSize : inputSizes)
+        for (int numLayers : layerCounts)
+            for (const std::string &encoder : encoders)
+                for (int radius : radii)
+                    for (int numSamples : sampleCounts)
+                        for (int chunkSize : chunkSizes) {
+                            Config config;
+
+                            if (!bench::parseEncoder(encoder, config._encoder)) {
+                                fprintf(stderr, "Unknown encoder %s\n", encoder.c_str());
+                                return 1;
+                            }
+
+                            config._inputSize = inputSize;
+                            config._numLayers = numLayers;
+                            config._radius = radius;
+                            config._numSamples = numSamples;
+                            config._chunkSize = chunkSize;
+                            config._hiddenSize = hiddenSize;
+
+                            configs.push_back(config);
+                        }
+
+    if (configs.empty() || steps <= 0 || warmup < 0) {
+        fprintf(stderr, "Nothing to run\n");
+        return 1;
+    }
+
+    std::shared_ptr<Resources> res = std::make_shared<Resources>(deviceType, options.getInt("platform", -1), options.getInt("device-index", -1));
+
+    ComputeSystem &cs = *res->getComputeSystem();
+
+    if (cs.getDevice()() == nullptr) {
+        fprintf(stderr, "No OpenCL device\n");
+        return 1;
+    }
+
+    bench::JsonWriter json;
+
+    json.beginObject();
+    json.field("benchmark", "ogmaneo_bench");
+    bench::writeDevice(json, cs);
+    json.field("warmupSteps", warmup);
+    json.field("timedSteps", steps);
+    json.field("profiled", profile);
+    json.field("instrumented", metrics);
+    json.key("results").beginArray();
+
+    for (const Config &config : configs) {
+        fprintf(stderr, "input %d, layers %d, %s, radius %d, samples %d, chunk %d ... ",
+            config._inputSize, config._numLayers, bench::encoderName(config._encoder), config._radius, config._numSamples, config._chunkSize);
+
+        bench::RunResult result = bench::run(res, config, seed, warmup, steps, profile, metrics);
+
+        bench::Stats stepStats = bench::computeStats(result._stepMs);
+
+        double stepsPerSecond = result.getStepsPerSecond();
+
+        fprintf(stderr, "%.1f steps/s\n", stepsPerSecond);
+
+        json.beginObject();
+
+        json.key("config").beginObject();
+        json.field("inputSize", config._inputSize);
+        json.field("layers", config._numLayers);
+        json.field("encoder", bench::encoderName(config._encoder));
+        json.field("radius", config._radius);
+        json.field("samples", config._numSamples);
+        json.field("chunkSize", config._chunkSize);
+        json.field("hiddenSize", config._hiddenSize);
+        json.endObject();
+
+        json.field("generateMs", result._generateMs);
+
+        json.key("memory").beginArray();
+
+        for (const MemoryUsage &usage : result._memory) {
+            json.beginObject();
+            json.field("scope", usage._scope);
+            json.field("layer", usage._layer);
+            json.field("weightsBytes", usage._weights);
+            json.field("samplesBytes", usage._samples);
+            json.field("statesBytes", usage._states);
+            json.field("tempsBytes", usage._temps);
+            json.field("totalBytes", usage.getTotal());
+            json.endObject();
+        }
+
+        json.endArray();
+
+        json.stats("activate", bench::computeStats(result._activateMs), "Ms");
+        json.stats("learn", bench::computeStats(result._learnMs), "Ms");
+        json.stats("step", stepStats, "Ms");
+        json.field("stepsPerSecond", stepsPerSecond);
+
+        json.key("transfers").beginArray();
+
+        for (const TransferStats &stats : result._transfers) {
+            json.beginObject();
+            json.field("site", stats._site);
+            json.field("direction", stats._direction == _hostToDevice ? "hostToDevice" : "deviceToHost");
+            json.field("bytes", stats._bytes);
+            json.field("calls", stats._calls);
+            json.field("bytesPerStep", static_cast<double>(stats._bytes) / steps);
+            json.endObject();
+        }
+
+        json.endArray();
+
+        if (profile) {
+            json.key("kernels").beginArray();
+
+            for (const KernelStats &stats : result._kernels) {
+                json.beginObject();
+                json.field("kernel", stats._kernel);
+                json.field("scope", stats._scope);
+                json.field("layer", stats._layer);
+                json.field("count", stats._count);
+                json.field("totalMs", stats._totalMs);
+                json.field("meanMs", stats._totalMs / stats._count);
+                json.field("minMs", stats._minMs);
+                json.field("maxMs", stats._maxMs);
+                json.field("queuedMs", stats._queuedMs);
+                json.field("waitMs", stats._waitMs);
+                json.endObject();
+            }
+
+            json.endArray();
+        }
+
+        if (metrics) {
+            json.key("metrics").beginArray();
+
+            for (const MetricStats &stats : result._metrics) {
+                json.beginObject();
+                json.field("name", stats._name);
+                json.field("scope", stats._scope);
+                json.field("layer", stats._layer);
+                json.field("count", static_cast<size_t>(stats._count));
+                json.field("perStep", static_cast<double>(stats._count) / steps);
+
+                if (stats._timed) {
+                    json.field("totalMs", stats._totalMs);
+                    json.field("meanMs", stats._totalMs / stats._count);
+                    json.field("minMs", stats._minMs);
+                    json.field("maxMs", stats._maxMs);
+                }
+
+                json.endObject();
+            }
+
+            json.endArray();
+        }
+
+        json.endObject();
+    }
+
+    json.endArray();
+    json.endObject();
+
+    if (!json.save(output)) {
+        fprintf(stderr, "Unable to write %s\n", output.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,763 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+// Helpers shared by the benchmark executables: option parsing, timing statistics, JSON output and parsing
+
+#include "system/ComputeSystem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace bench {
+    /*!
+    \brief Wall clock timer
+    */
+    class Stopwatch {
+    private:
+        std::chrono::steady_clock::time_point _start;
+
+    public:
+        Stopwatch()
+            : _start(std::chrono::steady_clock::now())
+        {}
+
+        void reset() {
+            _start = std::chrono::steady_clock::now();
+        }
+
+        /*!
+        \brief Milliseconds since construction or the last reset
+        */
+        double elapsedMs() const {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+        }
+    };
+
+    /*!
+    \brief Summary of a set of samples (in the unit of the samples)
+    */
+    struct Stats {
+        double _mean;
+        double _min;
+        double _max;
+        double _p50;
+        double _p90;
+        double _p99;
+
+        Stats()
+            : _mean(0.0), _min(0.0), _max(0.0), _p50(0.0), _p90(0.0), _p99(0.0)
+        {}
+    };
+
+    /*!
+    \brief Nearest rank percentile of sorted samples, p in [0, 100]
+    */
+    inline double percentile(const std::vector<double> &sorted, double p) {
+        if (sorted.empty())
+            return 0.0;
+
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+    inline Stats computeStats(std::vector<double> samples) {
+        Stats stats;
+
+        if (samples.empty())
+            return stats;
+
+        std::sort(samples.begin(), samples.end());
+
+        double sum = 0.0;
+
+        for (double sample : samples)
+            sum += sample;
+
+        stats._mean = sum / samples.size();
+        stats._min = samples.front();
+        stats._max = samples.back();
+        stats._p50 = percentile(samples, 50.0);
+        stats._p90 = percentile(samples, 90.0);
+        stats._p99 = percentile(samples, 99.0);
+
+        return stats;
+    }
+
+    /*!
+    \brief Minimal streaming JSON writer (objects, arrays, numbers, strings and bools)
+    */
+    class JsonWriter {
+    private:
+        std::ostringstream _os;
+
+        // Whether the innermost open object/array already holds a value
+        std::vector<bool> _hasValue;
+
+        bool _afterKey;
+
+        void separate() {
+            if (_afterKey) {
+                _afterKey = false;
+
+                return;
+            }
+
+            if (!_hasValue.empty()) {
+                if (_hasValue.back())
+                    _os << ",";
+
+                _hasValue.back() = true;
+
+                _os << "\n" << std::string(_hasValue.size() * 2, ' ');
+            }
+        }
+
+        void writeString(const std::string &s) {
+            _os << "\"";
+
+            for (char c : s) {
+                switch (c) {
+                case '"':   _os << "\\\""; break;
+                case '\\':  _os << "\\\\"; break;
+                case '\n':  _os << "\\n"; break;
+                case '\t':  _os << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        _os << escaped;
+                    }
+                    else
+                        _os << c;
+                }
+            }
+
+            _os << "\"";
+        }
+
+        void close(char c) {
+            bool hadValue = _hasValue.back();
+
+            _hasValue.pop_back();
+
+            if (hadValue)
+                _os << "\n" << std::string(_hasValue.size() * 2, ' ');
+
+            _os << c;
+        }
+
+    public:
+        JsonWriter()
+            : _afterKey(false)
+        {
+            _os.precision(9);
+        }
+
+        JsonWriter &beginObject() {
+            separate();
+
+            _os << "{";
+
+            _hasValue.push_back(false);
+
+            return *this;
+        }
+
+        JsonWriter &endObject() {
+            close('}');
+
+            return *this;
+        }
+
+        JsonWriter &beginArray() {
+            separate();
+
+            _os << "[";
+
+            _hasValue.push_back(false);
+
+            return *this;
+        }
+
+        JsonWriter &endArray() {
+            close(']');
+
+            return *this;
+        }
+
+        JsonWriter &key(const std::string &name) {
+            separate();
+
+            writeString(name);
+
+            _os << ": ";
+
+            _afterKey = true;
+
+            return *this;
+        }
+
+        JsonWriter &value(const std::string &s) {
+            separate();
+
+            writeString(s);
+
+            return *this;
+        }
+
+        JsonWriter &value(const char* s) {
+            return value(std::string(s));
+        }
+
+        JsonWriter &value(double x) {
+            separate();
+
+            // JSON has no representation for these
+            if (std::isfinite(x))
+                _os << x;
+            else
+                _os << "null";
+
+            return *this;
+        }
+
+        JsonWriter &value(int x) {
+            separate();
+
+            _os << x;
+
+            return *this;
+        }
+
+        JsonWriter &value(size_t x) {
+            separate();
+
+            _os << x;
+
+            return *this;
+        }
+
+        JsonWriter &value(bool b) {
+            separate();
+
+            _os << (b ? "true" : "false");
+
+            return *this;
+        }
+
+        template<typename T>
+        JsonWriter &field(const std::string &name, const T &x) {
+            return key(name).value(x);
+        }
+
+        /*!
+        \brief Write stats as an object with the given unit suffix on each field (e.g. "_ms")
+        */
+        JsonWriter &stats(const std::string &name, const Stats &s, const std::string &unit) {
+            key(name).beginObject();
+
+            field("mean" + unit, s._mean);
+            field("min" + unit, s._min);
+            field("max" + unit, s._max);
+            field("p50" + unit, s._p50);
+            field("p90" + unit, s._p90);
+            field("p99" + unit, s._p99);
+
+            return endObject();
+        }
+
+        std::string str() const {
+            return _os.str() + "\n";
+        }
+
+        /*!
+        \brief Write to a file, "-" for stdout
+        \return false if the file could not be written.
+        */
+        bool save(const std::string &fileName) const {
+            std::string s = str();
+
+            if (fileName == "-") {
+                fputs(s.c_str(), stdout);
+
+                return true;
+            }
+
+            FILE* file = fopen(fileName.c_str(), "wb");
+
+            if (file == nullptr)
+                return false;
+
+            bool success = fwrite(s.data(), 1, s.size(), file) == s.size();
+
+            return fclose(file) == 0 && success;
+        }
+    };
+
+    /*!
+    \brief Parsed JSON document (objects, arrays, numbers, strings, bools and null), for reading baselines
+    */
+    class JsonValue {
+    public:
+        enum Type {
+            _nullValue, _boolValue, _numberValue, _stringValue, _arrayValue, _objectValue
+        };
+
+    private:
+        Type _type;
+
+        bool _bool;
+        double _number;
+        std::string _string;
+
+        std::vector<JsonValue> _items;
+
+        // In document order
+        std::vector<std::pair<std::string, JsonValue>> _members;
+
+        static void skipSpace(const char* &p) {
+            while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+                p++;
+        }
+
+        static bool parseString(const char* &p, std::string &s) {
+            if (*p != '"')
+                return false;
+
+            p++;
+
+            while (*p != '"') {
+                if (*p == '\0')
+                    return false;
+
+                if (*p != '\\') {
+                    s += *p++;
+
+                    continue;
+                }
+
+                p++;
+
+                switch (*p) {
+                case '"':   s += '"'; break;
+                case '\\':  s += '\\'; break;
+                case '/':   s += '/'; break;
+                case 'b':   s += '\b'; break;
+                case 'f':   s += '\f'; break;
+                case 'n':   s += '\n'; break;
+                case 'r':   s += '\r'; break;
+                case 't':   s += '\t'; break;
+                case 'u':
+                {
+                    // Only what JsonWriter escapes (control characters), other code points become '?'
+                    unsigned int code = 0;
+
+                    for (int i = 1; i <= 4; i++) {
+                        char c = p[i];
+
+                        if (c >= '0' && c <= '9')
+                            code = code * 16 + (c - '0');
+                        else if (c >= 'a' && c <= 'f')
+                            code = code * 16 + (c - 'a' + 10);
+                        else if (c >= 'A' && c <= 'F')
+                            code = code * 16 + (c - 'A' + 10);
+                        else
+                            return false;
+                    }
+
+                    s += code < 0x80 ? static_cast<char>(code) : '?';
+
+                    p += 4;
+
+                    break;
+                }
+                default:
+                    return false;
+                }
+
+                p++;
+            }
+
+            p++;
+
+            return true;
+        }
+
+        static bool parseValue(const char* &p, JsonValue &value, int depth) {
+            if (depth > 64)
+                return false;
+
+            skipSpace(p);
+
+            if (*p == '{') {
+                value._type = _objectValue;
+
+                p++;
+                skipSpace(p);
+
+                if (*p == '}') {
+                    p++;
+
+                    return true;
+                }
+
+                for (;;) {
+                    std::pair<std::string, JsonValue> member;
+
+                    skipSpace(p);
+
+                    if (!parseString(p, member.first))
+                        return false;
+
+                    skipSpace(p);
+
+                    if (*p++ != ':' || !parseValue(p, member.second, depth + 1))
+                        return false;
+
+                    value._members.push_back(member);
+
+                    skipSpace(p);
+
+                    if (*p == '}') {
+                        p++;
+
+                        return true;
+                    }
+
+                    if (*p++ != ',')
+                        return false;
+                }
+            }
+
+            if (*p == '[') {
+                value._type = _arrayValue;
+
+                p++;
+                skipSpace(p);
+
+                if (*p == ']') {
+                    p++;
+
+                    return true;
+                }
+
+                for (;;) {
+                    value._items.push_back(JsonValue());
+
+                    if (!parseValue(p, value._items.back(), depth + 1))
+                        return false;
+
+                    skipSpace(p);
+
+                    if (*p == ']') {
+                        p++;
+
+                        return true;
+                    }
+
+                    if (*p++ != ',')
+                        return false;
+                }
+            }
+
+            if (*p == '"') {
+                value._type = _stringValue;
+
+                return parseString(p, value._string);
+            }
+
+            if (strncmp(p, "null", 4) == 0) {
+                p += 4;
+
+                return true;
+            }
+
+            if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+                value._type = _boolValue;
+                value._bool = *p == 't';
+
+                p += value._bool ? 4 : 5;
+
+                return true;
+            }
+
+            char* end;
+
+            value._type = _numberValue;
+            value._number = strtod(p, &end);
+
+            if (end == p)
+                return false;
+
+            p = end;
+
+            return true;
+        }
+
+        static const JsonValue &getNull() {
+            static const JsonValue null;
+
+            return null;
+        }
+
+    public:
+        JsonValue()
+            : _type(_nullValue), _bool(false), _number(0.0)
+        {}
+
+        /*!
+        \brief Parse a document
+        \return false if text is not valid JSON.
+        */
+        static bool parse(const std::string &text, JsonValue &value) {
+            const char* p = text.c_str();
+
+            value = JsonValue();
+
+            if (!parseValue(p, value, 0))
+                return false;
+
+            skipSpace(p);
+
+            return *p == '\0';
+        }
+
+        /*!
+        \brief Parse a file
+        \return false if the file could not be read or is not valid JSON.
+        */
+        static bool load(const std::string &fileName, JsonValue &value) {
+            std::ifstream is(fileName, std::ios::binary);
+
+            if (!is.is_open())
+                return false;
+
+            std::stringstream ss;
+            ss << is.rdbuf();
+
+            return parse(ss.str(), value);
+        }
+
+        Type getType() const {
+            return _type;
+        }
+
+        bool isNull() const {
+            return _type == _nullValue;
+        }
+
+        //!@{
+        /*!
+        \brief Value, or defaultValue if of another type
+        */
+        double getNumber(double defaultValue = 0.0) const {
+            return _type == _numberValue ? _number : defaultValue;
+        }
+
+        int getInt(int defaultValue = 0) const {
+            return _type == _numberValue ? static_cast<int>(_number) : defaultValue;
+        }
+
+        bool getBool(bool defaultValue = false) const {
+            return _type == _boolValue ? _bool : defaultValue;
+        }
+
+        std::string getString(const std::string &defaultValue = "") const {
+            return _type == _stringValue ? _string : defaultValue;
+        }
+        //!@}
+
+        /*!
+        \brief Array items (empty if not an array)
+        */
+        const std::vector<JsonValue> &getItems() const {
+            return _items;
+        }
+
+        /*!
+        \brief Object members (empty if not an object)
+        */
+        const std::vector<std::pair<std::string, JsonValue>> &getMembers() const {
+            return _members;
+        }
+
+        bool has(const std::string &name) const {
+            for (const std::pair<std::string, JsonValue> &member : _members) {
+                if (member.first == name)
+                    return true;
+            }
+
+            return false;
+        }
+
+        /*!
+        \brief Member of an object, a null value if missing
+        */
+        const JsonValue &operator[](const std::string &name) const {
+            for (const std::pair<std::string, JsonValue> &member : _members) {
+                if (member.first == name)
+                    return member.second;
+            }
+
+            return getNull();
+        }
+    };
+
+    /*!
+    \brief Command line options of the form --name value
+    */
+    class Options {
+    private:
+        std::vector<std::pair<std::string, std::string>> _values;
+        std::vector<std::string> _unknown;
+
+    public:
+        /*!
+        \brief Parse argv, flags listed in boolFlags take no value
+        \return false if an option is missing its value.
+        */
+        bool parse(int argc, char* argv[], const std::vector<std::string> &boolFlags = std::vector<std::string>()) {
+            for (int i = 1; i < argc; i++) {
+                std::string arg(argv[i]);
+
+                if (arg.size() < 3 || arg.compare(0, 2, "--") != 0) {
+                    _unknown.push_back(arg);
+
+                    continue;
+                }
+
+                std::string name = arg.substr(2);
+
+                if (std::find(boolFlags.begin(), boolFlags.end(), name) != boolFlags.end()) {
+                    _values.push_back(std::make_pair(name, std::string("1")));
+
+                    continue;
+                }
+
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "Missing value for %s\n", arg.c_str());
+
+                    return false;
+                }
+
+                _values.push_back(std::make_pair(name, std::string(argv[++i])));
+            }
+
+            return true;
+        }
+
+        bool has(const std::string &name) const {
+            for (const std::pair<std::string, std::string> &v : _values) {
+                if (v.first == name)
+                    return true;
+            }
+
+            return false;
+        }
+
+        std::string get(const std::string &name, const std::string &defaultValue) const {
+            // Last occurrence wins
+            for (size_t i = _values.size(); i > 0; i--) {
+                if (_values[i - 1].first == name)
+                    return _values[i - 1].second;
+            }
+
+            return defaultValue;
+        }
+
+        int getInt(const std::string &name, int defaultValue) const {
+            return has(name) ? std::stoi(get(name, "")) : defaultValue;
+        }
+
+        float getFloat(const std::string &name, float defaultValue) const {
+            return has(name) ? std::stof(get(name, "")) : defaultValue;
+        }
+
+        /*!
+        \brief Comma separated list of ints
+        */
+        std::vector<int> getInts(const std::string &name, const std::vector<int> &defaultValues) const {
+            if (!has(name))
+                return defaultValues;
+
+            std::vector<int> values;
+            std::istringstream is(get(name, ""));
+            std::string item;
+
+            while (std::getline(is, item, ','))
+                values.push_back(std::stoi(item));
+
+            return values;
+        }
+
+        /*!
+        \brief Comma separated list of strings
+        */
+        std::vector<std::string> getStrings(const std::string &name, const std::vector<std::string> &defaultValues) const {
+            if (!has(name))
+                return defaultValues;
+
+            std::vector<std::string> values;
+            std::istringstream is(get(name, ""));
+            std::string item;
+
+            while (std::getline(is, item, ','))
+                values.push_back(item);
+
+            return values;
+        }
+
+        const std::vector<std::string> &getUnknown() const {
+            return _unknown;
+        }
+    };
+
+    /*!
+    \brief Parse a device type name (cpu, gpu or all)
+    \return false if the name is unknown.
+    */
+    inline bool parseDeviceType(const std::string &name, ogmaneo::ComputeSystem::DeviceType &type) {
+        if (name == "cpu")
+            type = ogmaneo::ComputeSystem::_cpu;
+        else if (name == "gpu")
+            type = ogmaneo::ComputeSystem::_gpu;
+        else if (name == "all")
+            type = ogmaneo::ComputeSystem::_all;
+        else
+            return false;
+
+        return true;
+    }
+
+    /*!
+    \brief Write the platform and device in use
+    */
+    inline void writeDevice(JsonWriter &json, ogmaneo::ComputeSystem &cs) {
+        json.key("device").beginObject();
+
+        json.field("platform", cs.getPlatform().getInfo<CL_PLATFORM_NAME>());
+        json.field("name", cs.getDevice().getInfo<CL_DEVICE_NAME>());
+        json.field("version", cs.getDevice().getInfo<CL_DEVICE_VERSION>());
+        json.field("computeUnits", static_cast<int>(cs.getDevice().getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>()));
+        json.field("globalMemBytes", static_cast<size_t>(cs.getDevice().getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>()));
+        json.field("maxAllocBytes", static_cast<size_t>(cs.getDevice().getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>()));
+
+        json.endObject();
+    }
+}
@@ -0,0 +1,284 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+// Hierarchy configurations and the timed step loop shared by the benchmarks
+
+#include "BenchUtils.h"
+
+#include "neo/Architect.h"
+#include "neo/Hierarchy.h"
+
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace bench {
+    /*!
+    \brief A hierarchy built through the Architect, with the same parameters on all higher layers
+    */
+    struct Config {
+        int _inputSize;
+        int _numLayers;
+        ogmaneo::SparseFeaturesType _encoder;
+        int _radius;
+
+        /*!
+        \brief Feed forward samples of the encoders, 0 keeps the default of the Architect
+        */
+        int _numSamples;
+
+        int _chunkSize;
+        int _hiddenSize;
+
+        /*!
+        \brief Encoder of each higher layer, bottom first, replaces _numLayers and _encoder if not empty
+        */
+        std::vector<ogmaneo::SparseFeaturesType> _encoders;
+
+        Config()
+            : _inputSize(32), _numLayers(2), _encoder(ogmaneo::_chunk), _radius(6), _numSamples(2), _chunkSize(6), _hiddenSize(64)
+        {}
+
+        std::vector<ogmaneo::SparseFeaturesType> getEncoders() const {
+            return _encoders.empty() ? std::vector<ogmaneo::SparseFeaturesType>(_numLayers, _encoder) : _encoders;
+        }
+    };
+
+    inline const char* encoderName(ogmaneo::SparseFeaturesType type) {
+        return type == ogmaneo::_chunk ? "chunk" : "distance";
+    }
+
+    /*!
+    \brief Parse an encoder name (chunk or distance)
+    \return false if the name is unknown.
+    */
+    inline bool parseEncoder(const std::string &name, ogmaneo::SparseFeaturesType &type) {
+        if (name == "chunk")
+            type = ogmaneo::_chunk;
+        else if (name == "distance")
+            type = ogmaneo::_distance;
+        else
+            return false;
+
+        return true;
+    }
+
+    /*!
+    \brief Encoder names joined by +, bottom first
+    */
+    inline std::string encodersName(const std::vector<ogmaneo::SparseFeaturesType> &encoders) {
+        std::string name;
+
+        for (size_t l = 0; l < encoders.size(); l++)
+            name += (l == 0 ? "" : "+") + std::string(encoderName(encoders[l]));
+
+        return name;
+    }
+
+    /*!
+    \brief Parse encoder names joined by +
+    \return false if one is unknown or there are none.
+    */
+    inline bool parseEncoders(const std::string &name, std::vector<ogmaneo::SparseFeaturesType> &encoders) {
+        std::istringstream is(name);
+        std::string item;
+
+        while (std::getline(is, item, '+')) {
+            ogmaneo::SparseFeaturesType type;
+
+            if (!parseEncoder(item, type))
+                return false;
+
+            encoders.push_back(type);
+        }
+
+        return !encoders.empty();
+    }
+
+    inline std::string encoderPrefix(ogmaneo::SparseFeaturesType type) {
+        return type == ogmaneo::_chunk ? "sfc" : "sfd";
+    }
+
+    inline std::shared_ptr<ogmaneo::Hierarchy> generate(const std::shared_ptr<ogmaneo::Resources> &res, const Config &config, unsigned int seed) {
+        std::vector<ogmaneo::SparseFeaturesType> encoders = config.getEncoders();
+
+        ogmaneo::Architect arch;
+        arch.initialize(seed, res);
+
+        // Parameters of the first encoder onto the input are set on the input layer
+        std::string inputPrefix = encoderPrefix(encoders.empty() ? config._encoder : encoders.front());
+
+        ogmaneo::ParameterModifier input = arch.addInputLayer(ogmaneo::Vec2i(config._inputSize, config._inputSize));
+
+        input.setValue(inputPrefix + "_ff_radius", std::to_string(config._radius));
+
+        if (config._numSamples > 0)
+            input.setValue(inputPrefix + "_ff_numSamples", std::to_string(config._numSamples));
+
+        for (ogmaneo::SparseFeaturesType type : encoders) {
+            std::string prefix = encoderPrefix(type);
+
+            ogmaneo::ParameterModifier layer = arch.addHigherLayer(ogmaneo::Vec2i(config._hiddenSize, config._hiddenSize), type);
+
+            layer.setValue(prefix + "_chunkSize", ogmaneo::Vec2i(config._chunkSize, config._chunkSize))
+                .setValue(prefix + "_ff_radius", std::to_string(config._radius))
+                .setValue("p_radius", std::to_string(config._radius));
+
+            if (config._numSamples > 0)
+                layer.setValue(prefix + "_ff_numSamples", std::to_string(config._numSamples));
+        }
+
+        return arch.generateHierarchy();
+    }
+
+    /*!
+    \brief Timings of one configuration
+    */
+    struct RunResult {
+        double _generateMs;
+
+        //!@{
+        /*!
+        \brief Per timed step, activate includes the input write and the prediction readback
+        _stepMs is timed on its own, from the input write to the end of learn, rather than summed.
+        */
+        std::vector<double> _activateMs;
+        std::vector<double> _learnMs;
+        std::vector<double> _stepMs;
+        //!@}
+
+        /*!
+        \brief Of the timed steps only (kernels only if profiled)
+        */
+        std::vector<ogmaneo::TransferStats> _transfers;
+        std::vector<ogmaneo::KernelStats> _kernels;
+
+        std::vector<ogmaneo::MemoryUsage> _memory;
+
+        /*!
+        \brief Hot path metrics of the timed steps, if recorded (empty without OGMANEO_INSTRUMENTATION)
+        */
+        std::vector<ogmaneo::MetricStats> _metrics;
+
+        RunResult()
+            : _generateMs(0.0)
+        {}
+
+        double getStepsPerSecond() const {
+            Stats stats = computeStats(_stepMs);
+
+            return stats._mean > 0.0 ? 1000.0 / stats._mean : 0.0;
+        }
+    };
+
+    /*!
+    \brief Generate the hierarchy of config and time warmup + steps steps on a few frames of a moving wave
+    \param profile also record per kernel timings (slows down the steps).
+    \param metrics also record the hot path metrics of the neo layers.
+    */
+    inline RunResult run(const std::shared_ptr<ogmaneo::Resources> &res, const Config &config, unsigned int seed, int warmup, int steps, bool profile, bool metrics = false) {
+        ogmaneo::ComputeSystem &cs = *res->getComputeSystem();
+
+        RunResult result;
+
+        Stopwatch generateWatch;
+
+        std::shared_ptr<ogmaneo::Hierarchy> h = generate(res, config, seed);
+
+        cs.getQueue().finish();
+
+        result._generateMs = generateWatch.elapsedMs();
+
+        result._memory = h->getMemoryUsage();
+
+        h->setProfiling(profile);
+
+        std::shared_ptr<ogmaneo::MetricsAggregator> aggregator;
+
+        if (metrics) {
+            aggregator = std::make_shared<ogmaneo::MetricsAggregator>();
+
+            h->setMetricsSink(aggregator);
+        }
+
+        // Generated up front so the timed loop only steps
+        const int numFrames = 16;
+
+        std::vector<std::vector<ogmaneo::ValueField2D>> frames(numFrames);
+
+        for (int f = 0; f < numFrames; f++) {
+            ogmaneo::ValueField2D frame(ogmaneo::Vec2i(config._inputSize, config._inputSize));
+
+            for (int y = 0; y < config._inputSize; y++)
+                for (int x = 0; x < config._inputSize; x++)
+                    frame.setValue(ogmaneo::Vec2i(x, y), 0.5f + 0.5f * std::sin(0.3f * x + 0.2f * y + 0.4f * f));
+
+            frames[f].push_back(frame);
+        }
+
+        for (int s = 0; s < warmup + steps; s++) {
+            std::vector<ogmaneo::ValueField2D> &frame = frames[s % numFrames];
+
+            // Only count the timed steps
+            if (s == warmup) {
+                h->resetTransferStats();
+
+                if (profile)
+                    h->resetKernelStats();
+
+                if (metrics)
+                    aggregator->reset();
+            }
+
+            // The whole step as an application sees it, from the input writes to the end of learn
+            Stopwatch stepWatch;
+            Stopwatch watch;
+
+            // Writes the inputs and blocks on the prediction readback
+            h->activate(frame);
+
+            double a = watch.elapsedMs();
+
+            watch.reset();
+
+            h->learn(frame);
+
+            cs.getQueue().finish();
+
+            double l = watch.elapsedMs();
+
+            double stepMs = stepWatch.elapsedMs();
+
+            if (s >= warmup) {
+                result._activateMs.push_back(a);
+                result._learnMs.push_back(l);
+                result._stepMs.push_back(stepMs);
+            }
+        }
+
+        result._transfers = h->getTransferStats();
+
+        if (profile) {
+            result._kernels = h->getKernelStats();
+
+            h->setProfiling(false);
+        }
+
+        if (metrics) {
+            result._metrics = aggregator->getMetrics();
+
+            h->setMetricsSink(nullptr);
+        }
+
+        return result;
+    }
+}
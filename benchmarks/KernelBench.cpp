@@ -0,0 +1,607 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Kernel microbenchmarks: runs single encoder and predictor kernels on synthetic images, outside of any
+// hierarchy, over a sweep of sizes, radii, samples and chunk sizes. Kernel times come from OpenCL profiling
+// events, and effective bandwidth and FLOP rates from the memory accesses and arithmetic in the kernel source
+// (image reads and writes that are in bounds, ignoring caches)
+
+#include "BenchUtils.h"
+
+#include "neo/Helpers.h"
+#include "system/ComputeProgram.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace ogmaneo;
+
+namespace {
+    struct Params {
+        int _hiddenSize;
+        int _visibleSize;
+        int _radius;
+        int _numSamples;
+        int _chunkSize;
+    };
+
+    /*!
+    \brief A kernel with its arguments set, ready to be enqueued
+    */
+    struct Launch {
+        cl::Kernel _kernel;
+        cl::NDRange _range;
+
+        // Arguments are not retained by every implementation
+        std::vector<cl::Memory> _memory;
+
+        double _bytes;
+        double _flops;
+
+        Launch()
+            : _bytes(0.0), _flops(0.0)
+        {}
+    };
+
+    struct Programs {
+        ComputeProgram _chunk;
+        ComputeProgram _distance;
+        ComputeProgram _predictor;
+    };
+
+    struct KernelDesc {
+        std::string _name;
+
+        // Which parameters change the work of the kernel, others are not swept.
+        // All kernels below tile or project through chunks, so all of them use the chunk size
+        bool _usesVisible;
+        bool _usesRadius;
+        bool _usesSamples;
+        bool _usesChunkSize;
+
+        std::function<Launch(ComputeSystem &, Programs &, const Params &, std::mt19937 &)> _create;
+    };
+
+    const int floatSize = sizeof(cl_float);
+
+    int numChunks(int size, int chunkSize) {
+        return static_cast<int>(std::ceil(static_cast<float>(size) / static_cast<float>(chunkSize)));
+    }
+
+    // Same as project in neoKernelsCommon.cl
+    int project(int position, float toScalar) {
+        return static_cast<int>((position + 0.5f) * toScalar + 0.5f);
+    }
+
+    /*!
+    \brief In bounds taps of the (2 radius + 1)^2 fields around project(hidden / chunkSize), summed over all hidden units
+    */
+    double countFieldTaps(const Params &p, float toVisible) {
+        // Bounds are separable, so count per axis
+        double taps = 0.0;
+
+        for (int h = 0; h < p._hiddenSize; h++) {
+            int center = project(h / p._chunkSize, toVisible);
+
+            taps += std::max(0, std::min(p._visibleSize - 1, center + p._radius) - std::max(0, center - p._radius) + 1);
+        }
+
+        return taps * taps;
+    }
+
+    cl::Image2D createImage2D(ComputeSystem &cs, int width, int height, cl_channel_order order, cl::Kernel &randomKernel, std::mt19937 &rng) {
+        cl::Image2D image(cs.getContext(), CL_MEM_READ_WRITE, cl::ImageFormat(order, CL_FLOAT), width, height);
+
+        randomUniform(image, cs, randomKernel, { width, height }, { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 0.0f }, rng);
+
+        return image;
+    }
+
+    cl::Image3D createImage3D(ComputeSystem &cs, int width, int height, int depth, cl::Kernel &randomKernel, std::mt19937 &rng) {
+        cl::Image3D image(cs.getContext(), CL_MEM_READ_WRITE, cl::ImageFormat(CL_R, CL_FLOAT), width, height, depth);
+
+        randomUniform(image, cs, randomKernel, { width, height, depth }, { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 0.0f }, rng);
+
+        return image;
+    }
+
+    Launch createStimulus(ComputeSystem &cs, ComputeProgram &program, const char* name, int flopsPerTap, const Params &p, std::mt19937 &rng) {
+        cl::Kernel random2D(program.getProgram(), "randomUniform2D");
+        cl::Kernel random3D(program.getProgram(), "randomUniform3D");
+
+        int weightDiam = p._radius * 2 + 1;
+        int chunks = numChunks(p._hiddenSize, p._chunkSize);
+
+        cl_float2 chunkToVisible = { static_cast<float>(p._visibleSize) / chunks, static_cast<float>(p._visibleSize) / chunks };
+
+        cl::Image3D samples = createImage3D(cs, p._visibleSize, p._visibleSize, p._numSamples, random3D, rng);
+        cl::Image2D sumBack = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_R, random2D, rng);
+        cl::Image2D sumFront = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_R, random2D, rng);
+        cl::Image3D weights = createImage3D(cs, p._hiddenSize, p._hiddenSize, weightDiam * weightDiam * p._numSamples, random3D, rng);
+
+        Launch launch;
+
+        launch._kernel = cl::Kernel(program.getProgram(), name);
+
+        int argIndex = 0;
+
+        launch._kernel.setArg(argIndex++, samples);
+        launch._kernel.setArg(argIndex++, sumBack);
+        launch._kernel.setArg(argIndex++, sumFront);
+        launch._kernel.setArg(argIndex++, weights);
+        launch._kernel.setArg(argIndex++, cl_int2{ p._visibleSize, p._visibleSize });
+        launch._kernel.setArg(argIndex++, chunkToVisible);
+        launch._kernel.setArg(argIndex++, cl_int2{ p._chunkSize, p._chunkSize });
+        launch._kernel.setArg(argIndex++, p._radius);
+        launch._kernel.setArg(argIndex++, p._numSamples);
+        launch._kernel.setArg(argIndex++, static_cast<cl_uchar>(0));
+
+        launch._range = cl::NDRange(p._hiddenSize, p._hiddenSize);
+        launch._memory = { samples, sumBack, sumFront, weights };
+
+        double hidden = static_cast<double>(p._hiddenSize) * p._hiddenSize;
+        double taps = countFieldTaps(p, chunkToVisible.x) * p._numSamples;
+
+        // Summation read and write, weight and sample per tap
+        launch._bytes = hidden * 2 * floatSize + taps * 2 * floatSize;
+        launch._flops = taps * flopsPerTap;
+
+        return launch;
+    }
+
+    Launch createLearnWeights(ComputeSystem &cs, ComputeProgram &program, const char* name, bool distance, const Params &p, std::mt19937 &rng) {
+        cl::Kernel random2D(program.getProgram(), "randomUniform2D");
+        cl::Kernel random3D(program.getProgram(), "randomUniform3D");
+
+        int weightDiam = p._radius * 2 + 1;
+        int chunks = numChunks(p._hiddenSize, p._chunkSize);
+
+        cl_float2 chunkToVisible = { static_cast<float>(p._visibleSize) / chunks, static_cast<float>(p._visibleSize) / chunks };
+
+        cl::Image2D chunkWinners = createImage2D(cs, chunks, chunks, CL_RG, random2D, rng);
+        cl::Image2D hiddenStates = createImage2D(cs, p._hiddenSize, p._hiddenSize, distance ? CL_RG : CL_R, random2D, rng);
+        cl::Image3D samples = createImage3D(cs, p._visibleSize, p._visibleSize, p._numSamples, random3D, rng);
+        cl::Image3D weightsBack = createImage3D(cs, p._hiddenSize, p._hiddenSize, weightDiam * weightDiam * p._numSamples, random3D, rng);
+        cl::Image3D weightsFront = createImage3D(cs, p._hiddenSize, p._hiddenSize, weightDiam * weightDiam * p._numSamples, random3D, rng);
+
+        Launch launch;
+
+        launch._kernel = cl::Kernel(program.getProgram(), name);
+
+        int argIndex = 0;
+
+        launch._kernel.setArg(argIndex++, chunkWinners);
+        launch._kernel.setArg(argIndex++, hiddenStates);
+        launch._kernel.setArg(argIndex++, samples);
+        launch._kernel.setArg(argIndex++, weightsBack);
+        launch._kernel.setArg(argIndex++, weightsFront);
+        launch._kernel.setArg(argIndex++, cl_int2{ p._hiddenSize, p._hiddenSize });
+        launch._kernel.setArg(argIndex++, cl_int2{ p._visibleSize, p._visibleSize });
+        launch._kernel.setArg(argIndex++, chunkToVisible);
+        launch._kernel.setArg(argIndex++, cl_int2{ p._chunkSize, p._chunkSize });
+        launch._kernel.setArg(argIndex++, p._radius);
+        launch._kernel.setArg(argIndex++, 0.01f);
+        launch._kernel.setArg(argIndex++, p._numSamples);
+
+        if (!distance)
+            launch._kernel.setArg(argIndex++, 0.0001f);
+
+        launch._range = cl::NDRange(p._hiddenSize, p._hiddenSize);
+        launch._memory = { chunkWinners, hiddenStates, samples, weightsBack, weightsFront };
+
+        double hidden = static_cast<double>(p._hiddenSize) * p._hiddenSize;
+        double taps = countFieldTaps(p, chunkToVisible.x) * p._numSamples;
+
+        // Chunk winner (RG) and trace (distance) per unit, previous weight, sample and new weight per tap
+        launch._bytes = hidden * (distance ? 4 : 2) * floatSize + taps * 3 * floatSize;
+        launch._flops = taps * (distance ? 4 : 5);
+
+        return launch;
+    }
+
+    Launch createInhibit(ComputeSystem &cs, ComputeProgram &program, const char* name, int kind, const Params &p, std::mt19937 &rng) {
+        // kind 0: sfcInhibit, 1: sfdInhibit, 2: plInhibitBinary
+        cl::Kernel random2D(program.getProgram(), "randomUniform2D");
+
+        int chunks = numChunks(p._hiddenSize, p._chunkSize);
+
+        cl::Image2D activations = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_R, random2D, rng);
+        cl::Image2D statesBack = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_RG, random2D, rng);
+        cl::Image2D statesFront = createImage2D(cs, p._hiddenSize, p._hiddenSize, kind == 0 ? CL_R : CL_RG, random2D, rng);
+        cl::Image2D chunkWinners = createImage2D(cs, chunks, chunks, CL_RG, random2D, rng);
+
+        Launch launch;
+
+        launch._kernel = cl::Kernel(program.getProgram(), name);
+
+        int argIndex = 0;
+
+        launch._kernel.setArg(argIndex++, activations);
+
+        if (kind == 1)
+            launch._kernel.setArg(argIndex++, statesBack);
+
+        launch._kernel.setArg(argIndex++, statesFront);
+
+        if (kind != 2)
+            launch._kernel.setArg(argIndex++, chunkWinners);
+
+        launch._kernel.setArg(argIndex++, cl_int2{ p._hiddenSize, p._hiddenSize });
+        launch._kernel.setArg(argIndex++, cl_int2{ p._chunkSize, p._chunkSize });
+
+        if (kind == 1)
+            launch._kernel.setArg(argIndex++, 0.9999f);
+
+        launch._range = cl::NDRange(chunks, chunks);
+        launch._memory = { activations, statesBack, statesFront, chunkWinners };
+
+        double hidden = static_cast<double>(p._hiddenSize) * p._hiddenSize;
+        double numChunksTotal = static_cast<double>(chunks) * chunks;
+
+        switch (kind) {
+        case 0:
+            // Activation read, state write, winner write
+            launch._bytes = hidden * 2 * floatSize + numChunksTotal * 2 * floatSize;
+            launch._flops = hidden;
+            break;
+        case 1:
+            // Activation read, trace read, state and trace write, winner write
+            launch._bytes = hidden * 5 * floatSize + numChunksTotal * 2 * floatSize;
+            launch._flops = hidden * 3;
+            break;
+        default:
+            // Activation read twice, state and activation write
+            launch._bytes = hidden * 4 * floatSize;
+            launch._flops = hidden;
+            break;
+        }
+
+        return launch;
+    }
+
+    Launch createPredictorStimulus(ComputeSystem &cs, ComputeProgram &program, const Params &p, std::mt19937 &rng) {
+        cl::Kernel random2D(program.getProgram(), "randomUniform2D");
+        cl::Kernel random3D(program.getProgram(), "randomUniform3D");
+
+        int weightDiam = p._radius * 2 + 1;
+        int chunks = numChunks(p._hiddenSize, p._chunkSize);
+
+        // As in PredictorLayer::createRandom
+        cl_float2 hiddenToVisible = { static_cast<float>(p._visibleSize) / chunks, static_cast<float>(p._visibleSize) / chunks };
+
+        cl::Image2D visibleStates = createImage2D(cs, p._visibleSize, p._visibleSize, CL_RG, random2D, rng);
+        cl::Image2D sumBack = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_R, random2D, rng);
+        cl::Image2D sumFront = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_R, random2D, rng);
+        cl::Image3D weights = createImage3D(cs, p._hiddenSize, p._hiddenSize, weightDiam * weightDiam, random3D, rng);
+
+        Launch launch;
+
+        launch._kernel = cl::Kernel(program.getProgram(), "plStimulus");
+
+        int argIndex = 0;
+
+        launch._kernel.setArg(argIndex++, visibleStates);
+        launch._kernel.setArg(argIndex++, sumBack);
+        launch._kernel.setArg(argIndex++, sumFront);
+        launch._kernel.setArg(argIndex++, weights);
+        launch._kernel.setArg(argIndex++, cl_int2{ p._visibleSize, p._visibleSize });
+        launch._kernel.setArg(argIndex++, hiddenToVisible);
+        launch._kernel.setArg(argIndex++, p._radius);
+        launch._kernel.setArg(argIndex++, cl_int2{ p._chunkSize, p._chunkSize });
+
+        launch._range = cl::NDRange(p._hiddenSize, p._hiddenSize);
+        launch._memory = { visibleStates, sumBack, sumFront, weights };
+
+        double hidden = static_cast<double>(p._hiddenSize) * p._hiddenSize;
+        double taps = countFieldTaps(p, hiddenToVisible.x);
+
+        launch._bytes = hidden * 2 * floatSize + taps * 2 * floatSize;
+        launch._flops = taps * 2;
+
+        return launch;
+    }
+
+    Launch createPropagate(ComputeSystem &cs, ComputeProgram &program, const Params &p, std::mt19937 &rng) {
+        cl::Kernel random2D(program.getProgram(), "randomUniform2D");
+        cl::Kernel random3D(program.getProgram(), "randomUniform3D");
+
+        int weightDiam = p._radius * 2 + 1;
+        int chunks = numChunks(p._hiddenSize, p._chunkSize);
+
+        // As in PredictorLayer::createRandom
+        cl_float2 hiddenToVisible = { static_cast<float>(p._visibleSize) / chunks, static_cast<float>(p._visibleSize) / chunks };
+        cl_float2 visibleToHidden = { static_cast<float>(chunks) / p._visibleSize, static_cast<float>(chunks) / p._visibleSize };
+
+        cl_int2 reverseRadii = { static_cast<cl_int>(std::ceil(visibleToHidden.x * p._radius) + 1), static_cast<cl_int>(std::ceil(visibleToHidden.y * p._radius) + 1) };
+
+        cl::Image2D hiddenStates = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_R, random2D, rng);
+        cl::Image2D targets = createImage2D(cs, p._hiddenSize, p._hiddenSize, CL_R, random2D, rng);
+        cl::Image2D visibleBack = createImage2D(cs, p._visibleSize, p._visibleSize, CL_R, random2D, rng);
+        cl::Image2D visibleFront = createImage2D(cs, p._visibleSize, p._visibleSize, CL_R, random2D, rng);
+        cl::Image3D weights = createImage3D(cs, p._hiddenSize, p._hiddenSize, weightDiam * weightDiam, random3D, rng);
+
+        Launch launch;
+
+        launch._kernel = cl::Kernel(program.getProgram(), "plPropagate");
+
+        int argIndex = 0;
+
+        launch._kernel.setArg(argIndex++, hiddenStates);
+        launch._kernel.setArg(argIndex++, targets);
+        launch._kernel.setArg(argIndex++, visibleBack);
+        launch._kernel.setArg(argIndex++, visibleFront);
+        launch._kernel.setArg(argIndex++, weights);
+        launch._kernel.setArg(argIndex++, cl_int2{ p._visibleSize, p._visibleSize });
+        launch._kernel.setArg(argIndex++, cl_int2{ p._hiddenSize, p._hiddenSize });
+        launch._kernel.setArg(argIndex++, visibleToHidden);
+        launch._kernel.setArg(argIndex++, hiddenToVisible);
+        launch._kernel.setArg(argIndex++, p._radius);
+        launch._kernel.setArg(argIndex++, reverseRadii);
+
+        launch._range = cl::NDRange(p._visibleSize, p._visibleSize);
+        launch._memory = { hiddenStates, targets, visibleBack, visibleFront, weights };
+
+        // Taps that fall in the receptive field, per axis (bounds are separable)
+        double contained = 0.0;
+
+        for (int v = 0; v < p._visibleSize; v++) {
+            int center = project(v, visibleToHidden.x);
+
+            for (int d = -reverseRadii.x; d <= reverseRadii.x; d++) {
+                int h = center + d;
+
+                if (h < 0 || h >= p._hiddenSize)
+                    continue;
+
+                int fieldCenter = project(h, hiddenToVisible.x);
+
+                if (v >= fieldCenter - p._radius && v < fieldCenter + p._radius + 1)
+                    contained++;
+            }
+        }
+
+        double visible = static_cast<double>(p._visibleSize) * p._visibleSize;
+        double taps = contained * contained;
+
+        // Sum read and write per visible unit, hidden state, target and weight per tap
+        launch._bytes = visible * 2 * floatSize + taps * 3 * floatSize;
+        launch._flops = taps * 3;
+
+        return launch;
+    }
+
+    std::vector<KernelDesc> kernelDescs() {
+        std::vector<KernelDesc> descs;
+
+        descs.push_back({ "sfcStimulus", true, true, true, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createStimulus(cs, programs._chunk, "sfcStimulus", 2, p, rng); } });
+        descs.push_back({ "sfcLearnWeights", true, true, true, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createLearnWeights(cs, programs._chunk, "sfcLearnWeights", false, p, rng); } });
+        descs.push_back({ "sfcInhibit", false, false, false, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createInhibit(cs, programs._chunk, "sfcInhibit", 0, p, rng); } });
+        descs.push_back({ "sfdStimulus", true, true, true, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createStimulus(cs, programs._distance, "sfdStimulus", 3, p, rng); } });
+        descs.push_back({ "sfdLearnWeights", true, true, true, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createLearnWeights(cs, programs._distance, "sfdLearnWeights", true, p, rng); } });
+        descs.push_back({ "sfdInhibit", false, false, false, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createInhibit(cs, programs._distance, "sfdInhibit", 1, p, rng); } });
+        descs.push_back({ "plStimulus", true, true, false, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createPredictorStimulus(cs, programs._predictor, p, rng); } });
+        descs.push_back({ "plPropagate", true, true, false, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createPropagate(cs, programs._predictor, p, rng); } });
+        descs.push_back({ "plInhibitBinary", false, false, false, true,
+            [](ComputeSystem &cs, Programs &programs, const Params &p, std::mt19937 &rng) { return createInhibit(cs, programs._predictor, "plInhibitBinary", 2, p, rng); } });
+
+        return descs;
+    }
+
+    void printUsage(const char* name) {
+        fprintf(stderr, "Usage: %s [options]\n", name);
+        fprintf(stderr, "Lists are comma separated, every combination that changes the work of a kernel is run.\n");
+        fprintf(stderr, "  --device <cpu|gpu|all>    OpenCL device type (default cpu)\n");
+        fprintf(stderr, "  --platform <index>        platform index (default last)\n");
+        fprintf(stderr, "  --device-index <index>    device index (default last)\n");
+        fprintf(stderr, "  --kernels <list>          kernels to run (default all)\n");
+        fprintf(stderr, "  --hidden-sizes <list>     hidden width and height (default 64)\n");
+        fprintf(stderr, "  --visible-sizes <list>    visible width and height (default 64)\n");
+        fprintf(stderr, "  --radii <list>            radius (default 4,6,8)\n");
+        fprintf(stderr, "  --samples <list>          encoder samples (default 1,2,4)\n");
+        fprintf(stderr, "  --chunk-sizes <list>      chunk width and height (default 4,6,8)\n");
+        fprintf(stderr, "  --warmup <runs>           untimed runs per configuration (default 5)\n");
+        fprintf(stderr, "  --repeats <runs>          timed runs per configuration (default 50)\n");
+        fprintf(stderr, "  --output <file>           JSON results, - for stdout (default ogmaneo_kernel_bench.json)\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+
+    if (!options.parse(argc, argv, { "help" }) || options.has("help") || !options.getUnknown().empty()) {
+        printUsage(argv[0]);
+        return options.has("help") ? 0 : 1;
+    }
+
+    ComputeSystem::DeviceType deviceType;
+
+    if (!bench::parseDeviceType(options.get("device", "cpu"), deviceType)) {
+        fprintf(stderr, "Unknown device type %s\n", options.get("device", "").c_str());
+        return 1;
+    }
+
+    std::vector<KernelDesc> descs = kernelDescs();
+
+    std::vector<std::string> allNames;
+
+    for (const KernelDesc &desc : descs)
+        allNames.push_back(desc._name);
+
+    std::vector<std::string> kernelNames = options.getStrings("kernels", allNames);
+
+    for (const std::string &name : kernelNames) {
+        if (std::find(allNames.begin(), allNames.end(), name) == allNames.end()) {
+            fprintf(stderr, "Unknown kernel %s\n", name.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<int> hiddenSizes = options.getInts("hidden-sizes", { 64 });
+    std::vector<int> visibleSizes = options.getInts("visible-sizes", { 64 });
+    std::vector<int> radii = options.getInts("radii", { 4, 6, 8 });
+    std::vector<int> sampleCounts = options.getInts("samples", { 1, 2, 4 });
+    std::vector<int> chunkSizes = options.getInts("chunk-sizes", { 4, 6, 8 });
+    int warmup = options.getInt("warmup", 5);
+    int repeats = options.getInt("repeats", 50);
+    std::string output = options.get("output", "ogmaneo_kernel_bench.json");
+
+    if (repeats <= 0 || warmup < 0) {
+        fprintf(stderr, "Nothing to run\n");
+        return 1;
+    }
+
+    ComputeSystem cs;
+
+    if (!cs.create(deviceType, options.getInt("platform", -1), options.getInt("device-index", -1))) {
+        fprintf(stderr, "No OpenCL device\n");
+        return 1;
+    }
+
+    // Kernels run on their own queue, so that profiling does not need to be enabled on the default one
+    cl::CommandQueue queue(cs.getContext(), cs.getDevice(), CL_QUEUE_PROFILING_ENABLE);
+
+    Programs programs;
+
+    if (!programs._chunk.loadSparseFeaturesKernel(cs, _chunk) ||
+        !programs._distance.loadSparseFeaturesKernel(cs, _distance) ||
+        !programs._predictor.loadPredictorKernel(cs))
+    {
+        fprintf(stderr, "Unable to build the kernels\n");
+        return 1;
+    }
+
+    cl::size_type maxDepth = cs.getDevice().getInfo<CL_DEVICE_IMAGE3D_MAX_DEPTH>();
+
+    std::mt19937 rng(1234);
+
+    bench::JsonWriter json;
+
+    json.beginObject();
+    json.field("benchmark", "ogmaneo_kernel_bench");
+    bench::writeDevice(json, cs);
+    json.field("warmupRuns", warmup);
+    json.field("timedRuns", repeats);
+    json.key("results").beginArray();
+
+    for (const KernelDesc &desc : descs) {
+        if (std::find(kernelNames.begin(), kernelNames.end(), desc._name) == kernelNames.end())
+            continue;
+
+        std::set<std::vector<int>> done;
+
+        for (int hiddenSize : hiddenSizes)
+            for (int visibleSize : visibleSizes)
+                for (int radius : radii)
+                    for (int numSamples : sampleCounts)
+                        for (int chunkSize : chunkSizes) {
+                            Params p;
+                            p._hiddenSize = hiddenSize;
+                            p._visibleSize = desc._usesVisible ? visibleSize : 0;
+                            p._radius = desc._usesRadius ? radius : 0;
+                            p._numSamples = desc._usesSamples ? numSamples : 1;
+                            p._chunkSize = desc._usesChunkSize ? chunkSize : 1;
+
+                            // Skip combinations that only differ in parameters the kernel does not use
+                            if (!done.insert({ p._hiddenSize, p._visibleSize, p._radius, p._numSamples, p._chunkSize }).second)
+                                continue;
+
+                            int weightDiam = p._radius * 2 + 1;
+
+                            if (desc._usesRadius && static_cast<cl::size_type>(weightDiam * weightDiam * p._numSamples) > maxDepth) {
+                                fprintf(stderr, "%s: skipping radius %d, samples %d (weights deeper than %zu)\n",
+                                    desc._name.c_str(), p._radius, p._numSamples, static_cast<size_t>(maxDepth));
+                                continue;
+                            }
+
+                            Launch launch = desc._create(cs, programs, p, rng);
+
+                            // Finish the random initialization on the default queue
+                            cs.getQueue().finish();
+
+                            std::vector<double> timesUs;
+
+                            for (int r = 0; r < warmup + repeats; r++) {
+                                cl::Event event;
+
+                                queue.enqueueNDRangeKernel(launch._kernel, cl::NullRange, launch._range, cl::NullRange, nullptr, &event);
+
+                                event.wait();
+
+                                if (r >= warmup) {
+                                    cl_ulong start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+                                    cl_ulong end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+                                    timesUs.push_back((end - start) * 0.001);
+                                }
+                            }
+
+                            bench::Stats stats = bench::computeStats(timesUs);
+
+                            double seconds = stats._mean * 1e-6;
+
+                            double bytesPerSecond = seconds > 0.0 ? launch._bytes / seconds : 0.0;
+                            double flopsPerSecond = seconds > 0.0 ? launch._flops / seconds : 0.0;
+
+                            fprintf(stderr, "%-16s hidden %3d visible %3d radius %2d samples %d chunk %d: %9.1f us %7.2f GB/s %7.2f GFLOP/s\n",
+                                desc._name.c_str(), p._hiddenSize, p._visibleSize, p._radius, p._numSamples, p._chunkSize,
+                                stats._mean, bytesPerSecond * 1e-9, flopsPerSecond * 1e-9);
+
+                            json.beginObject();
+
+                            json.field("kernel", desc._name);
+
+                            json.key("params").beginObject();
+                            json.field("hiddenSize", p._hiddenSize);
+
+                            if (desc._usesVisible)
+                                json.field("visibleSize", p._visibleSize);
+
+                            if (desc._usesRadius)
+                                json.field("radius", p._radius);
+
+                            if (desc._usesSamples)
+                                json.field("samples", p._numSamples);
+
+                            if (desc._usesChunkSize)
+                                json.field("chunkSize", p._chunkSize);
+                            json.endObject();
+
+                            json.stats("time", stats, "Us");
+                            json.field("bytes", launch._bytes);
+                            json.field("flops", launch._flops);
+                            json.field("bytesPerSecond", bytesPerSecond);
+                            json.field("flopsPerSecond", flopsPerSecond);
+
+                            json.endObject();
+                        }
+    }
+
+    json.endArray();
+    json.endObject();
+
+    if (!json.save(output)) {
+        fprintf(stderr, "Unable to write %s\n", output.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,400 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Performance regression gate: runs the configurations of a baseline file, and compares steps/sec and
+// per kernel times against the recorded values within the baseline tolerances. Run by CTest (ogmaneo_perf_gate)
+// on pocl with a pinned thread count, --update records a new baseline on the reference machine
+
+#include "HierarchyBench.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ogmaneo;
+
+namespace {
+    // CTest SKIP_RETURN_CODE, for machines the baseline does not apply to
+    const int _skipped = 77;
+
+    void printUsage(const char* name) {
+        fprintf(stderr, "Usage: %s --baseline <file> [options]\n", name);
+        fprintf(stderr, "  --baseline <file>         baseline JSON with the configurations, recorded values and tolerances\n");
+        fprintf(stderr, "  --device <cpu|gpu|all>    OpenCL device type (default cpu)\n");
+        fprintf(stderr, "  --device-index <index>    device index (default last)\n");
+        fprintf(stderr, "  --configs <list>          only run these configurations (names, comma separated)\n");
+        fprintf(stderr, "  --update                  record the measured values as the new baseline instead of comparing\n");
+        fprintf(stderr, "  --output <file>           where --update writes the baseline (default the baseline file)\n");
+        fprintf(stderr, "  --ignore-device           compare even if the device differs from the one the baseline was recorded on\n");
+    }
+
+    /*!
+    \brief Configuration of the baseline with its recorded values
+    */
+    struct Entry {
+        std::string _name;
+
+        bench::Config _config;
+
+        double _stepsPerSecondTolerance;
+        double _kernelTolerance;
+
+        // 0 if not recorded yet
+        double _stepsPerSecond;
+
+        // Mean ms per launch, by kernel key (see kernelKey)
+        std::map<std::string, double> _kernels;
+
+        // Selected with --configs (all by default)
+        bool _run;
+    };
+
+    std::string kernelKey(const KernelStats &stats) {
+        return stats._scope + "/" + std::to_string(stats._layer) + "/" + stats._kernel;
+    }
+
+    bool loadEntry(const bench::JsonValue &value, const bench::JsonValue &baseline, Entry &entry) {
+        entry._name = value["name"].getString();
+
+        bench::Config &config = entry._config;
+
+        config._inputSize = value["inputSize"].getInt(config._inputSize);
+        config._numLayers = value["layers"].getInt(config._numLayers);
+        config._radius = value["radius"].getInt(config._radius);
+        config._numSamples = value["samples"].getInt(config._numSamples);
+        config._chunkSize = value["chunkSize"].getInt(config._chunkSize);
+        config._hiddenSize = value["hiddenSize"].getInt(config._hiddenSize);
+
+        if (entry._name.empty() || !bench::parseEncoder(value["encoder"].getString("chunk"), config._encoder))
+            return false;
+
+        // Per configuration tolerances override the global ones
+        entry._stepsPerSecondTolerance = value["stepsPerSecondTolerance"].getNumber(baseline["stepsPerSecondTolerance"].getNumber(0.15));
+        entry._kernelTolerance = value["kernelTolerance"].getNumber(baseline["kernelTolerance"].getNumber(0.25));
+
+        entry._stepsPerSecond = value["stepsPerSecond"].getNumber(0.0);
+
+        for (const std::pair<std::string, bench::JsonValue> &kernel : value["kernels"].getMembers())
+            entry._kernels[kernel.first] = kernel.second.getNumber(0.0);
+
+        return true;
+    }
+
+    /*!
+    \brief Relative change in percent, formatted
+    */
+    std::string change(double measured, double baseline) {
+        char s[32];
+        snprintf(s, sizeof(s), "%+.1f%%", 100.0 * (measured / baseline - 1.0));
+
+        return s;
+    }
+
+    void printRow(const std::string &name, const std::string &measured, const std::string &baseline, const std::string &delta, const char* verdict) {
+        printf("  %-36s %12s %12s %9s  %s\n", name.c_str(), measured.c_str(), baseline.c_str(), delta.c_str(), verdict);
+    }
+
+    std::string number(double x, const char* format) {
+        char s[32];
+        snprintf(s, sizeof(s), format, x);
+
+        return s;
+    }
+
+    bool writeBaseline(const std::string &fileName, const bench::JsonValue &baseline, const std::vector<Entry> &entries, ComputeSystem &cs, int warmup, int steps, unsigned int seed) {
+        bench::JsonWriter json;
+
+        json.beginObject();
+        json.field("description", baseline["description"].getString());
+        json.field("platform", cs.getPlatform().getInfo<CL_PLATFORM_NAME>());
+        json.field("device", cs.getDevice().getInfo<CL_DEVICE_NAME>());
+        json.field("computeUnits", static_cast<int>(cs.getDevice().getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>()));
+        json.field("warmupSteps", warmup);
+        json.field("timedSteps", steps);
+        json.field("seed", static_cast<int>(seed));
+        json.field("stepsPerSecondTolerance", baseline["stepsPerSecondTolerance"].getNumber(0.15));
+        json.field("kernelTolerance", baseline["kernelTolerance"].getNumber(0.25));
+        json.field("minKernelMs", baseline["minKernelMs"].getNumber(0.01));
+        json.key("configs").beginArray();
+
+        for (const Entry &entry : entries) {
+            const bench::Config &config = entry._config;
+
+            json.beginObject();
+            json.field("name", entry._name);
+            json.field("inputSize", config._inputSize);
+            json.field("layers", config._numLayers);
+            json.field("encoder", bench::encoderName(config._encoder));
+            json.field("radius", config._radius);
+            json.field("samples", config._numSamples);
+            json.field("chunkSize", config._chunkSize);
+            json.field("hiddenSize", config._hiddenSize);
+
+            // Overrides
+            if (entry._stepsPerSecondTolerance != baseline["stepsPerSecondTolerance"].getNumber(0.15))
+                json.field("stepsPerSecondTolerance", entry._stepsPerSecondTolerance);
+
+            if (entry._kernelTolerance != baseline["kernelTolerance"].getNumber(0.25))
+                json.field("kernelTolerance", entry._kernelTolerance);
+
+            json.field("stepsPerSecond", entry._stepsPerSecond);
+            json.key("kernels").beginObject();
+
+            for (const std::pair<const std::string, double> &kernel : entry._kernels)
+                json.field(kernel.first, kernel.second);
+
+            json.endObject();
+            json.endObject();
+        }
+
+        json.endArray();
+        json.endObject();
+
+        return json.save(fileName);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+
+    if (!options.parse(argc, argv, { "help", "update", "ignore-device" }) || options.has("help") || !options.getUnknown().empty() || !options.has("baseline")) {
+        printUsage(argv[0]);
+        return options.has("help") ? 0 : 1;
+    }
+
+    std::string baselineFile = options.get("baseline", "");
+
+    bench::JsonValue baseline;
+
+    if (!bench::JsonValue::load(baselineFile, baseline) || baseline.getType() != bench::JsonValue::_objectValue) {
+        fprintf(stderr, "Unable to read baseline %s\n", baselineFile.c_str());
+        return 1;
+    }
+
+    bool update = options.has("update");
+
+    std::vector<std::string> only = options.getStrings("configs", {});
+
+    std::vector<Entry> entries;
+
+    int numRun = 0;
+
+    for (const bench::JsonValue &value : baseline["configs"].getItems()) {
+        Entry entry;
+
+        if (!loadEntry(value, baseline, entry)) {
+            fprintf(stderr, "Invalid configuration in baseline %s\n", baselineFile.c_str());
+            return 1;
+        }
+
+        entry._run = only.empty() || std::find(only.begin(), only.end(), entry._name) != only.end();
+
+        // Unselected ones are still written back by --update
+        entries.push_back(entry);
+
+        if (entry._run)
+            numRun++;
+    }
+
+    if (numRun == 0) {
+        fprintf(stderr, "Nothing to run\n");
+        return 1;
+    }
+
+    // The committed template holds no values yet, skip before spending the run on nothing to compare
+    if (!update && std::none_of(entries.begin(), entries.end(), [](const Entry &entry) { return entry._run && entry._stepsPerSecond > 0.0; })) {
+        printf("Skipped: baseline %s has no recorded values, record them with --update\n", baselineFile.c_str());
+        return _skipped;
+    }
+
+    ComputeSystem::DeviceType deviceType;
+
+    if (!bench::parseDeviceType(options.get("device", "cpu"), deviceType)) {
+        fprintf(stderr, "Unknown device type %s\n", options.get("device", "").c_str());
+        return 1;
+    }
+
+    // The platform the baseline was recorded on (pocl), chosen by name
+    std::string platformName = baseline["platform"].getString();
+
+    int platformIndex = -1;
+
+    if (!platformName.empty()) {
+        std::vector<cl::Platform> platforms;
+        cl::Platform::get(&platforms);
+
+        for (int i = 0; i < platforms.size(); i++) {
+            if (platforms[i].getInfo<CL_PLATFORM_NAME>() == platformName)
+                platformIndex = i;
+        }
+
+        if (platformIndex == -1 && !update) {
+            printf("Skipped: platform \"%s\" of the baseline is not available\n", platformName.c_str());
+            return _skipped;
+        }
+    }
+
+    std::shared_ptr<Resources> res = std::make_shared<Resources>(deviceType, platformIndex, options.getInt("device-index", -1));
+
+    ComputeSystem &cs = *res->getComputeSystem();
+
+    if (cs.getDevice()() == nullptr) {
+        printf("Skipped: no OpenCL device\n");
+        return _skipped;
+    }
+
+    std::string deviceName = cs.getDevice().getInfo<CL_DEVICE_NAME>();
+    int computeUnits = static_cast<int>(cs.getDevice().getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>());
+
+    printf("Device: %s (%s), %d compute units\n", deviceName.c_str(), cs.getPlatform().getInfo<CL_PLATFORM_NAME>().c_str(), computeUnits);
+
+    if (!update) {
+        // Timings are only comparable on the machine and thread count they were recorded with
+        if (baseline["computeUnits"].getInt(computeUnits) != computeUnits) {
+            printf("Skipped: baseline recorded with %d compute units, pin the pocl threads (POCL_CPU_MAX_CU_NUM, POCL_MAX_PTHREAD_COUNT)\n",
+                baseline["computeUnits"].getInt());
+            return _skipped;
+        }
+
+        if (!options.has("ignore-device") && !baseline["device"].getString().empty() && baseline["device"].getString() != deviceName) {
+            printf("Skipped: baseline recorded on \"%s\", rerun with --update to record this machine or with --ignore-device\n",
+                baseline["device"].getString().c_str());
+            return _skipped;
+        }
+    }
+
+    int warmup = baseline["warmupSteps"].getInt(20);
+    int steps = baseline["timedSteps"].getInt(100);
+    unsigned int seed = static_cast<unsigned int>(baseline["seed"].getInt(1234));
+    double minKernelMs = baseline["minKernelMs"].getNumber(0.01);
+
+    int numFailures = 0;
+    int numUnrecorded = 0;
+
+    for (Entry &entry : entries) {
+        if (!entry._run)
+            continue;
+
+        const bench::Config &config = entry._config;
+
+        printf("\n%s (input %d, layers %d, %s, radius %d, samples %d, chunk %d, hidden %d)\n", entry._name.c_str(),
+            config._inputSize, config._numLayers, bench::encoderName(config._encoder), config._radius, config._numSamples, config._chunkSize, config._hiddenSize);
+
+        // Steps/sec unprofiled, kernel times in a second (profiled) run
+        bench::RunResult timed = bench::run(res, config, seed, warmup, steps, false);
+        bench::RunResult profiled = bench::run(res, config, seed, warmup, steps, true);
+
+        // The median step is less sensitive to scheduling hiccups than the mean
+        double medianMs = bench::computeStats(timed._stepMs)._p50;
+        double stepsPerSecond = medianMs > 0.0 ? 1000.0 / medianMs : 0.0;
+
+        std::map<std::string, double> kernels;
+
+        for (const KernelStats &stats : profiled._kernels)
+            kernels[kernelKey(stats)] = stats._totalMs / stats._count;
+
+        if (update) {
+            printf("  %-36s %12.1f\n", "steps/s", stepsPerSecond);
+
+            entry._stepsPerSecond = stepsPerSecond;
+            entry._kernels = kernels;
+
+            continue;
+        }
+
+        printRow("", "measured", "baseline", "change", "");
+
+        if (entry._stepsPerSecond <= 0.0) {
+            printRow("steps/s", number(stepsPerSecond, "%.1f"), "-", "-", "not recorded");
+
+            numUnrecorded++;
+        }
+        else {
+            bool regressed = stepsPerSecond < entry._stepsPerSecond * (1.0 - entry._stepsPerSecondTolerance);
+            bool improved = stepsPerSecond > entry._stepsPerSecond * (1.0 + entry._stepsPerSecondTolerance);
+
+            printRow("steps/s", number(stepsPerSecond, "%.1f"), number(entry._stepsPerSecond, "%.1f"), change(stepsPerSecond, entry._stepsPerSecond),
+                regressed ? "REGRESSED" : (improved ? "faster (consider --update)" : "ok"));
+
+            if (regressed)
+                numFailures++;
+        }
+
+        // Kernels in either set, in key order
+        std::map<std::string, double> all = entry._kernels;
+        all.insert(kernels.begin(), kernels.end());
+
+        for (const std::pair<const std::string, double> &kernel : all) {
+            std::map<std::string, double>::const_iterator measured = kernels.find(kernel.first);
+            std::map<std::string, double>::const_iterator recorded = entry._kernels.find(kernel.first);
+
+            if (recorded == entry._kernels.end()) {
+                printRow(kernel.first, number(measured->second, "%.4f"), "-", "-", "new");
+
+                continue;
+            }
+
+            if (measured == kernels.end()) {
+                // Renamed or removed kernels leave the baseline stale
+                printRow(kernel.first, "-", number(recorded->second, "%.4f"), "-", "MISSING");
+
+                numFailures++;
+
+                continue;
+            }
+
+            // Too short to time reliably
+            if (recorded->second < minKernelMs) {
+                printRow(kernel.first, number(measured->second, "%.4f"), number(recorded->second, "%.4f"), change(measured->second, recorded->second), "below floor");
+
+                continue;
+            }
+
+            bool regressed = measured->second > recorded->second * (1.0 + entry._kernelTolerance);
+            bool improved = measured->second < recorded->second * (1.0 - entry._kernelTolerance);
+
+            printRow(kernel.first, number(measured->second, "%.4f"), number(recorded->second, "%.4f"), change(measured->second, recorded->second),
+                regressed ? "REGRESSED" : (improved ? "faster (consider --update)" : "ok"));
+
+            if (regressed)
+                numFailures++;
+        }
+    }
+
+    if (update) {
+        std::string output = options.get("output", baselineFile);
+
+        if (!writeBaseline(output, baseline, entries, cs, warmup, steps, seed)) {
+            fprintf(stderr, "Unable to write %s\n", output.c_str());
+            return 1;
+        }
+
+        printf("\nRecorded baseline %s\n", output.c_str());
+
+        return 0;
+    }
+
+    printf("\n");
+
+    if (numFailures > 0) {
+        printf("FAILED: %d regression(s) beyond tolerance in %d configuration(s)\n", numFailures, numRun);
+        return 1;
+    }
+
+    if (numUnrecorded > 0) {
+        printf("Skipped: %d configuration(s) without recorded values, record them with --update\n", numUnrecorded);
+        return _skipped;
+    }
+
+    printf("Passed: %d configuration(s) within tolerance\n", numRun);
+
+    return 0;
+}
@@ -0,0 +1,314 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Startup latency benchmark: breaks the time to the first step of a new worker into its phases
+// (ComputeSystem creation, program builds, hierarchy generation, weight initialization, first step).
+// Cold runs start a new process each, warm runs repeat the phases within one process
+
+#include "HierarchyBench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace ogmaneo;
+using bench::Config;
+
+namespace {
+    const char* const _programNames[] = { "hierarchy", "predictor", "chunk", "distance" };
+
+    /*!
+    \brief Phase durations of one run, in order
+    */
+    typedef std::vector<std::pair<std::string, double>> Run;
+
+    void printUsage(const char* name) {
+        fprintf(stderr, "Usage: %s [options]\n", name);
+        fprintf(stderr, "  --mode <cold|warm>        new process per run, or all runs in this process (default cold)\n");
+        fprintf(stderr, "  --runs <count>            number of runs (default 5)\n");
+        fprintf(stderr, "  --device <cpu|gpu|all>    OpenCL device type (default cpu)\n");
+        fprintf(stderr, "  --platform <index>        platform index (default last)\n");
+        fprintf(stderr, "  --device-index <index>    device index (default last)\n");
+        fprintf(stderr, "  --lazy-programs           let generateHierarchy build the programs it needs, instead of all four up front\n");
+        fprintf(stderr, "  --input-size <size>       width and height of the input layer (default 32)\n");
+        fprintf(stderr, "  --layers <count>          number of higher layers (default 2)\n");
+        fprintf(stderr, "  --encoder <type>          chunk or distance (default chunk)\n");
+        fprintf(stderr, "  --radius <radius>         encoder and predictor radius (default 6)\n");
+        fprintf(stderr, "  --samples <count>         encoder samples (default 2)\n");
+        fprintf(stderr, "  --chunk-size <size>       encoder chunk width and height (default 6)\n");
+        fprintf(stderr, "  --hidden-size <size>      width and height of the higher layers (default 64)\n");
+        fprintf(stderr, "  --output <file>           JSON results, - for stdout (default ogmaneo_startup_bench.json)\n");
+    }
+
+    /*!
+    \brief All phases from scratch, in this process
+    \return false if there is no device or a program does not build.
+    */
+    bool runOnce(const bench::Options &options, ComputeSystem::DeviceType deviceType, const Config &config, bool lazyPrograms, Run &run) {
+        bench::Stopwatch watch;
+
+        // Platform and device enumeration, context and queue (including the SYS_DEBUG output)
+        std::shared_ptr<Resources> res = std::make_shared<Resources>(deviceType, options.getInt("platform", -1), options.getInt("device-index", -1));
+
+        run.push_back(std::make_pair(std::string("create"), watch.elapsedMs()));
+
+        ComputeSystem &cs = *res->getComputeSystem();
+
+        if (cs.getDevice()() == nullptr) {
+            fprintf(stderr, "No OpenCL device\n");
+            return false;
+        }
+
+        if (!lazyPrograms) {
+            for (const char* name : _programNames) {
+                watch.reset();
+
+                if (!res->loadProgram(name)) {
+                    fprintf(stderr, "Unable to build the %s program\n", name);
+                    return false;
+                }
+
+                run.push_back(std::make_pair(std::string("build.") + name, watch.elapsedMs()));
+            }
+        }
+
+        // Allocation and enqueued initialization (randomUniform, fills), plus any builds left to the Architect
+        watch.reset();
+
+        std::shared_ptr<Hierarchy> h = bench::generate(res, config, 1234);
+
+        run.push_back(std::make_pair(std::string("generate"), watch.elapsedMs()));
+
+        // Remaining device side initialization
+        watch.reset();
+
+        cs.getQueue().finish();
+
+        run.push_back(std::make_pair(std::string("init"), watch.elapsedMs()));
+
+        // First launch of each kernel
+        std::vector<ValueField2D> frame(1, ValueField2D(Vec2i(config._inputSize, config._inputSize), 0.5f));
+
+        watch.reset();
+
+        h->activate(frame);
+        h->learn(frame);
+
+        cs.getQueue().finish();
+
+        run.push_back(std::make_pair(std::string("firstStep"), watch.elapsedMs()));
+
+        return true;
+    }
+
+    double getTotal(const Run &run) {
+        double total = 0.0;
+
+        for (const std::pair<std::string, double> &phase : run)
+            total += phase.second;
+
+        return total;
+    }
+
+    void writeRun(bench::JsonWriter &json, const Run &run) {
+        json.beginObject();
+
+        for (const std::pair<std::string, double> &phase : run)
+            json.field(phase.first + "Ms", phase.second);
+
+        json.field("totalMs", getTotal(run));
+
+        json.endObject();
+    }
+
+    /*!
+    \brief Quote an argument for the shell (arguments of this benchmark hold no quotes)
+    */
+    std::string quote(const std::string &arg) {
+        return "\"" + arg + "\"";
+    }
+
+    /*!
+    \brief Run once in a new process with the same options
+    \return false if the child failed or its results could not be read.
+    */
+    bool runChild(int argc, char* argv[], const std::string &resultFile, Run &run, double &processMs) {
+        std::string command = quote(argv[0]);
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg(argv[i]);
+
+            // Replaced below
+            if (arg == "--mode" || arg == "--runs" || arg == "--output") {
+                i++;
+
+                continue;
+            }
+
+            command += " " + quote(arg);
+        }
+
+        command += " --mode warm --runs 1 --output " + quote(resultFile);
+
+        bench::Stopwatch watch;
+
+        int status = system(command.c_str());
+
+        processMs = watch.elapsedMs();
+
+        bench::JsonValue result;
+
+        bool success = status == 0 && bench::JsonValue::load(resultFile, result) && result["runs"].getItems().size() == 1;
+
+        remove(resultFile.c_str());
+
+        if (!success)
+            return false;
+
+        for (const std::pair<std::string, bench::JsonValue> &phase : result["runs"].getItems()[0].getMembers()) {
+            // Phases are stored with an Ms suffix, totalMs is recomputed
+            if (phase.first != "totalMs")
+                run.push_back(std::make_pair(phase.first.substr(0, phase.first.size() - 2), phase.second.getNumber()));
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+
+    if (!options.parse(argc, argv, { "help", "lazy-programs" }) || options.has("help") || !options.getUnknown().empty()) {
+        printUsage(argv[0]);
+        return options.has("help") ? 0 : 1;
+    }
+
+    ComputeSystem::DeviceType deviceType;
+
+    if (!bench::parseDeviceType(options.get("device", "cpu"), deviceType)) {
+        fprintf(stderr, "Unknown device type %s\n", options.get("device", "").c_str());
+        return 1;
+    }
+
+    Config config;
+
+    config._inputSize = options.getInt("input-size", config._inputSize);
+    config._numLayers = options.getInt("layers", config._numLayers);
+    config._radius = options.getInt("radius", config._radius);
+    config._numSamples = options.getInt("samples", config._numSamples);
+    config._chunkSize = options.getInt("chunk-size", config._chunkSize);
+    config._hiddenSize = options.getInt("hidden-size", config._hiddenSize);
+
+    if (!bench::parseEncoder(options.get("encoder", "chunk"), config._encoder)) {
+        fprintf(stderr, "Unknown encoder %s\n", options.get("encoder", "").c_str());
+        return 1;
+    }
+
+    std::string mode = options.get("mode", "cold");
+    int numRuns = options.getInt("runs", 5);
+    bool lazyPrograms = options.has("lazy-programs");
+    std::string output = options.get("output", "ogmaneo_startup_bench.json");
+
+    if ((mode != "cold" && mode != "warm") || numRuns <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Run> runs(numRuns);
+    std::vector<double> processMs;
+
+    for (int r = 0; r < numRuns; r++) {
+        if (mode == "cold") {
+            double ms;
+
+            if (!runChild(argc, argv, (output == "-" ? std::string("ogmaneo_startup_bench") : output) + ".run" + std::to_string(r) + ".json", runs[r], ms)) {
+                fprintf(stderr, "Run %d failed\n", r);
+                return 1;
+            }
+
+            processMs.push_back(ms);
+        }
+        else if (!runOnce(options, deviceType, config, lazyPrograms, runs[r]))
+            return 1;
+
+        fprintf(stderr, "%s run %d: %.1f ms to first step\n", mode.c_str(), r, getTotal(runs[r]));
+    }
+
+    bench::JsonWriter json;
+
+    json.beginObject();
+    json.field("benchmark", "ogmaneo_startup_bench");
+
+    // Device info after the runs, so it does not warm up the first one
+    {
+        ComputeSystem cs;
+
+        if (cs.create(deviceType, options.getInt("platform", -1), options.getInt("device-index", -1)))
+            bench::writeDevice(json, cs);
+    }
+
+    json.field("mode", mode);
+    json.field("numRuns", numRuns);
+    json.field("lazyPrograms", lazyPrograms);
+
+    json.key("config").beginObject();
+    json.field("inputSize", config._inputSize);
+    json.field("layers", config._numLayers);
+    json.field("encoder", bench::encoderName(config._encoder));
+    json.field("radius", config._radius);
+    json.field("samples", config._numSamples);
+    json.field("chunkSize", config._chunkSize);
+    json.field("hiddenSize", config._hiddenSize);
+    json.endObject();
+
+    // Statistics per phase over the runs (the first warm run is usually the slowest)
+    json.key("phases").beginObject();
+
+    for (int p = 0; p < runs.front().size(); p++) {
+        std::vector<double> samples;
+
+        for (const Run &run : runs)
+            samples.push_back(p < run.size() ? run[p].second : 0.0);
+
+        json.stats(runs.front()[p].first, bench::computeStats(samples), "Ms");
+    }
+
+    {
+        std::vector<double> totals;
+
+        for (const Run &run : runs)
+            totals.push_back(getTotal(run));
+
+        json.stats("total", bench::computeStats(totals), "Ms");
+    }
+
+    // Including process start and library loading
+    if (!processMs.empty())
+        json.stats("process", bench::computeStats(processMs), "Ms");
+
+    json.endObject();
+
+    json.key("runs").beginArray();
+
+    for (const Run &run : runs)
+        writeRun(json, run);
+
+    json.endArray();
+
+    json.endObject();
+
+    if (!json.save(output)) {
+        fprintf(stderr, "Unable to write %s\n", output.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Accuracy and throughput benchmark: the sine prediction task of Python/WavyDemo.py, headless.
+// A scalar sine is learned one step ahead, then the hierarchy runs closed loop on its own predictions.
+// Reports the NRMSE of both phases together with steps/sec, over a sweep of encoders, chunk sizes and radii
+
+#include "HierarchyBench.h"
+
+#include "neo/Architect.h"
+#include "neo/Hierarchy.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ogmaneo;
+
+namespace {
+    void printUsage(const char* name) {
+        fprintf(stderr, "Usage: %s [options]\n", name);
+        fprintf(stderr, "Lists are comma separated, every combination is run. The defaults are the settings of WavyDemo.py.\n");
+        fprintf(stderr, "  --device <cpu|gpu|all>    OpenCL device type (default cpu)\n");
+        fprintf(stderr, "  --platform <index>        platform index (default last)\n");
+        fprintf(stderr, "  --device-index <index>    device index (default last)\n");
+        fprintf(stderr, "  --encoders <list>         encoder of each higher layer joined by +, bottom first (default distance+chunk)\n");
+        fprintf(stderr, "  --chunk-sizes <list>      encoder chunk width and height (default 6)\n");
+        fprintf(stderr, "  --radii <list>            encoder and predictor radius (default 8)\n");
+        fprintf(stderr, "  --hidden-size <size>      width and height of the higher layers (default 96)\n");
+        fprintf(stderr, "  --steps <steps>           total steps (default 986)\n");
+        fprintf(stderr, "  --test-fraction <f>       fraction of the steps run closed loop (default 0.25)\n");
+        fprintf(stderr, "  --seed <seed>             architect seed (default 1234)\n");
+        fprintf(stderr, "  --output <file>           JSON results, - for stdout (default ogmaneo_wavy_bench.json)\n");
+    }
+
+    /*!
+    \brief Root mean square error normalized by the range of the signal, over [first, last)
+    */
+    double nrmse(const std::vector<double> &predicted, const std::vector<double> &target, int first, int last, double range) {
+        if (last <= first || range <= 0.0)
+            return 0.0;
+
+        double sum = 0.0;
+
+        for (int i = first; i < last; i++)
+            sum += (predicted[i] - target[i]) * (predicted[i] - target[i]);
+
+        return std::sqrt(sum / (last - first)) / range;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+
+    if (!options.parse(argc, argv, { "help" }) || options.has("help") || !options.getUnknown().empty()) {
+        printUsage(argv[0]);
+        return options.has("help") ? 0 : 1;
+    }
+
+    ComputeSystem::DeviceType deviceType;
+
+    if (!bench::parseDeviceType(options.get("device", "cpu"), deviceType)) {
+        fprintf(stderr, "Unknown device type %s\n", options.get("device", "").c_str());
+        return 1;
+    }
+
+    std::vector<std::string> encoderLists = options.getStrings("encoders", { "distance+chunk" });
+    std::vector<int> chunkSizes = options.getInts("chunk-sizes", { 6 });
+    std::vector<int> radii = options.getInts("radii", { 8 });
+    int hiddenSize = options.getInt("hidden-size", 96);
+    int steps = options.getInt("steps", static_cast<int>(3.14159265f * 314.0f));
+    float testFraction = options.getFloat("test-fraction", 0.25f);
+    unsigned int seed = static_cast<unsigned int>(options.getInt("seed", 1234));
+    std::string output = options.get("output", "ogmaneo_wavy_bench.json");
+
+    int testSteps = static_cast<int>(steps * testFraction);
+    int trainSteps = steps - testSteps;
+
+    std::vector<bench::Config> configs;
+
+    for (const std::string &encoders : encoderLists)
+        for (int chunkSize : chunkSizes)
+            for (int radius : radii) {
+                bench::Config config;
+
+                if (!bench::parseEncoders(encoders, config._encoders)) {
+                    fprintf(stderr, "Unknown encoders %s\n", encoders.c_str());
+                    return 1;
+                }
+
+                // As in the demo, a scalar input and the default encoder samples
+                config._inputSize = 1;
+                config._numSamples = 0;
+                config._chunkSize = chunkSize;
+                config._radius = radius;
+                config._hiddenSize = hiddenSize;
+
+                configs.push_back(config);
+            }
+
+    if (configs.empty() || trainSteps <= 0) {
+        fprintf(stderr, "Nothing to run\n");
+        return 1;
+    }
+
+    // Same signal as the demo, target of step i is the value of step i + 1
+    std::vector<double> sequence(steps);
+
+    for (int i = 0; i < steps; i++)
+        sequence[i] = std::sin(i * 0.3);
+
+    std::vector<double> targets(steps);
+
+    for (int i = 0; i < steps; i++)
+        targets[i] = sequence[(i + 1) % steps];
+
+    double range = *std::max_element(sequence.begin(), sequence.end()) - *std::min_element(sequence.begin(), sequence.end());
+
+    std::shared_ptr<Resources> res = std::make_shared<Resources>(deviceType, options.getInt("platform", -1), options.getInt("device-index", -1));
+
+    ComputeSystem &cs = *res->getComputeSystem();
+
+    if (cs.getDevice()() == nullptr) {
+        fprintf(stderr, "No OpenCL device\n");
+        return 1;
+    }
+
+    bench::JsonWriter json;
+
+    json.beginObject();
+    json.field("benchmark", "ogmaneo_wavy_bench");
+    bench::writeDevice(json, cs);
+    json.field("trainSteps", trainSteps);
+    json.field("testSteps", testSteps);
+    json.field("hiddenSize", hiddenSize);
+    json.field("seed", static_cast<int>(seed));
+    json.key("results").beginArray();
+
+    fprintf(stderr, "%-24s %5s %6s %10s %10s %10s %10s\n", "encoders", "chunk", "radius", "train", "trainTail", "test", "steps/s");
+
+    for (const bench::Config &config : configs) {
+        std::shared_ptr<Hierarchy> h = bench::generate(res, config, seed);
+
+        cs.getQueue().finish();
+
+        std::vector<ValueField2D> inputs(1, ValueField2D(Vec2i(1, 1)));
+
+        std::vector<double> predicted(steps);
+        std::vector<double> stepMs;
+
+        for (int i = 0; i < steps; i++) {
+            // Learn from the signal, then run on the previous prediction
+            inputs[0].setValue(Vec2i(0, 0), static_cast<float>(i < trainSteps ? sequence[i] : predicted[i - 1]));
+
+            bench::Stopwatch watch;
+
+            h->activate(inputs);
+            h->learn(inputs);
+
+            predicted[i] = h->getPredictions()[0].getValue(Vec2i(0, 0));
+
+            stepMs.push_back(watch.elapsedMs());
+        }
+
+        // Converged quality, over the last quarter of the training steps
+        int tailStart = trainSteps - std::max(1, trainSteps / 4);
+
+        double trainNrmse = nrmse(predicted, targets, 0, trainSteps, range);
+        double trainTailNrmse = nrmse(predicted, targets, tailStart, trainSteps, range);
+        double testNrmse = nrmse(predicted, targets, trainSteps, steps, range);
+
+        bench::Stats stepStats = bench::computeStats(stepMs);
+
+        double stepsPerSecond = stepStats._mean > 0.0 ? 1000.0 / stepStats._mean : 0.0;
+
+        fprintf(stderr, "%-24s %5d %6d %10.4f %10.4f %10.4f %10.1f\n", bench::encodersName(config._encoders).c_str(), config._chunkSize, config._radius,
+            trainNrmse, trainTailNrmse, testNrmse, stepsPerSecond);
+
+        json.beginObject();
+
+        json.key("config").beginObject();
+        json.field("encoders", bench::encodersName(config._encoders));
+        json.field("chunkSize", config._chunkSize);
+        json.field("radius", config._radius);
+        json.endObject();
+
+        json.field("trainNrmse", trainNrmse);
+        json.field("trainTailNrmse", trainTailNrmse);
+        json.field("testNrmse", testNrmse);
+        json.stats("step", stepStats, "Ms");
+        json.field("stepsPerSecond", stepsPerSecond);
+
+        json.endObject();
+    }
+
+    json.endArray();
+    json.endObject();
+
+    if (!json.save(output)) {
+        fprintf(stderr, "Unable to write %s\n", output.c_str());
+        return 1;
+    }
+
+    return 0;
+}
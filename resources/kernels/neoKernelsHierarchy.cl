@@ -28,4 +28,14 @@ void kernel fhPredictionError(read_only image2d_t states, read_only image2d_t pr
     write_imagef(errors, position, (float4)(state - predictionPrev, 0.0f, 0.0f, 0.0f));
     //write_imagef(errors, position, (float4)(state, 0.0f, 0.0f, 0.0f));
 	//write_imagef(errors, position, (float4)(state * (1.0f - predictionPrev) + (1.0f - state) * predictionPrev, 0.0f, 0.0f, 0.0f));
+}
+
+void kernel fhChunkWinnerIndices(read_only image2d_t chunkWinners, global int* indices, int2 chunkSize, int chunksInX) {
+    int2 chunkPosition = (int2)(get_global_id(0), get_global_id(1));
+
+    float2 chunkWinnerf = read_imagef(chunkWinners, defaultSampler, chunkPosition).xy;
+
+    int2 chunkWinner = (int2)((int)(chunkWinnerf.x + 0.5f), (int)(chunkWinnerf.y + 0.5f));
+
+    indices[chunkPosition.x + chunkPosition.y * chunksInX] = chunkWinner.x + chunkWinner.y * chunkSize.x;
 }
\ No newline at end of file
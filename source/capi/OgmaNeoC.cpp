@@ -0,0 +1,414 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#include "OgmaNeoC.h"
+
+#include "neo/Architect.h"
+#include "neo/Hierarchy.h"
+
+#include <stdio.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef OGMANEO_VERSION_STRING
+#define OGMANEO_VERSION_STRING "unknown"
+#endif
+
+using namespace ogmaneo;
+
+struct ogma_resources_s {
+    std::shared_ptr<Resources> _resources;
+};
+
+// Layers are recorded here and only handed to an Architect on generate,
+// since ParameterModifiers do not stay valid once further layers are added
+struct ogma_architect_s {
+    struct Layer {
+        Vec2i _size;
+        SparseFeaturesType _type;
+        std::vector<std::pair<std::string, std::string>> _params;
+    };
+
+    std::shared_ptr<Resources> _resources;
+    unsigned int _seed;
+
+    std::vector<Layer> _inputLayers;
+    std::vector<Layer> _higherLayers;
+
+    std::unordered_map<std::string, std::string> _hierarchyParams;
+};
+
+struct ogma_hierarchy_s {
+    std::shared_ptr<Resources> _resources;
+    std::shared_ptr<Hierarchy> _h;
+};
+
+namespace {
+    thread_local std::string lastError;
+
+    ogma_status fail(ogma_status status, const std::string &message) {
+        lastError = message;
+
+        return status;
+    }
+
+    // Convert anything thrown below into a status, exceptions must not cross the C boundary
+    template<typename F>
+    ogma_status guard(F f) {
+        try {
+            lastError.clear();
+
+            return f();
+        }
+        catch (const std::invalid_argument &e) {
+            return fail(OGMA_ERROR_INVALID_ARGUMENT, e.what());
+        }
+        catch (const std::out_of_range &e) {
+            return fail(OGMA_ERROR_INVALID_ARGUMENT, e.what());
+        }
+        catch (const std::exception &e) {
+            return fail(OGMA_ERROR_RUNTIME, e.what());
+        }
+        catch (...) {
+            return fail(OGMA_ERROR_RUNTIME, "Unknown error");
+        }
+    }
+
+    ogma_status checkInputs(const ogma_hierarchy* hierarchy, const float* const* inputs, int numInputs) {
+        if (hierarchy == nullptr || inputs == nullptr)
+            return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy or inputs");
+
+        if (numInputs != hierarchy->_h->getNumInputs())
+            return fail(OGMA_ERROR_INVALID_ARGUMENT, "Expected " + std::to_string(hierarchy->_h->getNumInputs()) + " inputs");
+
+        for (int i = 0; i < numInputs; i++)
+            if (inputs[i] == nullptr)
+                return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null input " + std::to_string(i));
+
+        return OGMA_SUCCESS;
+    }
+}
+
+const char* ogma_version(void) {
+    return OGMANEO_VERSION_STRING;
+}
+
+const char* ogma_last_error(void) {
+    return lastError.c_str();
+}
+
+ogma_status ogma_resources_create(ogma_device_type type, int platformIndex, int deviceIndex, ogma_resources** resources) {
+    if (resources == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null resources");
+
+    if (type < OGMA_DEVICE_CPU || type > OGMA_DEVICE_ALL)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Unknown device type");
+
+    return guard([&]() {
+        std::unique_ptr<ogma_resources> r(new ogma_resources());
+
+        r->_resources = std::make_shared<Resources>(static_cast<ComputeSystem::DeviceType>(type), platformIndex, deviceIndex);
+
+        *resources = r.release();
+
+        return OGMA_SUCCESS;
+    });
+}
+
+void ogma_resources_destroy(ogma_resources* resources) {
+    delete resources;
+}
+
+ogma_status ogma_architect_create(ogma_resources* resources, unsigned int seed, ogma_architect** architect) {
+    if (resources == nullptr || architect == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null resources or architect");
+
+    return guard([&]() {
+        std::unique_ptr<ogma_architect> a(new ogma_architect());
+
+        a->_resources = resources->_resources;
+        a->_seed = seed;
+
+        *architect = a.release();
+
+        return OGMA_SUCCESS;
+    });
+}
+
+void ogma_architect_destroy(ogma_architect* architect) {
+    delete architect;
+}
+
+ogma_status ogma_architect_add_input_layer(ogma_architect* architect, int width, int height, int* layerIndex) {
+    if (architect == nullptr || width <= 0 || height <= 0)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null architect or invalid layer size");
+
+    return guard([&]() {
+        ogma_architect::Layer layer;
+        layer._size = Vec2i(width, height);
+        layer._type = _chunk;
+
+        architect->_inputLayers.push_back(layer);
+
+        if (layerIndex != nullptr)
+            *layerIndex = static_cast<int>(architect->_inputLayers.size()) - 1;
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_architect_add_higher_layer(ogma_architect* architect, int width, int height, ogma_layer_type type, int* layerIndex) {
+    if (architect == nullptr || width <= 0 || height <= 0)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null architect or invalid layer size");
+
+    if (type != OGMA_LAYER_CHUNK && type != OGMA_LAYER_DISTANCE)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Unknown layer type");
+
+    return guard([&]() {
+        ogma_architect::Layer layer;
+        layer._size = Vec2i(width, height);
+        layer._type = static_cast<SparseFeaturesType>(type);
+
+        architect->_higherLayers.push_back(layer);
+
+        if (layerIndex != nullptr)
+            *layerIndex = static_cast<int>(architect->_higherLayers.size()) - 1;
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_architect_set_input_param(ogma_architect* architect, int layerIndex, const char* name, const char* value) {
+    if (architect == nullptr || name == nullptr || value == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null architect, name or value");
+
+    if (layerIndex < 0 || static_cast<size_t>(layerIndex) >= architect->_inputLayers.size())
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Input layer index out of range");
+
+    return guard([&]() {
+        architect->_inputLayers[layerIndex]._params.push_back(std::make_pair(std::string(name), std::string(value)));
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_architect_set_higher_param(ogma_architect* architect, int layerIndex, const char* name, const char* value) {
+    if (architect == nullptr || name == nullptr || value == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null architect, name or value");
+
+    if (layerIndex < 0 || static_cast<size_t>(layerIndex) >= architect->_higherLayers.size())
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Higher layer index out of range");
+
+    return guard([&]() {
+        architect->_higherLayers[layerIndex]._params.push_back(std::make_pair(std::string(name), std::string(value)));
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_architect_set_hierarchy_param(ogma_architect* architect, const char* name, const char* value) {
+    if (architect == nullptr || name == nullptr || value == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null architect, name or value");
+
+    return guard([&]() {
+        architect->_hierarchyParams[name] = value;
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_architect_generate(ogma_architect* architect, ogma_hierarchy** hierarchy) {
+    if (architect == nullptr || hierarchy == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null architect or hierarchy");
+
+    if (architect->_inputLayers.empty() || architect->_higherLayers.empty())
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "At least one input and one higher layer are required");
+
+    return guard([&]() {
+        Architect arch;
+        arch.initialize(architect->_seed, architect->_resources);
+
+        for (const ogma_architect::Layer &layer : architect->_inputLayers)
+            arch.addInputLayer(layer._size).setValues(layer._params);
+
+        for (const ogma_architect::Layer &layer : architect->_higherLayers)
+            arch.addHigherLayer(layer._size, layer._type).setValues(layer._params);
+
+        std::unique_ptr<ogma_hierarchy> h(new ogma_hierarchy());
+
+        h->_resources = architect->_resources;
+        h->_h = arch.generateHierarchy(architect->_hierarchyParams);
+
+        *hierarchy = h.release();
+
+        return OGMA_SUCCESS;
+    });
+}
+
+void ogma_hierarchy_destroy(ogma_hierarchy* hierarchy) {
+    delete hierarchy;
+}
+
+ogma_status ogma_hierarchy_get_num_inputs(const ogma_hierarchy* hierarchy, int* numInputs) {
+    if (hierarchy == nullptr || numInputs == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy or numInputs");
+
+    *numInputs = hierarchy->_h->getNumInputs();
+
+    return OGMA_SUCCESS;
+}
+
+ogma_status ogma_hierarchy_get_input_size(const ogma_hierarchy* hierarchy, int index, int* width, int* height) {
+    if (hierarchy == nullptr || width == nullptr || height == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy, width or height");
+
+    if (index < 0 || index >= hierarchy->_h->getNumInputs())
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Input index out of range");
+
+    Vec2i size = hierarchy->_h->getInputSize(index);
+
+    *width = size.x;
+    *height = size.y;
+
+    return OGMA_SUCCESS;
+}
+
+ogma_status ogma_hierarchy_step(ogma_hierarchy* hierarchy, const float* const* inputs, int numInputs, int learn, float tdError) {
+    ogma_status status = checkInputs(hierarchy, inputs, numInputs);
+
+    if (status != OGMA_SUCCESS)
+        return status;
+
+    return guard([&]() {
+        for (int i = 0; i < numInputs; i++)
+            hierarchy->_h->writeInputFeed(i, inputs[i]);
+
+        hierarchy->_h->activate();
+
+        if (learn) {
+            for (int i = 0; i < numInputs; i++)
+                hierarchy->_h->writeInputPredict(i, inputs[i]);
+
+            hierarchy->_h->learn(tdError);
+        }
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_hierarchy_activate(ogma_hierarchy* hierarchy, const float* const* inputsFeed, int numInputs) {
+    ogma_status status = checkInputs(hierarchy, inputsFeed, numInputs);
+
+    if (status != OGMA_SUCCESS)
+        return status;
+
+    return guard([&]() {
+        for (int i = 0; i < numInputs; i++)
+            hierarchy->_h->writeInputFeed(i, inputsFeed[i]);
+
+        hierarchy->_h->activate();
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_hierarchy_learn(ogma_hierarchy* hierarchy, const float* const* inputsPredict, int numInputs, float tdError) {
+    ogma_status status = checkInputs(hierarchy, inputsPredict, numInputs);
+
+    if (status != OGMA_SUCCESS)
+        return status;
+
+    return guard([&]() {
+        for (int i = 0; i < numInputs; i++)
+            hierarchy->_h->writeInputPredict(i, inputsPredict[i]);
+
+        hierarchy->_h->learn(tdError);
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_hierarchy_forecast(ogma_hierarchy* hierarchy, int index, float* predictions, size_t capacity) {
+    if (hierarchy == nullptr || predictions == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy or predictions");
+
+    if (index < 0 || index >= hierarchy->_h->getNumInputs())
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Input index out of range");
+
+    Vec2i size = hierarchy->_h->getInputSize(index);
+
+    if (capacity < static_cast<size_t>(size.x) * size.y)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Predictions buffer is smaller than the input layer");
+
+    return guard([&]() {
+        hierarchy->_h->readPredictions(index, predictions);
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_hierarchy_get_num_chunks(const ogma_hierarchy* hierarchy, int layerIndex, int* chunksX, int* chunksY) {
+    if (hierarchy == nullptr || chunksX == nullptr || chunksY == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy, chunksX or chunksY");
+
+    if (layerIndex < 0 || layerIndex >= hierarchy->_h->getPredictor().getHierarchy().getNumLayers())
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Layer index out of range");
+
+    Vec2i numChunks = hierarchy->_h->getNumChunks(layerIndex);
+
+    *chunksX = numChunks.x;
+    *chunksY = numChunks.y;
+
+    return OGMA_SUCCESS;
+}
+
+ogma_status ogma_hierarchy_read_chunk_winners(ogma_hierarchy* hierarchy, int layerIndex, int* indices, size_t capacity) {
+    if (hierarchy == nullptr || indices == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy or indices");
+
+    if (layerIndex < 0 || layerIndex >= hierarchy->_h->getPredictor().getHierarchy().getNumLayers())
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Layer index out of range");
+
+    Vec2i numChunks = hierarchy->_h->getNumChunks(layerIndex);
+
+    if (capacity < static_cast<size_t>(numChunks.x) * numChunks.y)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Indices buffer is smaller than the number of chunks");
+
+    return guard([&]() {
+        hierarchy->_h->readChunkWinners(layerIndex, indices);
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_hierarchy_save(ogma_hierarchy* hierarchy, const char* fileName) {
+    if (hierarchy == nullptr || fileName == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy or file name");
+
+    return guard([&]() -> ogma_status {
+        if (!hierarchy->_h->save(*hierarchy->_resources->getComputeSystem(), fileName))
+            return fail(OGMA_ERROR_IO, std::string("Unable to write ") + fileName);
+
+        return OGMA_SUCCESS;
+    });
+}
+
+ogma_status ogma_hierarchy_load(ogma_hierarchy* hierarchy, const char* fileName) {
+    if (hierarchy == nullptr || fileName == nullptr)
+        return fail(OGMA_ERROR_INVALID_ARGUMENT, "Null hierarchy or file name");
+
+    return guard([&]() -> ogma_status {
+        if (!hierarchy->_h->load(*hierarchy->_resources->getComputeSystem(), fileName))
+            return fail(OGMA_ERROR_IO, std::string("Unable to read ") + fileName);
+
+        return OGMA_SUCCESS;
+    });
+}
@@ -0,0 +1,175 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+/*
+    Flat C interface to OgmaNeo
+
+    Intended for embedding from languages with a C FFI (Rust, Go, ...) without
+    going through SWIG proxies. All objects are opaque handles, every call that
+    can fail returns an ogma_status, and inputs/predictions are passed as raw
+    row major float arrays (width * height values per input layer).
+
+    A handle may only be used from one thread at a time. Separate hierarchies
+    (each with their own resources) may be stepped concurrently.
+*/
+
+#ifndef OGMANEO_C_H
+#define OGMANEO_C_H
+
+#include <stddef.h>
+
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef OgmaNeoC_EXPORTS
+        #define OGMA_C_API __declspec(dllexport)
+    #elif defined OGMA_C_DLL
+        #define OGMA_C_API __declspec(dllimport)
+    #else
+        #define OGMA_C_API
+    #endif
+#elif __GNUC__ >= 4
+    #define OGMA_C_API __attribute__ ((visibility ("default")))
+#else
+    #define OGMA_C_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+\brief Status codes returned by the C interface
+*/
+typedef enum {
+    OGMA_SUCCESS = 0,
+    OGMA_ERROR_INVALID_ARGUMENT = 1,
+    OGMA_ERROR_IO = 2,
+    OGMA_ERROR_RUNTIME = 3
+} ogma_status;
+
+/*!
+\brief OpenCL device types (match ogmaneo::ComputeSystem::DeviceType)
+*/
+typedef enum {
+    OGMA_DEVICE_CPU = 0,
+    OGMA_DEVICE_GPU = 1,
+    OGMA_DEVICE_ALL = 2
+} ogma_device_type;
+
+/*!
+\brief Higher layer encoder types (match ogmaneo::SparseFeaturesType)
+*/
+typedef enum {
+    OGMA_LAYER_CHUNK = 0,
+    OGMA_LAYER_DISTANCE = 1
+} ogma_layer_type;
+
+//!@{
+/*!
+\brief Opaque handles
+*/
+typedef struct ogma_resources_s ogma_resources;
+typedef struct ogma_architect_s ogma_architect;
+typedef struct ogma_hierarchy_s ogma_hierarchy;
+//!@}
+
+/*!
+\brief Library version as "major.minor.patch"
+*/
+OGMA_C_API const char* ogma_version(void);
+
+/*!
+\brief Message describing the last error raised on the calling thread (empty if none)
+*/
+OGMA_C_API const char* ogma_last_error(void);
+
+//!@{
+/*!
+\brief Resources (OpenCL context, queue and cached programs)
+\param platformIndex, deviceIndex -1 selects the defaults.
+*/
+OGMA_C_API ogma_status ogma_resources_create(ogma_device_type type, int platformIndex, int deviceIndex, ogma_resources** resources);
+OGMA_C_API void ogma_resources_destroy(ogma_resources* resources);
+//!@}
+
+//!@{
+/*!
+\brief Architect, describes the layers of a hierarchy
+Parameter names and value formats are those of ParameterModifier (see README.md),
+for example "0.02", "true" or "(8, 8)".
+\param layerIndex optional, receives the index to use when setting layer parameters.
+*/
+OGMA_C_API ogma_status ogma_architect_create(ogma_resources* resources, unsigned int seed, ogma_architect** architect);
+OGMA_C_API void ogma_architect_destroy(ogma_architect* architect);
+
+OGMA_C_API ogma_status ogma_architect_add_input_layer(ogma_architect* architect, int width, int height, int* layerIndex);
+OGMA_C_API ogma_status ogma_architect_add_higher_layer(ogma_architect* architect, int width, int height, ogma_layer_type type, int* layerIndex);
+
+OGMA_C_API ogma_status ogma_architect_set_input_param(ogma_architect* architect, int layerIndex, const char* name, const char* value);
+OGMA_C_API ogma_status ogma_architect_set_higher_param(ogma_architect* architect, int layerIndex, const char* name, const char* value);
+OGMA_C_API ogma_status ogma_architect_set_hierarchy_param(ogma_architect* architect, const char* name, const char* value);
+
+OGMA_C_API ogma_status ogma_architect_generate(ogma_architect* architect, ogma_hierarchy** hierarchy);
+//!@}
+
+//!@{
+/*!
+\brief Hierarchy
+A hierarchy keeps its resources alive, the resources handle may be destroyed first.
+*/
+OGMA_C_API void ogma_hierarchy_destroy(ogma_hierarchy* hierarchy);
+
+OGMA_C_API ogma_status ogma_hierarchy_get_num_inputs(const ogma_hierarchy* hierarchy, int* numInputs);
+OGMA_C_API ogma_status ogma_hierarchy_get_input_size(const ogma_hierarchy* hierarchy, int index, int* width, int* height);
+//!@}
+
+//!@{
+/*!
+\brief Simulation
+\param inputs array of numInputs pointers, one per input layer, each holding width * height floats.
+\param learn non-zero to also learn, using the same inputs as prediction targets.
+*/
+OGMA_C_API ogma_status ogma_hierarchy_step(ogma_hierarchy* hierarchy, const float* const* inputs, int numInputs, int learn, float tdError);
+
+OGMA_C_API ogma_status ogma_hierarchy_activate(ogma_hierarchy* hierarchy, const float* const* inputsFeed, int numInputs);
+OGMA_C_API ogma_status ogma_hierarchy_learn(ogma_hierarchy* hierarchy, const float* const* inputsPredict, int numInputs, float tdError);
+//!@}
+
+/*!
+\brief Read the prediction (forecast of the next input) for an input layer
+\param predictions caller owned, at least width * height floats.
+\param capacity number of floats available in predictions.
+*/
+OGMA_C_API ogma_status ogma_hierarchy_forecast(ogma_hierarchy* hierarchy, int index, float* predictions, size_t capacity);
+
+/*!
+\brief Get the number of chunks in each dimension of a higher layer
+*/
+OGMA_C_API ogma_status ogma_hierarchy_get_num_chunks(const ogma_hierarchy* hierarchy, int layerIndex, int* chunksX, int* chunksY);
+
+/*!
+\brief Read the winner of each chunk of a higher layer as one index per chunk (dx + dy * chunkSize.x)
+\param indices caller owned, at least chunksX * chunksY ints, row major by chunk.
+\param capacity number of ints available in indices.
+*/
+OGMA_C_API ogma_status ogma_hierarchy_read_chunk_winners(ogma_hierarchy* hierarchy, int layerIndex, int* indices, size_t capacity);
+
+//!@{
+/*!
+\brief Serialization
+OGMA_ERROR_IO if the file could not be written or read (missing, corrupt or truncated, or a delta checkpoint),
+OGMA_ERROR_RUNTIME if a loaded file does not match the hierarchy.
+*/
+OGMA_C_API ogma_status ogma_hierarchy_save(ogma_hierarchy* hierarchy, const char* fileName);
+OGMA_C_API ogma_status ogma_hierarchy_load(ogma_hierarchy* hierarchy, const char* fileName);
+//!@}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,28 @@ using namespace ogmaneo;
 const std::string ogmaneo::ParameterModifier::_boolTrue = "true";
 const std::string ogmaneo::ParameterModifier::_boolFalse = "false";
 
+bool Resources::loadProgram(const std::string &name) {
+    std::shared_ptr<ComputeProgram> prog = std::make_shared<ComputeProgram>();
+
+    bool success;
+
+    if (name == "hierarchy")
+        success = prog->loadHierarchyKernel(*_cs);
+    else if (name == "predictor")
+        success = prog->loadPredictorKernel(*_cs);
+    else if (name == "chunk")
+        success = prog->loadSparseFeaturesKernel(*_cs, _chunk);
+    else if (name == "distance")
+        success = prog->loadSparseFeaturesKernel(*_cs, _distance);
+    else
+        return false;
+
+    if (success)
+        _programs[name] = prog;
+
+    return success;
+}
+
 void Architect::initialize(unsigned int seed, const std::shared_ptr<Resources> &resources) {
     _rng.seed(seed);
 
@@ -105,8 +127,8 @@ std::shared_ptr<class Hierarchy> Architect::generateHierarchy(std::unordered_map
     else
         pProg = _resources->_programs["predictor"];
 
-    std::vector<std::vector<Predictor::PredLayerDesc>> pLayerDescs(_higherLayers.size());
-    std::vector<FeatureHierarchy::LayerDesc> hLayerDescs(_higherLayers.size());
+    std::vector<std::vector<Predictor::PredLayerDesc>> pLayerDescs;
+    std::vector<FeatureHierarchy::LayerDesc> hLayerDescs;
 
     cl_float2 initWeightRange = { -0.01f, 0.01f };
 
@@ -116,12 +138,30 @@ std::shared_ptr<class Hierarchy> Architect::generateHierarchy(std::unordered_map
         initWeightRange = { range.x, range.y };
     }
 
-    // Fill out layer descs
+    fillLayerDescs(pLayerDescs, hLayerDescs, true);
+
+    std::vector<cl_int2> inputSizes(_inputLayers.size());
+    std::vector<cl_int2> inputChunkSizes(_inputLayers.size());
+
+    for (int i = 0; i < _inputLayers.size(); i++) {
+        inputSizes[i] = cl_int2{ _inputLayers[i]._size.x, _inputLayers[i]._size.y };
+        inputChunkSizes[i] = cl_int2{ _inputLayers[i]._chunkSize.x, _inputLayers[i]._chunkSize.y };
+    }
+
+    h->_p.createRandom(*_resources->_cs, *hProg, *pProg, inputSizes, inputChunkSizes, pLayerDescs, hLayerDescs, initWeightRange, _rng);
+
+    return h;
+}
+
+void Architect::fillLayerDescs(std::vector<std::vector<Predictor::PredLayerDesc>> &pLayerDescs, std::vector<FeatureHierarchy::LayerDesc> &hLayerDescs, bool loadPrograms) {
+    pLayerDescs.resize(_higherLayers.size());
+    hLayerDescs.resize(_higherLayers.size());
+
     for (int l = 0; l < _higherLayers.size(); l++) {
         if (_higherLayers[l]._params.find("hl_poolSteps") != _higherLayers[l]._params.end())
             hLayerDescs[l]._poolSteps = std::stoi(_higherLayers[l]._params["hl_poolSteps"]);
 
-        hLayerDescs[l]._sfDesc = sfDescFromName(l, _higherLayers[l]._type, _higherLayers[l]._size, SparseFeatures::_feedForwardRecurrent, _higherLayers[l]._params);
+        hLayerDescs[l]._sfDesc = sfDescFromName(l, _higherLayers[l]._type, _higherLayers[l]._size, SparseFeatures::_feedForwardRecurrent, _higherLayers[l]._params, loadPrograms);
 
         // P layer desc
         pLayerDescs[l].resize(l == 0 ? _inputLayers.size() : hLayerDescs[l - 1]._poolSteps);
@@ -143,22 +183,41 @@ std::shared_ptr<class Hierarchy> Architect::generateHierarchy(std::unordered_map
                 pLayerDescs[l][k]._radius = std::stoi(_higherLayers[l]._params["p_radius"]);
         }
     }
+}
+
+std::vector<MemoryUsage> Architect::estimateMemory() {
+    std::vector<MemoryUsage> usages;
+
+    MemoryUsage inputs("inputs", -1);
+
+    // Feed and predict image of each input
+    for (int i = 0; i < _inputLayers.size(); i++)
+        inputs.add(_memoryStates, imageBytes({ _inputLayers[i]._size.x, _inputLayers[i]._size.y, 1 }, 1), 2);
+
+    usages.push_back(inputs);
+
+    if (_higherLayers.empty())
+        return usages;
+
+    std::vector<std::vector<Predictor::PredLayerDesc>> pLayerDescs;
+    std::vector<FeatureHierarchy::LayerDesc> hLayerDescs;
+
+    fillLayerDescs(pLayerDescs, hLayerDescs, false);
 
     std::vector<cl_int2> inputSizes(_inputLayers.size());
-    std::vector<cl_int2> inputChunkSizes(_inputLayers.size());
 
-    for (int i = 0; i < _inputLayers.size(); i++) {
+    for (int i = 0; i < _inputLayers.size(); i++)
         inputSizes[i] = cl_int2{ _inputLayers[i]._size.x, _inputLayers[i]._size.y };
-        inputChunkSizes[i] = cl_int2{ _inputLayers[i]._chunkSize.x, _inputLayers[i]._chunkSize.y };
-    }
 
-    h->_p.createRandom(*_resources->_cs, *hProg, *pProg, inputSizes, inputChunkSizes, pLayerDescs, hLayerDescs, initWeightRange, _rng);
+    std::vector<MemoryUsage> layerUsages = Predictor::estimateMemory(inputSizes, pLayerDescs, hLayerDescs);
 
-    return h;
+    usages.insert(usages.end(), layerUsages.begin(), layerUsages.end());
+
+    return usages;
 }
 
 std::shared_ptr<SparseFeatures::SparseFeaturesDesc> Architect::sfDescFromName(int layerIndex, SparseFeaturesType type, const Vec2i &size,
-    SparseFeatures::InputType inputType, std::unordered_map<std::string, std::string> &params)
+    SparseFeatures::InputType inputType, std::unordered_map<std::string, std::string> &params, bool loadPrograms)
 {
     std::shared_ptr<SparseFeatures::SparseFeaturesDesc> sfDesc;
 
@@ -185,13 +244,13 @@ std::shared_ptr<SparseFeatures::SparseFeaturesDesc> Architect::sfDescFromName(in
             sfDescChunk->_initWeightRange = { initWeightRange.x, initWeightRange.y };
         }
 
-        if (_resources->_programs.find("chunk") == _resources->_programs.end()) {
+        if (_resources->_programs.find("chunk") != _resources->_programs.end())
+            sfDescChunk->_sfcProgram = _resources->_programs["chunk"];
+        else if (loadPrograms) {
             _resources->_programs["chunk"] = sfDescChunk->_sfcProgram = std::make_shared<ComputeProgram>();
 
             sfDescChunk->_sfcProgram->loadSparseFeaturesKernel(*_resources->_cs, _chunk);
         }
-        else
-            sfDescChunk->_sfcProgram = _resources->_programs["chunk"];
 
         if (layerIndex == 0) {
             sfDescChunk->_visibleLayerDescs.resize(_inputLayers.size());
@@ -302,13 +361,13 @@ std::shared_ptr<SparseFeatures::SparseFeaturesDesc> Architect::sfDescFromName(in
             sfDescDistance->_initWeightRange = { initWeightRange.x, initWeightRange.y };
         }
 
-        if (_resources->_programs.find("distance") == _resources->_programs.end()) {
+        if (_resources->_programs.find("distance") != _resources->_programs.end())
+            sfDescDistance->_sfdProgram = _resources->_programs["distance"];
+        else if (loadPrograms) {
             _resources->_programs["distance"] = sfDescDistance->_sfdProgram = std::make_shared<ComputeProgram>();
 
             sfDescDistance->_sfdProgram->loadSparseFeaturesKernel(*_resources->_cs, _distance);
         }
-        else
-            sfDescDistance->_sfdProgram = _resources->_programs["distance"];
 
         if (layerIndex == 0) {
             sfDescDistance->_visibleLayerDescs.resize(_inputLayers.size());
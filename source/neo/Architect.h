@@ -81,6 +81,24 @@ namespace ogmaneo {
             return _programs;
         }
 
+        /*!
+        \brief Build a program ahead of generateHierarchy, which then reuses it
+        \param name "hierarchy", "predictor", "chunk" or "distance".
+        \return false if the name is unknown or the program did not build.
+        */
+        bool loadProgram(const std::string &name);
+
+        /*!
+        \brief Host/device transfer counters of the compute system, per call site and direction
+        */
+        std::vector<TransferStats> getTransferStats() const {
+            return _cs->getTransferStats();
+        }
+
+        void resetTransferStats() {
+            _cs->resetTransferStats();
+        }
+
         friend class Architect;
         friend class Hierarchy;
     };
@@ -275,9 +293,18 @@ namespace ogmaneo {
 
         std::mt19937 _rng;
 
+        /*!
+        \brief Encoder desc of a higher layer
+        \param loadPrograms compile the encoder program if not yet in the resources (not needed for estimates).
+        */
         std::shared_ptr<SparseFeatures::SparseFeaturesDesc> sfDescFromName(
             int layerIndex, SparseFeaturesType type, const Vec2i &size,
-            SparseFeatures::InputType inputType, std::unordered_map<std::string, std::string> &params);
+            SparseFeatures::InputType inputType, std::unordered_map<std::string, std::string> &params, bool loadPrograms = true);
+
+        /*!
+        \brief Layer descs of the higher layers, from their parameters
+        */
+        void fillLayerDescs(std::vector<std::vector<Predictor::PredLayerDesc>> &pLayerDescs, std::vector<FeatureHierarchy::LayerDesc> &hLayerDescs, bool loadPrograms);
 
         std::shared_ptr<Resources> _resources;
 
@@ -302,6 +329,14 @@ namespace ogmaneo {
 
         std::shared_ptr<class Hierarchy> generateHierarchy(std::unordered_map<std::string, std::string> &additionalParams);
 
+        /*!
+        \brief Estimate the device memory of the hierarchy generateHierarchy would create, without allocating or compiling anything
+        Returns an "inputs" entry followed by an "encoder" and a "predictor" entry per higher layer.
+        Compare the total against CL_DEVICE_GLOBAL_MEM_SIZE, and each _largestImage against CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+        Requires initialize.
+        */
+        std::vector<MemoryUsage> estimateMemory();
+
         //!@{
         /*!
         \brief Serialization
@@ -0,0 +1,147 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#include "AsyncCheckpointer.h"
+#include "Hierarchy.h"
+
+using namespace ogmaneo;
+
+AsyncCheckpointer::AsyncCheckpointer(size_t maxPendingSnapshots, bool compress)
+    : _numPending(0), _maxPendingSnapshots(maxPendingSnapshots), _compress(compress), _pendingBytes(0), _stop(false)
+{
+    _thread = std::thread(&AsyncCheckpointer::run, this);
+}
+
+AsyncCheckpointer::~AsyncCheckpointer() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _stop = true;
+    }
+
+    _queued.notify_all();
+
+    _thread.join();
+}
+
+void AsyncCheckpointer::run() {
+    for (;;) {
+        std::unique_ptr<Snapshot> snapshot;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _queued.wait(lock, [this] { return _stop || !_queue.empty(); });
+
+            // Stop only once everything queued has been written
+            if (_queue.empty())
+                return;
+
+            snapshot = std::move(_queue.front());
+
+            _queue.pop_front();
+        }
+
+        size_t bytes = snapshot->_writer->getPendingBytes() + snapshot->_metadata.size();
+
+        // Waits for the device to host copies, then writes
+        bool success = snapshot->_writer->finish(snapshot->_fileName, snapshot->_metadata.data(), snapshot->_metadata.size());
+
+        if (snapshot->_callback)
+            snapshot->_callback(snapshot->_fileName, success);
+
+        snapshot.reset();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            _numPending--;
+            _pendingBytes -= bytes;
+        }
+
+        _written.notify_all();
+    }
+}
+
+bool AsyncCheckpointer::snapshot(Hierarchy &h, ComputeSystem &cs, const std::string &fileName, bool compact, const Callback &callback) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_numPending >= _maxPendingSnapshots)
+            return false;
+
+        _numPending++;
+    }
+
+    std::unique_ptr<Snapshot> snapshot;
+
+    try {
+        snapshot.reset(new Snapshot());
+
+        // An unopened writer captures, readbacks are only enqueued
+        snapshot->_writer.reset(new CheckpointWriter(compact));
+        snapshot->_writer->setCompress(_compress);
+        snapshot->_fileName = fileName;
+        snapshot->_callback = callback;
+
+        flatbuffers::FlatBufferBuilder builder;
+
+        flatbuffers::Offset<schemas::Hierarchy> fbHierarchy = h.save(builder, cs, snapshot->_writer.get());
+
+        schemas::FinishHierarchyBuffer(builder, fbHierarchy);
+
+        snapshot->_metadata.assign(builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
+    }
+    catch (...) {
+        // Readbacks enqueued so far write into memory of the writer, wait for them before it goes away
+        cs.getQueue().finish();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            _numPending--;
+        }
+
+        _written.notify_all();
+
+        throw;
+    }
+
+    // Start the copies now, the background thread only waits on them
+    cs.getQueue().flush();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _pendingBytes += snapshot->_writer->getPendingBytes() + snapshot->_metadata.size();
+
+        _queue.push_back(std::move(snapshot));
+    }
+
+    _queued.notify_one();
+
+    return true;
+}
+
+void AsyncCheckpointer::wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _written.wait(lock, [this] { return _numPending == 0; });
+}
+
+size_t AsyncCheckpointer::getNumPending() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _numPending;
+}
+
+size_t AsyncCheckpointer::getPendingBytes() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _pendingBytes;
+}
@@ -0,0 +1,119 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include "system/SharedLib.h"
+#include "system/Uncopyable.h"
+#include "Checkpoint.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ogmaneo {
+    class Hierarchy;
+
+    /*!
+    \brief Writes checkpoints of a Hierarchy on a background thread
+    snapshot only enqueues device to host copies of the hierarchy state (at the current step boundary)
+    and returns, so the next activate/learn can be enqueued straight away. The background thread waits
+    for the copies and writes them to a checkpoint file (see Checkpoint.h), then calls the completion callback.
+    */
+    class OGMA_API AsyncCheckpointer : private Uncopyable {
+    public:
+        /*!
+        \brief Completion callback, called on the background thread
+        \param fileName file that was written.
+        \param success false if the file could not be written.
+        */
+        typedef std::function<void(const std::string &fileName, bool success)> Callback;
+
+    private:
+        /*!
+        \brief Captured hierarchy state waiting to be written
+        */
+        struct Snapshot {
+            std::unique_ptr<CheckpointWriter> _writer;
+            std::vector<uint8_t> _metadata;
+            std::string _fileName;
+            Callback _callback;
+        };
+
+        std::thread _thread;
+
+        std::mutex _mutex;
+        std::condition_variable _queued;
+        std::condition_variable _written;
+
+        std::deque<std::unique_ptr<Snapshot>> _queue;
+
+        /*!
+        \brief Snapshots captured and not yet written (queued or being written)
+        */
+        size_t _numPending;
+        size_t _maxPendingSnapshots;
+
+        /*!
+        \brief Block compress images, on the background thread
+        */
+        bool _compress;
+
+        /*!
+        \brief Host memory held by pending snapshots
+        */
+        size_t _pendingBytes;
+
+        bool _stop;
+
+        /*!
+        \brief Background thread
+        */
+        void run();
+
+    public:
+        /*!
+        \brief Start the background writer
+        \param maxPendingSnapshots bound on snapshots held in host memory, each is about the size of the (compact) checkpoint.
+        \param compress block compress the images of every snapshot while writing (see Hierarchy::saveCheckpoint).
+        */
+        AsyncCheckpointer(size_t maxPendingSnapshots = 1, bool compress = false);
+
+        /*!
+        \brief Writes all pending snapshots, then stops the background thread
+        */
+        ~AsyncCheckpointer();
+
+        /*!
+        \brief Capture the state of a hierarchy and queue it for writing
+        Must be called from the thread that steps the hierarchy, between steps.
+        \param compact only store the live halves of double buffers (see Hierarchy::saveCheckpoint).
+        \param callback optional, called once the file is written.
+        \return false (and nothing is captured) if maxPendingSnapshots are already pending.
+        */
+        bool snapshot(Hierarchy &h, ComputeSystem &cs, const std::string &fileName, bool compact = true, const Callback &callback = Callback());
+
+        /*!
+        \brief Block until all pending snapshots are written
+        */
+        void wait();
+
+        //!@{
+        /*!
+        \brief Get the number of pending snapshots, and the host memory they hold
+        */
+        size_t getNumPending();
+        size_t getPendingBytes();
+        //!@}
+    };
+}
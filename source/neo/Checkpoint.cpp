@@ -0,0 +1,586 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#include "Checkpoint.h"
+
+#include "system/MappedFile.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <utility>
+
+using namespace ogmaneo;
+
+namespace {
+    uint64_t generateId() {
+        std::random_device rd;
+
+        uint64_t id = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^
+            static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+
+        // 0 means "no base"
+        return id != 0 ? id : 1;
+    }
+
+    // FNV-1a over 64 bit words, with the tail folded in bytewise
+    uint64_t hashTile(const uint8_t* data, size_t size) {
+        const uint64_t prime = 0x100000001b3ull;
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+
+        size_t words = size / sizeof(uint64_t);
+
+        for (size_t i = 0; i < words; i++) {
+            uint64_t word;
+            memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+
+            hash = (hash ^ word) * prime;
+        }
+
+        for (size_t i = words * sizeof(uint64_t); i < size; i++)
+            hash = (hash ^ data[i]) * prime;
+
+        return hash;
+    }
+
+    // Size of a scalar of an image, compression groups bytes by their position in a scalar
+    size_t scalarSize(cl_channel_type channelType) {
+        switch (channelType) {
+        case CL_FLOAT:
+        case CL_SIGNED_INT32:
+        case CL_UNSIGNED_INT32:
+            return 4;
+        case CL_HALF_FLOAT:
+        case CL_SIGNED_INT16:
+        case CL_UNSIGNED_INT16:
+        case CL_SNORM_INT16:
+        case CL_UNORM_INT16:
+            return 2;
+        default:
+            return 1;
+        }
+    }
+}
+
+CheckpointWriter::CheckpointWriter(bool compact, size_t maxPendingBytes)
+    : _file(nullptr), _id(generateId()), _offset(0), _good(false), _compact(compact), _compress(false), _inference(false), _precision(_float32), _quantize(false), _pendingBytes(0), _maxPendingBytes(maxPendingBytes),
+    _sectionStart(0), _recordBase(nullptr), _deltaBase(nullptr), _unchanged(false)
+{}
+
+void CheckpointWriter::write(const void* data, size_t size) {
+    if (!_good || size == 0)
+        return;
+
+    if (fwrite(data, 1, size, _file) != size)
+        _good = false;
+
+    _offset += size;
+}
+
+void CheckpointWriter::align() {
+    static const uint8_t zeros[checkpoint::payloadAlignment] = { 0 };
+
+    uint64_t padding = (checkpoint::payloadAlignment - _offset % checkpoint::payloadAlignment) % checkpoint::payloadAlignment;
+
+    write(zeros, static_cast<size_t>(padding));
+}
+
+bool CheckpointWriter::open(const std::string &fileName) {
+    close();
+
+    _payloads.clear();
+    _tiles.clear();
+    _sections.clear();
+
+    return openFile(fileName);
+}
+
+bool CheckpointWriter::openFile(const std::string &fileName) {
+    _file = fopen(fileName.c_str(), "wb");
+
+    if (_file == nullptr)
+        return false;
+
+    _fileName = fileName;
+    _offset = 0;
+    _good = true;
+
+    checkpoint::Header header;
+    memcpy(header._magic, checkpoint::magic, sizeof(header._magic));
+    header._version = checkpoint::version;
+    header._reserved = 0;
+
+    write(&header, sizeof(header));
+
+    return _good;
+}
+
+void CheckpointWriter::retire(bool wait) {
+    while (!_pending.empty()) {
+        if (!wait) {
+            cl_int status = _pending.front()._event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>();
+
+            // Still queued or running (errors are negative, and handled by retireFront)
+            if (status > CL_COMPLETE)
+                break;
+        }
+
+        retireFront();
+    }
+}
+
+void CheckpointWriter::writePayloadData(uint32_t index, const uint8_t* data, size_t size, size_t stride) {
+    size_t numTiles = (size + checkpoint::deltaTileSize - 1) / checkpoint::deltaTileSize;
+
+    if (_recordBase != nullptr) {
+        if (_recordBase->_payloadSizes.size() <= index) {
+            _recordBase->_payloadSizes.resize(index + 1, 0);
+            _recordBase->_tileHashes.resize(index + 1);
+        }
+
+        _recordBase->_payloadSizes[index] = size;
+        _recordBase->_tileHashes[index].resize(numTiles);
+
+        for (size_t t = 0; t < numTiles; t++) {
+            size_t offset = t * checkpoint::deltaTileSize;
+
+            _recordBase->_tileHashes[index][t] = hashTile(data + offset, std::min(checkpoint::deltaTileSize, size - offset));
+        }
+    }
+
+    if (_deltaBase != nullptr) {
+        // Payloads of a different size (or new ones) are stored whole, as tiles
+        bool compare = index < _deltaBase->_payloadSizes.size() && _deltaBase->_payloadSizes[index] == size;
+
+        for (size_t t = 0; t < numTiles; t++) {
+            size_t offset = t * checkpoint::deltaTileSize;
+            size_t tileSize = std::min(checkpoint::deltaTileSize, size - offset);
+
+            if (compare && hashTile(data + offset, tileSize) == _deltaBase->_tileHashes[index][t])
+                continue;
+
+            _tiles.push_back(schemas::CheckpointTile(index, static_cast<uint32_t>(tileSize), offset, _offset));
+
+            write(data + offset, tileSize);
+        }
+
+        _payloads[index] = schemas::CheckpointPayload(0, size);
+
+        return;
+    }
+
+    align();
+
+    if (stride != 0 && isCompressing()) {
+        compressPixels(data, size, stride, _compressed);
+
+        _payloads[index] = schemas::CheckpointPayload(_offset, _compressed.size());
+
+        write(_compressed.data(), _compressed.size());
+
+        return;
+    }
+
+    _payloads[index] = schemas::CheckpointPayload(_offset, size);
+
+    write(data, size);
+}
+
+void CheckpointWriter::retireFront() {
+    PendingImage &pending = _pending.front();
+
+    if (pending._event.wait() != CL_SUCCESS)
+        _good = false;
+
+    if (pending._quantize) {
+        quantizeWeights(reinterpret_cast<const float*>(pending._staging.data()), pending._numUnits, pending._numChannels, pending._depth, _precision, _quantized);
+
+        writePayloadData(pending._index, _quantized.data(), _quantized.size(), 0);
+    }
+    else
+        writePayloadData(pending._index, pending._staging.data(), pending._staging.size(), pending._stride);
+
+    _pendingBytes -= pending._staging.size();
+
+    _freeStaging.push_back(std::move(pending._staging));
+
+    _pending.pop_front();
+}
+
+uint32_t CheckpointWriter::writeImage(cl::Image &img, const cl::array<cl::size_type, 3> &region, size_t size, ComputeSystem &cs) {
+    // Write out whatever has already arrived, then make room for this readback (capturing keeps everything)
+    if (_file != nullptr) {
+        retire(false);
+
+        while (!_pending.empty() && _pendingBytes + size > _maxPendingBytes)
+            retireFront();
+    }
+
+    uint32_t index = static_cast<uint32_t>(_payloads.size());
+
+    // Offset is only known once the preceding payloads are written
+    _payloads.push_back(schemas::CheckpointPayload(0, size));
+
+    // Known to match the base, nothing to read back or store
+    if (_deltaBase != nullptr && _unchanged && index < _deltaBase->_payloadSizes.size() && _deltaBase->_payloadSizes[index] == size)
+        return index;
+
+    _pending.push_back(PendingImage());
+
+    PendingImage &pending = _pending.back();
+
+    pending._index = index;
+    pending._stride = scalarSize(img.getImageInfo<CL_IMAGE_FORMAT>().image_channel_data_type);
+
+    // Weights are float images, the channel count follows from the size
+    pending._quantize = isQuantizing();
+    pending._numUnits = region[0] * region[1];
+    pending._depth = region[2];
+    pending._numChannels = size / (pending._numUnits * pending._depth * sizeof(float));
+
+    if (!_freeStaging.empty()) {
+        pending._staging = std::move(_freeStaging.back());
+
+        _freeStaging.pop_back();
+    }
+
+    pending._staging.resize(size);
+
+    _pendingBytes += size;
+
+    cs.getQueue().enqueueReadImage(img, CL_FALSE, { 0, 0, 0 }, region, 0, 0, pending._staging.data(), nullptr, &pending._event);
+    cs.countTransfer(_deviceToHost, "checkpoint", size);
+
+    // Start the transfer now rather than when the queue is next flushed
+    cs.getQueue().flush();
+
+    return index;
+}
+
+uint32_t CheckpointWriter::writePayload(const uint8_t* data, size_t size) {
+    // Keep payloads in index order
+    retire(true);
+
+    uint32_t index = static_cast<uint32_t>(_payloads.size());
+
+    _payloads.push_back(schemas::CheckpointPayload(0, size));
+
+    writePayloadData(index, data, size, 0);
+
+    return index;
+}
+
+void CheckpointWriter::recordBase(CheckpointBase* base) {
+    _recordBase = base;
+
+    if (_recordBase != nullptr) {
+        _recordBase->_id = _id;
+        _recordBase->_compact = _compact;
+        _recordBase->_payloadSizes.clear();
+        _recordBase->_tileHashes.clear();
+    }
+}
+
+void CheckpointWriter::setInference(WeightPrecision precision) {
+    assert(_recordBase == nullptr && _deltaBase == nullptr);
+
+    _inference = true;
+    _compact = true;
+    _precision = precision;
+}
+
+void CheckpointWriter::setDeltaBase(const CheckpointBase* base) {
+    assert(base == nullptr || base->_compact == _compact);
+
+    _deltaBase = base;
+}
+
+bool CheckpointWriter::finish(const uint8_t* metadata, size_t metadataSize) {
+    if (_file == nullptr)
+        return false;
+
+    retire(true);
+
+    align();
+
+    uint64_t metadataOffset = _offset;
+
+    write(metadata, metadataSize);
+
+    flatbuffers::FlatBufferBuilder builder;
+
+    flatbuffers::Offset<flatbuffers::Vector<const schemas::CheckpointPayload*>> payloads = builder.CreateVectorOfStructs(_payloads);
+    flatbuffers::Offset<flatbuffers::Vector<const schemas::CheckpointTile*>> tiles = builder.CreateVectorOfStructs(_tiles);
+    flatbuffers::Offset<flatbuffers::String> baseFileName = _deltaBase != nullptr ? builder.CreateString(_deltaBase->_fileName) : 0;
+    flatbuffers::Offset<flatbuffers::Vector<const schemas::CheckpointSection*>> sections = builder.CreateVectorOfStructs(_sections);
+
+    flatbuffers::Offset<schemas::CheckpointIndex> index = schemas::CreateCheckpointIndex(builder,
+        metadataOffset, metadataSize, payloads,
+        _id, _deltaBase != nullptr ? _deltaBase->_id : 0, baseFileName, tiles, sections);
+
+    schemas::FinishCheckpointIndexBuffer(builder, index);
+
+    // Flatbuffers must start on an aligned address when read in place
+    align();
+
+    checkpoint::Footer footer;
+    footer._indexOffset = _offset;
+    footer._indexSize = builder.GetSize();
+    memcpy(footer._magic, checkpoint::magic, sizeof(footer._magic));
+    footer._version = checkpoint::version;
+
+    write(builder.GetBufferPointer(), builder.GetSize());
+    write(&footer, sizeof(footer));
+
+    if (fclose(_file) != 0)
+        _good = false;
+
+    _file = nullptr;
+
+    if (_recordBase != nullptr)
+        _recordBase->_fileName = _fileName;
+
+    return _good;
+}
+
+bool CheckpointWriter::finish(const std::string &fileName, const uint8_t* metadata, size_t metadataSize) {
+    assert(_file == nullptr);
+
+    if (!openFile(fileName)) {
+        close();
+
+        return false;
+    }
+
+    return finish(metadata, metadataSize);
+}
+
+void CheckpointWriter::close() {
+    // The device may still be writing into the staging memory
+    for (PendingImage &pending : _pending)
+        pending._event.wait();
+
+    _pending.clear();
+    _pendingBytes = 0;
+
+    if (_file != nullptr) {
+        fclose(_file);
+
+        _file = nullptr;
+    }
+
+    _good = false;
+}
+
+bool CheckpointReader::isCheckpoint(const uint8_t* data, size_t size) {
+    return data != nullptr && size >= sizeof(checkpoint::Header) + sizeof(checkpoint::Footer) &&
+        memcmp(data, checkpoint::magic, sizeof(checkpoint::magic)) == 0;
+}
+
+bool CheckpointReader::open(const uint8_t* data, size_t size) {
+    _data = nullptr;
+    _size = 0;
+    _index = nullptr;
+
+    if (!isCheckpoint(data, size))
+        return false;
+
+    checkpoint::Header header;
+    memcpy(&header, data, sizeof(header));
+
+    checkpoint::Footer footer;
+    memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+
+    if (header._version != checkpoint::version || footer._version != checkpoint::version ||
+        memcmp(footer._magic, checkpoint::magic, sizeof(checkpoint::magic)) != 0)
+        return false;
+
+    uint64_t indexEnd = size - sizeof(footer);
+
+    if (footer._indexOffset > indexEnd || footer._indexSize > indexEnd - footer._indexOffset)
+        return false;
+
+    const uint8_t* indexData = data + footer._indexOffset;
+
+    flatbuffers::Verifier verifier(indexData, static_cast<size_t>(footer._indexSize));
+
+    if (!schemas::VerifyCheckpointIndexBuffer(verifier) || !schemas::CheckpointIndexBufferHasIdentifier(indexData))
+        return false;
+
+    const schemas::CheckpointIndex* index = schemas::GetCheckpointIndex(indexData);
+
+    if (index->_payloads() == nullptr ||
+        index->_metadataOffset() > footer._indexOffset || index->_metadataSize() > footer._indexOffset - index->_metadataOffset())
+        return false;
+
+    // Delta payloads live in the base, only their tiles are in this file
+    if (index->_baseId() == 0) {
+        for (flatbuffers::uoffset_t i = 0; i < index->_payloads()->size(); i++) {
+            const schemas::CheckpointPayload* payload = index->_payloads()->Get(i);
+
+            if (payload->offset() > index->_metadataOffset() || payload->size() > index->_metadataOffset() - payload->offset())
+                return false;
+        }
+    }
+    else if (index->_tiles() != nullptr) {
+        for (flatbuffers::uoffset_t i = 0; i < index->_tiles()->size(); i++) {
+            const schemas::CheckpointTile* tile = index->_tiles()->Get(i);
+
+            if (tile->payload() >= index->_payloads()->size() ||
+                tile->fileOffset() > index->_metadataOffset() || tile->size() > index->_metadataOffset() - tile->fileOffset() ||
+                tile->offset() > index->_payloads()->Get(tile->payload())->size() ||
+                tile->size() > index->_payloads()->Get(tile->payload())->size() - tile->offset())
+                return false;
+        }
+    }
+
+    if (index->_sections() != nullptr) {
+        for (flatbuffers::uoffset_t i = 0; i < index->_sections()->size(); i++) {
+            const schemas::CheckpointSection* section = index->_sections()->Get(i);
+
+            if (section->firstPayload() > index->_payloads()->size() || section->numPayloads() > index->_payloads()->size() - section->firstPayload())
+                return false;
+        }
+    }
+
+    _data = data;
+    _size = size;
+    _index = index;
+
+    return true;
+}
+
+const schemas::CheckpointSection* CheckpointReader::findSection(schemas::CheckpointSectionType type, uint32_t layer) const {
+    for (uint32_t i = 0; i < getNumSections(); i++) {
+        const schemas::CheckpointSection* section = getSection(i);
+
+        if (section->type() == type && section->layer() == layer)
+            return section;
+    }
+
+    return nullptr;
+}
+
+bool CheckpointReader::getSectionRange(const schemas::CheckpointSection* section, const uint8_t* &data, size_t &size) const {
+    if (isDelta() || section->numPayloads() == 0)
+        return false;
+
+    const schemas::CheckpointPayload* first = _index->_payloads()->Get(section->firstPayload());
+    const schemas::CheckpointPayload* last = _index->_payloads()->Get(section->firstPayload() + section->numPayloads() - 1);
+
+    if (last->offset() + last->size() < first->offset())
+        return false;
+
+    data = _data + first->offset();
+    size = static_cast<size_t>(last->offset() + last->size() - first->offset());
+
+    return true;
+}
+
+const uint8_t* CheckpointReader::getPayload(uint32_t index, size_t &size) const {
+    if (_index == nullptr || isDelta() || index >= _index->_payloads()->size()) {
+        size = 0;
+
+        return nullptr;
+    }
+
+    const schemas::CheckpointPayload* payload = _index->_payloads()->Get(index);
+
+    size = static_cast<size_t>(payload->size());
+
+    return _data + payload->offset();
+}
+
+size_t CheckpointReader::getPayloadSize(uint32_t index) const {
+    if (_index == nullptr || index >= _index->_payloads()->size())
+        return 0;
+
+    return static_cast<size_t>(_index->_payloads()->Get(index)->size());
+}
+
+bool ogmaneo::compactCheckpoint(const std::string &baseFileName, const std::vector<std::string> &deltaFileNames, const std::string &fileName) {
+    MappedFile baseFile;
+    CheckpointReader base;
+
+    if (!baseFile.open(baseFileName) || !base.open(baseFile.data(), baseFile.size()) || base.isDelta())
+        return false;
+
+    std::vector<std::unique_ptr<MappedFile>> deltaFiles(deltaFileNames.size());
+    std::vector<CheckpointReader> deltas(deltaFileNames.size());
+
+    for (size_t d = 0; d < deltaFileNames.size(); d++) {
+        deltaFiles[d].reset(new MappedFile());
+
+        if (!deltaFiles[d]->open(deltaFileNames[d]) || !deltas[d].open(deltaFiles[d]->data(), deltaFiles[d]->size()))
+            return false;
+
+        if (!deltas[d].isDelta() || deltas[d].getBaseId() != base.getId() || deltas[d].getNumPayloads() != base.getNumPayloads())
+            return false;
+    }
+
+    // Every delta holds all changes since the base (tiles are compared with the base, not the previous delta),
+    // so the latest one alone gives the current state. Applying earlier ones too would keep tiles that changed
+    // and then went back to their base bytes. Earlier deltas are only validated
+    const CheckpointReader &latest = deltas.empty() ? base : deltas.back();
+
+    std::vector<std::vector<const schemas::CheckpointTile*>> tiles(base.getNumPayloads());
+
+    if (!deltas.empty()) {
+        for (uint32_t t = 0; t < latest.getNumTiles(); t++) {
+            const schemas::CheckpointTile* tile = latest.getTile(t);
+
+            if (tile->payload() >= base.getNumPayloads())
+                return false;
+
+            tiles[tile->payload()].push_back(tile);
+        }
+    }
+
+    CheckpointWriter writer;
+
+    if (!writer.open(fileName))
+        return false;
+
+    std::vector<uint8_t> patched;
+
+    for (uint32_t i = 0; i < base.getNumPayloads(); i++) {
+        size_t baseSize;
+        const uint8_t* data = base.getPayload(i, baseSize);
+
+        // Payloads that changed size are stored whole in the delta
+        size_t size = latest.getPayloadSize(i);
+
+        if (tiles[i].empty() && size == baseSize) {
+            writer.writePayload(data, size);
+
+            continue;
+        }
+
+        patched.assign(size, 0);
+
+        memcpy(patched.data(), data, std::min(size, baseSize));
+
+        for (const schemas::CheckpointTile* tile : tiles[i]) {
+            if (tile->offset() + tile->size() > size)
+                return false;
+
+            memcpy(patched.data() + tile->offset(), latest.getTileData(tile), tile->size());
+        }
+
+        writer.writePayload(patched.data(), size);
+    }
+
+    for (uint32_t i = 0; i < latest.getNumSections(); i++)
+        writer.addSection(*latest.getSection(i));
+
+    return writer.finish(latest.getMetadata(), latest.getMetadataSize());
+}
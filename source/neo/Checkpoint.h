@@ -0,0 +1,535 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include "system/SharedLib.h"
+#include "system/ComputeSystem.h"
+#include "system/Uncopyable.h"
+#include "Helpers.h"
+#include "schemas/Checkpoint_generated.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ogmaneo {
+    /*!
+    \brief Streaming checkpoint files
+
+    Layout: header | image payloads | metadata | index | footer
+
+    Images are read back from the device and streamed to the file as payloads
+    aligned to payloadAlignment bytes. The metadata is a regular Hierarchy flatbuffer whose
+    images reference their payload (ExternalArray) instead of holding the pixels, so it stays small.
+    The index (CheckpointIndex flatbuffer) locates the metadata and every payload, and the
+    fixed size footer locates the index.
+
+    Saving therefore only needs a bounded amount of staging memory on top of the metadata,
+    instead of the whole model inside a FlatBufferBuilder.
+    */
+    namespace checkpoint {
+        //!@{
+        /*!
+        \brief Format constants
+        */
+        const char magic[4] = { 'O', 'C', 'K', 'P' };
+        const uint32_t version = 1;
+        const uint64_t payloadAlignment = 64;
+
+        /*!
+        \brief Default bound on host staging memory for readbacks in flight while saving
+        */
+        const size_t defaultMaxPendingBytes = 64 * 1024 * 1024;
+
+        /*!
+        \brief Granularity at which delta checkpoints compare payloads with their base
+        */
+        const size_t deltaTileSize = 16 * 1024;
+        //!@}
+
+        /*!
+        \brief Fixed size header, at the start of the file
+        */
+        struct Header {
+            char _magic[4];
+            uint32_t _version;
+            uint64_t _reserved;
+        };
+
+        /*!
+        \brief Fixed size footer, at the end of the file
+        */
+        struct Footer {
+            uint64_t _indexOffset;
+            uint64_t _indexSize;
+            char _magic[4];
+            uint32_t _version;
+        };
+    }
+
+    /*!
+    \brief What delta checkpoints are compared against
+    Recorded while saving a base checkpoint: a hash per tile (checkpoint::deltaTileSize bytes) of every payload.
+    */
+    struct OGMA_API CheckpointBase {
+        std::string _fileName;
+        uint64_t _id;
+        bool _compact;
+
+        std::vector<uint64_t> _payloadSizes;
+        std::vector<std::vector<uint64_t>> _tileHashes;
+
+        CheckpointBase()
+            : _id(0), _compact(false)
+        {}
+    };
+
+    /*!
+    \brief Writes a checkpoint file as it is produced
+    Image readbacks are only enqueued (non-blocking), and each payload is written to the file once its
+    transfer has completed, while later transfers are still in flight. Host staging memory for
+    outstanding readbacks is bounded by maxPendingBytes (a single larger image is still allowed).
+
+    A writer that has not been opened captures instead: readbacks are enqueued and kept in host
+    memory (no bound) until finish(fileName, ...), which may be called from another thread.
+
+    Delta checkpoints (setDeltaBase) only store the tiles of each payload whose hash differs from the base,
+    and skip the readback of images marked unchanged (setUnchanged). compactCheckpoint merges a base
+    and its deltas back into a full checkpoint.
+
+    Image payloads can be block compressed (setCompress), the compression runs as readbacks are retired
+    (on the background thread when capturing).
+    */
+    class OGMA_API CheckpointWriter : private Uncopyable {
+    private:
+        /*!
+        \brief Readback in flight
+        */
+        struct PendingImage {
+            cl::Event _event;
+            std::vector<uint8_t> _staging;
+            uint32_t _index;
+            size_t _stride;
+
+            //!@{
+            /*!
+            \brief Quantized weights, unit (x, y) and channel counts of the image
+            */
+            bool _quantize;
+            size_t _numUnits;
+            size_t _numChannels;
+            size_t _depth;
+            //!@}
+        };
+
+        FILE* _file;
+        std::string _fileName;
+
+        /*!
+        \brief Unique id of this checkpoint, deltas refer to their base by id
+        */
+        uint64_t _id;
+
+        /*!
+        \brief Current write position (bytes from the start of the file)
+        */
+        uint64_t _offset;
+
+        /*!
+        \brief False once any write failed
+        */
+        bool _good;
+
+        /*!
+        \brief Only store the live halves of double buffers (see DoubleBufferLiveness)
+        */
+        bool _compact;
+
+        /*!
+        \brief Block compress image payloads (see compressPixels)
+        */
+        bool _compress;
+        std::vector<uint8_t> _compressed;
+
+        //!@{
+        /*!
+        \brief Inference export, weights are stored at _precision (see quantizeWeights)
+        */
+        bool _inference;
+        WeightPrecision _precision;
+        bool _quantize;
+        std::vector<uint8_t> _quantized;
+        //!@}
+
+        std::deque<PendingImage> _pending;
+        size_t _pendingBytes;
+        size_t _maxPendingBytes;
+
+        /*!
+        \brief Staging memory of retired readbacks, reused by later ones
+        */
+        std::vector<std::vector<uint8_t>> _freeStaging;
+
+        std::vector<schemas::CheckpointPayload> _payloads;
+
+        /*!
+        \brief Payload ranges of layers, and the start of the open section
+        */
+        std::vector<schemas::CheckpointSection> _sections;
+        uint32_t _sectionStart;
+
+        //!@{
+        /*!
+        \brief Delta checkpoints
+        */
+        CheckpointBase* _recordBase;
+        const CheckpointBase* _deltaBase;
+        bool _unchanged;
+
+        std::vector<schemas::CheckpointTile> _tiles;
+        //!@}
+
+        /*!
+        \brief Write out a payload whose data is available on the host (full, compressed, or changed tiles for deltas)
+        \param stride size of a scalar in bytes for image payloads, 0 for payloads that are never compressed.
+        */
+        void writePayloadData(uint32_t index, const uint8_t* data, size_t size, size_t stride);
+
+        /*!
+        \brief Write completed readbacks, in order
+        \param wait if true wait for (and write) all of them, else stop at the first one still in flight.
+        */
+        void retire(bool wait);
+
+        /*!
+        \brief Wait for and write the oldest readback
+        */
+        void retireFront();
+
+        /*!
+        \brief Write raw bytes at the current position
+        */
+        void write(const void* data, size_t size);
+
+        /*!
+        \brief Zero pad up to a multiple of checkpoint::payloadAlignment
+        */
+        void align();
+
+        /*!
+        \brief Create the file and write the header, keeping captured readbacks
+        */
+        bool openFile(const std::string &fileName);
+
+    public:
+        /*!
+        \param compact store only the live halves of double buffers and skip scratch buffers.
+        Must be used at a step boundary (after stepEnd), which is the case between Hierarchy calls.
+        \param maxPendingBytes bound on host staging memory for readbacks in flight.
+        */
+        CheckpointWriter(bool compact = false, size_t maxPendingBytes = checkpoint::defaultMaxPendingBytes);
+
+        ~CheckpointWriter() {
+            close();
+        }
+
+        /*!
+        \brief Create the file and write the header, returns false if it could not be created
+        */
+        bool open(const std::string &fileName);
+
+        /*!
+        \brief Enqueue the readback of an image and append it as a payload once complete
+        The image must not be modified by later enqueued commands before finish (the queue is in order).
+        \param region size of the image in pixels (depth 1 for 2D images).
+        \param size size of the image in bytes.
+        \return index of the payload, to be stored in an ExternalArray.
+        */
+        uint32_t writeImage(cl::Image &img, const cl::array<cl::size_type, 3> &region, size_t size, ComputeSystem &cs);
+
+        /*!
+        \brief Append a payload already in host memory (written immediately, after any readbacks in flight)
+        \return index of the payload.
+        */
+        uint32_t writePayload(const uint8_t* data, size_t size);
+
+        //!@{
+        /*!
+        \brief Group the payloads written in between as the section of a layer (sections do not nest)
+        */
+        void beginSection() {
+            _sectionStart = static_cast<uint32_t>(_payloads.size());
+        }
+
+        void endSection(schemas::CheckpointSectionType type, uint32_t layer) {
+            _sections.push_back(schemas::CheckpointSection(type, layer, _sectionStart, static_cast<uint32_t>(_payloads.size()) - _sectionStart));
+        }
+
+        void addSection(const schemas::CheckpointSection &section) {
+            _sections.push_back(section);
+        }
+        //!@}
+
+        /*!
+        \brief Record tile hashes of every payload into base, for later delta checkpoints
+        base is only complete once finish succeeds.
+        */
+        void recordBase(CheckpointBase* base);
+
+        /*!
+        \brief Write a delta checkpoint against base (must outlive the writer), instead of a full one
+        The writer must use the same compact setting as the base.
+        */
+        void setDeltaBase(const CheckpointBase* base);
+
+        /*!
+        \brief Mark the images written next as unchanged since the delta base (no readback is made for them)
+        */
+        void setUnchanged(bool unchanged) {
+            _unchanged = unchanged;
+        }
+
+        /*!
+        \brief Block compress image payloads, set before saving anything
+        Ignored for base and delta checkpoints, whose tiles are compared uncompressed.
+        */
+        void setCompress(bool compress) {
+            _compress = compress;
+        }
+
+        /*!
+        \brief Whether images are stored compressed (CompressedArray) rather than raw (ExternalArray)
+        */
+        bool isCompressing() const {
+            return _compress && _recordBase == nullptr && _deltaBase == nullptr;
+        }
+
+        /*!
+        \brief Write an inference-only export instead of a checkpoint, set before saving anything
+        Implies compact, and also skips state that is only read by learn (see DoubleBufferLiveness).
+        Weights are stored at the given precision. Not for base or delta checkpoints.
+        */
+        void setInference(WeightPrecision precision);
+
+        /*!
+        \brief Mark the images written next as weights (quantized by inference exports)
+        */
+        void setQuantize(bool quantize) {
+            _quantize = quantize;
+        }
+
+        /*!
+        \brief Whether an inference-only export is written
+        */
+        bool isInference() const {
+            return _inference;
+        }
+
+        /*!
+        \brief Whether images are stored quantized (QuantizedArray)
+        */
+        bool isQuantizing() const {
+            return _inference && _quantize && _precision != _float32;
+        }
+
+        /*!
+        \brief Get the precision of weights in inference exports
+        */
+        WeightPrecision getPrecision() const {
+            return _precision;
+        }
+
+        /*!
+        \brief Whether tile hashes are being recorded into a base
+        */
+        bool isRecordingBase() const {
+            return _recordBase != nullptr;
+        }
+
+        /*!
+        \brief Write the metadata (finished Hierarchy flatbuffer), the index and the footer, then close the file
+        \return false if any write (including earlier payloads) failed.
+        */
+        bool finish(const uint8_t* metadata, size_t metadataSize);
+
+        /*!
+        \brief Create the file and write captured payloads, the metadata, the index and the footer
+        For writers that were never opened (capture), waits for the captured readbacks.
+        \return false if the file could not be written.
+        */
+        bool finish(const std::string &fileName, const uint8_t* metadata, size_t metadataSize);
+
+        /*!
+        \brief Close the file without finishing it (it will not load), waits for readbacks still in flight
+        */
+        void close();
+
+        /*!
+        \brief Get the host staging memory held by readbacks not yet written
+        */
+        size_t getPendingBytes() const {
+            return _pendingBytes;
+        }
+
+        /*!
+        \brief Whether only live double buffer halves are stored
+        */
+        bool isCompact() const {
+            return _compact;
+        }
+
+        /*!
+        \brief Whether all writes so far succeeded
+        */
+        bool good() const {
+            return _good;
+        }
+    };
+
+    /*!
+    \brief Reads a checkpoint file in place (typically from a MappedFile)
+    The memory passed to open must outlive the reader and any uploads made from its payloads.
+    */
+    class OGMA_API CheckpointReader {
+    private:
+        const uint8_t* _data;
+        size_t _size;
+
+        const schemas::CheckpointIndex* _index;
+
+        /*!
+        \brief Host memory handed out by allocate
+        */
+        std::vector<std::vector<uint8_t>> _buffers;
+
+    public:
+        CheckpointReader()
+            : _data(nullptr), _size(0), _index(nullptr)
+        {}
+
+        /*!
+        \brief Whether a buffer starts with a checkpoint header (as opposed to a plain Hierarchy flatbuffer)
+        */
+        static bool isCheckpoint(const uint8_t* data, size_t size);
+
+        /*!
+        \brief Validate the header, footer, index and payload ranges
+        \return false if the buffer is not a valid checkpoint.
+        */
+        bool open(const uint8_t* data, size_t size);
+
+        //!@{
+        /*!
+        \brief Metadata (Hierarchy flatbuffer)
+        */
+        const uint8_t* getMetadata() const {
+            return _data + _index->_metadataOffset();
+        }
+
+        size_t getMetadataSize() const {
+            return static_cast<size_t>(_index->_metadataSize());
+        }
+        //!@}
+
+        /*!
+        \brief Get the number of payloads
+        */
+        uint32_t getNumPayloads() const {
+            return _index->_payloads()->size();
+        }
+
+        //!@{
+        /*!
+        \brief Delta checkpoints, their payloads are the base ones patched with their tiles
+        */
+        bool isDelta() const {
+            return _index->_baseId() != 0;
+        }
+
+        uint64_t getId() const {
+            return _index->_id();
+        }
+
+        uint64_t getBaseId() const {
+            return _index->_baseId();
+        }
+
+        std::string getBaseFileName() const {
+            return _index->_baseFileName() != nullptr ? _index->_baseFileName()->str() : std::string();
+        }
+
+        uint32_t getNumTiles() const {
+            return _index->_tiles() != nullptr ? _index->_tiles()->size() : 0;
+        }
+
+        const schemas::CheckpointTile* getTile(uint32_t index) const {
+            return _index->_tiles()->Get(index);
+        }
+
+        const uint8_t* getTileData(const schemas::CheckpointTile* tile) const {
+            return _data + tile->fileOffset();
+        }
+        //!@}
+
+        //!@{
+        /*!
+        \brief Layer sections, payload ranges of each layer
+        */
+        uint32_t getNumSections() const {
+            return _index->_sections() != nullptr ? _index->_sections()->size() : 0;
+        }
+
+        const schemas::CheckpointSection* getSection(uint32_t index) const {
+            return _index->_sections()->Get(index);
+        }
+        //!@}
+
+        /*!
+        \brief Find the section (payload range) of a layer, returns nullptr if there is none
+        Checkpoints written before sections existed have none, they still load as a whole.
+        */
+        const schemas::CheckpointSection* findSection(schemas::CheckpointSectionType type, uint32_t layer) const;
+
+        /*!
+        \brief Get the bytes spanned by the payloads of a section (from the first payload to the end of the last)
+        \return false if the section has no payloads (or for deltas).
+        */
+        bool getSectionRange(const schemas::CheckpointSection* section, const uint8_t* &data, size_t &size) const;
+
+        /*!
+        \brief Get a payload, returns nullptr if the index is out of range (or for deltas)
+        \param size receives the size of the payload in bytes.
+        */
+        const uint8_t* getPayload(uint32_t index, size_t &size) const;
+
+        /*!
+        \brief Get the size of a payload in bytes, also for deltas (0 if the index is out of range)
+        */
+        size_t getPayloadSize(uint32_t index) const;
+
+        /*!
+        \brief Host memory that lives as long as the reader, for payloads that are decompressed before upload
+        */
+        uint8_t* allocate(size_t size) {
+            _buffers.push_back(std::vector<uint8_t>(size));
+
+            return _buffers.back().data();
+        }
+    };
+
+    /*!
+    \brief Merge a base checkpoint and its deltas into a full checkpoint
+    Each delta holds all changes since the base, so the result is the base patched with the last delta only
+    (payloads, sections and metadata), the others are only checked to belong to the base. Only one payload is held in memory at a time.
+    \return false if a file could not be read or written, or a delta does not belong to the base.
+    */
+    OGMA_API bool compactCheckpoint(const std::string &baseFileName, const std::vector<std::string> &deltaFileNames, const std::string &fileName);
+}
@@ -8,10 +8,40 @@
 
 #include "FeatureHierarchy.h"
 #include "SparseFeaturesChunk.h"
+#include "SparseFeaturesDistance.h"
 #include "PredictorLayer.h"
+#include "Checkpoint.h"
+
+#include <cmath>
 
 using namespace ogmaneo;
 
+namespace {
+    // Whether a saved encoder has the image shapes of sf: hidden and chunk size, and size, radius and samples of each visible layer
+    template<class SF, class FbSF>
+    bool isEncoderCompatible(const SF &sf, const FbSF* fbSF) {
+        if (fbSF == nullptr || fbSF->_hiddenSize() == nullptr || fbSF->_chunkSize() == nullptr ||
+            fbSF->_visibleLayerDescs() == nullptr || fbSF->_visibleLayers() == nullptr)
+            return false;
+
+        if (fbSF->_hiddenSize()->x() != sf.getHiddenSize().x || fbSF->_hiddenSize()->y() != sf.getHiddenSize().y ||
+            fbSF->_chunkSize()->x() != sf.getChunkSize().x || fbSF->_chunkSize()->y() != sf.getChunkSize().y ||
+            fbSF->_visibleLayerDescs()->Length() != sf.getNumVisibleLayers() || fbSF->_visibleLayers()->Length() != sf.getNumVisibleLayers())
+            return false;
+
+        for (flatbuffers::uoffset_t vli = 0; vli < fbSF->_visibleLayerDescs()->Length(); vli++) {
+            const typename SF::VisibleLayerDesc &desc = sf.getVisibleLayerDesc(vli);
+
+            if (fbSF->_visibleLayerDescs()->Get(vli)->_size().x() != desc._size.x || fbSF->_visibleLayerDescs()->Get(vli)->_size().y() != desc._size.y ||
+                fbSF->_visibleLayerDescs()->Get(vli)->_radius() != desc._radius ||
+                fbSF->_visibleLayerDescs()->Get(vli)->_numSamples() != desc._numSamples)
+                return false;
+        }
+
+        return true;
+    }
+}
+
 void FeatureHierarchy::createRandom(ComputeSystem &cs, ComputeProgram &fhProgram,
     const std::vector<LayerDesc> &layerDescs,
     std::mt19937 &rng)
@@ -22,11 +52,21 @@ void FeatureHierarchy::createRandom(ComputeSystem &cs, ComputeProgram &fhProgram
 
     for (int l = 0; l < _layers.size(); l++)
         _layers[l]._sf = _layerDescs[l]._sfDesc->sparseFeaturesFactory();
+
+    _chunkWinnerIndicesKernel = cl::Kernel(fhProgram.getProgram(), "fhChunkWinnerIndices");
 }
 
 void FeatureHierarchy::activate(ComputeSystem &cs, const std::vector<cl::Image2D> &inputs, std::mt19937 &rng) {
+    OGMA_METRIC_SCOPE(cs, "fh.activate");
+
     // Add a sample to the first layer
-    _layers.front()._sf->subSample(cs, inputs, rng);
+    cs.setProfileTag("encoder", 0);
+
+    {
+        TraceScope scope(cs.getTracer(), "encoder", "subSample", 0);
+
+        _layers.front()._sf->subSample(cs, inputs, rng);
+    }
 
     // Activate
     bool prevClockReset = true;
@@ -34,17 +74,26 @@ void FeatureHierarchy::activate(ComputeSystem &cs, const std::vector<cl::Image2D
     for (int l = 0; l < _layers.size(); l++) {
         // Add input to pool
         if (prevClockReset) {
+            TraceScope scope(cs.getTracer(), "encoder", "activate", l);
+
             _layers[l]._clock++;
 
+            cs.setProfileTag("encoder", l);
+
             // Update layer
             _layers[l]._sf->activate(cs, rng);
 
             _layers[l]._sf->stepEnd(cs);
 
             // Add a sample to the next layer
-            if (l < _layers.size() - 1)
+            if (l < _layers.size() - 1) {
+                cs.setProfileTag("encoder", l + 1);
+
                 _layers[l + 1]._sf->subSample(cs, { _layers[l]._sf->getHiddenStates()[_back] }, rng);
+            }
         }
+        else
+            OGMA_METRIC_COUNT_AT(cs, "skips", "encoder", l, 1);
 
         _layers[l]._tpReset = prevClockReset;
 
@@ -58,14 +107,46 @@ void FeatureHierarchy::activate(ComputeSystem &cs, const std::vector<cl::Image2D
 
         _layers[l]._tpNextReset = prevClockReset;
     }
+
+    cs.setProfileTag(nullptr, -1);
 }
 
 void FeatureHierarchy::learn(ComputeSystem &cs, std::mt19937 &rng) {
     for (int l = 0; l < _layers.size(); l++) {
         // Add input to pool
-        if (_layers[l]._tpReset)
+        if (_layers[l]._tpReset) {
+            TraceScope scope(cs.getTracer(), "encoder", "learn", l);
+
+            cs.setProfileTag("encoder", l);
+
             _layers[l]._sf->learn(cs, rng);
+        }
     }
+
+    cs.setProfileTag(nullptr, -1);
+}
+
+void FeatureHierarchy::getChunkWinnerIndices(ComputeSystem &cs, int li, cl::Buffer &indices) {
+    cl_int2 numChunks = getNumChunks(li);
+
+    int argIndex = 0;
+
+    _chunkWinnerIndicesKernel.setArg(argIndex++, _layers[li]._sf->getChunkWinners()[_back]);
+    _chunkWinnerIndicesKernel.setArg(argIndex++, indices);
+    _chunkWinnerIndicesKernel.setArg(argIndex++, _layers[li]._sf->getChunkSize());
+    _chunkWinnerIndicesKernel.setArg(argIndex++, numChunks.x);
+
+    cs.enqueueKernel(_chunkWinnerIndicesKernel, cl::NDRange(numChunks.x, numChunks.y));
+}
+
+cl_int2 FeatureHierarchy::getNumChunks(int li) const {
+    cl_int2 hiddenSize = _layers[li]._sf->getHiddenSize();
+    cl_int2 chunkSize = _layers[li]._sf->getChunkSize();
+
+    int chunksInX = static_cast<int>(std::ceil(static_cast<float>(hiddenSize.x) / static_cast<float>(chunkSize.x)));
+    int chunksInY = static_cast<int>(std::ceil(static_cast<float>(hiddenSize.y) / static_cast<float>(chunkSize.y)));
+
+    return { chunksInX, chunksInY };
 }
 
 void FeatureHierarchy::clearMemory(ComputeSystem &cs) {
@@ -73,6 +154,21 @@ void FeatureHierarchy::clearMemory(ComputeSystem &cs) {
         _layers[l]._sf->clearMemory(cs);
 }
 
+FeatureHierarchy FeatureHierarchy::clone(ComputeSystem &cs) const {
+    FeatureHierarchy h = *this;
+
+    // Descs are shared pointers too, and loads write to them
+    for (LayerDesc &layerDesc : h._layerDescs)
+        layerDesc._sfDesc = layerDesc._sfDesc->clone();
+
+    for (Layer &layer : h._layers)
+        layer._sf = layer._sf->clone(cs);
+
+    h._chunkWinnerIndicesKernel = ogmaneo::copy(_chunkWinnerIndicesKernel);
+
+    return h;
+}
+
 void FeatureHierarchy::LayerDesc::load(const schemas::FeatureHierarchyLayerDesc* fbFeatureHierarchyLayerDesc, ComputeSystem &cs) {
     _sfDesc->load(fbFeatureHierarchyLayerDesc->_sfDesc(), cs);
     _poolSteps = fbFeatureHierarchyLayerDesc->_poolSteps();
@@ -83,17 +179,17 @@ flatbuffers::Offset<schemas::FeatureHierarchyLayerDesc> FeatureHierarchy::LayerD
         _sfDesc->save(builder, cs), _poolSteps);
 }
 
-void FeatureHierarchy::Layer::load(const schemas::FeatureHierarchyLayer* fbFeatureHierarchyLayer, ComputeSystem &cs) {
+void FeatureHierarchy::Layer::load(const schemas::FeatureHierarchyLayer* fbFeatureHierarchyLayer, ComputeSystem &cs, CheckpointReader* reader) {
     schemas::SparseFeatures* fbSparseFeatures =
         (schemas::SparseFeatures*)(fbFeatureHierarchyLayer->_sf());
-    _sf->load(fbSparseFeatures, cs);
+    _sf->load(fbSparseFeatures, cs, reader);
 
     _clock = fbFeatureHierarchyLayer->_clock();
     _tpReset = fbFeatureHierarchyLayer->_tpReset();
     _tpNextReset = fbFeatureHierarchyLayer->_tpNextReset();
 }
 
-flatbuffers::Offset<schemas::FeatureHierarchyLayer> FeatureHierarchy::Layer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::FeatureHierarchyLayer> FeatureHierarchy::Layer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
     schemas::SparseFeaturesType type;
     switch (_sf->_type) {
     default:
@@ -102,32 +198,60 @@ flatbuffers::Offset<schemas::FeatureHierarchyLayer> FeatureHierarchy::Layer::sav
     }
 
     return schemas::CreateFeatureHierarchyLayer(builder,
-        type, _sf->save(builder, cs).Union(),
+        type, _sf->save(builder, cs, writer).Union(),
         _clock,
         _tpReset, _tpNextReset);
 }
 
-void FeatureHierarchy::load(const schemas::FeatureHierarchy* fbFeatureHierarchy, ComputeSystem &cs) {
+void FeatureHierarchy::load(const schemas::FeatureHierarchy* fbFeatureHierarchy, ComputeSystem &cs, CheckpointReader* reader) {
     assert(_layerDescs.size() == fbFeatureHierarchy->_layerDescs()->Length());
     assert(_layers.size() == fbFeatureHierarchy->_layers()->Length());
 
-    for (flatbuffers::uoffset_t i = 0; i < fbFeatureHierarchy->_layerDescs()->Length(); i++) {
-        _layerDescs[i].load(fbFeatureHierarchy->_layerDescs()->Get(i), cs);
+    for (flatbuffers::uoffset_t i = 0; i < fbFeatureHierarchy->_layers()->Length(); i++) {
+        loadLayer(fbFeatureHierarchy, i, cs, reader);
     }
+}
 
-    for (flatbuffers::uoffset_t i = 0; i < fbFeatureHierarchy->_layers()->Length(); i++) {
-        _layers[i].load(fbFeatureHierarchy->_layers()->Get(i), cs);
+bool FeatureHierarchy::isLayerCompatible(const schemas::FeatureHierarchy* fbFeatureHierarchy, int li) const {
+    if (li < 0 || li >= _layers.size() || li >= fbFeatureHierarchy->_layers()->Length() || li >= fbFeatureHierarchy->_layerDescs()->Length())
+        return false;
+
+    const schemas::FeatureHierarchyLayer* fbLayer = fbFeatureHierarchy->_layers()->Get(li);
+
+    switch (fbLayer->_sf_type()) {
+    case schemas::SparseFeaturesType::SparseFeaturesType_SparseFeaturesChunk:
+        return _layers[li]._sf->_type == SparseFeaturesType::_chunk &&
+            isEncoderCompatible(static_cast<const SparseFeaturesChunk &>(*_layers[li]._sf), reinterpret_cast<const schemas::SparseFeaturesChunk*>(fbLayer->_sf()));
+    case schemas::SparseFeaturesType::SparseFeaturesType_SparseFeaturesDistance:
+        return _layers[li]._sf->_type == SparseFeaturesType::_distance &&
+            isEncoderCompatible(static_cast<const SparseFeaturesDistance &>(*_layers[li]._sf), reinterpret_cast<const schemas::SparseFeaturesDistance*>(fbLayer->_sf()));
+    default:
+        return false;
     }
 }
 
-flatbuffers::Offset<schemas::FeatureHierarchy> FeatureHierarchy::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+void FeatureHierarchy::loadLayer(const schemas::FeatureHierarchy* fbFeatureHierarchy, int li, ComputeSystem &cs, CheckpointReader* reader) {
+    assert(isLayerCompatible(fbFeatureHierarchy, li));
+
+    _layerDescs[li].load(fbFeatureHierarchy->_layerDescs()->Get(li), cs);
+    _layers[li].load(fbFeatureHierarchy->_layers()->Get(li), cs, reader);
+}
+
+flatbuffers::Offset<schemas::FeatureHierarchy> FeatureHierarchy::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
     std::vector<flatbuffers::Offset<schemas::FeatureHierarchyLayerDesc>> layerDescs;
     for (LayerDesc layerDesc : _layerDescs)
         layerDescs.push_back(layerDesc.save(builder, cs));
 
     std::vector<flatbuffers::Offset<schemas::FeatureHierarchyLayer>> layers;
-    for (Layer layer : _layers)
-        layers.push_back(layer.save(builder, cs));
+    for (int l = 0; l < _layers.size(); l++) {
+        if (writer != nullptr)
+            writer->beginSection();
+
+        layers.push_back(_layers[l].save(builder, cs, writer));
+
+        if (writer != nullptr)
+            writer->endSection(schemas::CheckpointSectionType_CST_FEATURE_LAYER, l);
+    }
 
     return schemas::CreateFeatureHierarchy(builder,
         builder.CreateVector(layerDescs), builder.CreateVector(layers));
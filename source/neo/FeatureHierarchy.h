@@ -82,8 +82,8 @@ namespace ogmaneo {
             /*!
             \brief Serialization
             */
-            void load(const schemas::FeatureHierarchyLayer* fbFeatureHierarchyLayer, ComputeSystem &cs);
-            flatbuffers::Offset<schemas::FeatureHierarchyLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+            void load(const schemas::FeatureHierarchyLayer* fbFeatureHierarchyLayer, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+            flatbuffers::Offset<schemas::FeatureHierarchyLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
             //!@}
         };
 
@@ -96,6 +96,11 @@ namespace ogmaneo {
         std::vector<LayerDesc> _layerDescs;
         //!@}
 
+        /*!
+        \brief Kernel for converting chunk winners to indices
+        */
+        cl::Kernel _chunkWinnerIndicesKernel;
+
     public:
         /*!
         \brief Initialize defaults
@@ -126,6 +131,18 @@ namespace ogmaneo {
         */
         void learn(ComputeSystem &cs, std::mt19937 &rng);
 
+        /*!
+        \brief Write the winner of each chunk of a layer as a single index (dx + dy * chunkSize.x) into a buffer
+        \param li index of the layer.
+        \param indices buffer of at least getNumChunks(li).x * getNumChunks(li).y ints, row major by chunk.
+        */
+        void getChunkWinnerIndices(ComputeSystem &cs, int li, cl::Buffer &indices);
+
+        /*!
+        \brief Get the number of chunks in each dimension of a layer
+        */
+        cl_int2 getNumChunks(int li) const;
+
         /*!
         \brief Get number of layers
         */
@@ -155,12 +172,28 @@ namespace ogmaneo {
         */
         void clearMemory(ComputeSystem &cs);
 
+        /*!
+        \brief Copy with device side copies of all images (see Hierarchy::clone)
+        */
+        FeatureHierarchy clone(ComputeSystem &cs) const;
+
         //!@{
         /*!
         \brief Serialization
         */
-        void load(const schemas::FeatureHierarchy* fbFeatureHierarchy, ComputeSystem &cs);
-        flatbuffers::Offset<schemas::FeatureHierarchy> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+        void load(const schemas::FeatureHierarchy* fbFeatureHierarchy, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+        flatbuffers::Offset<schemas::FeatureHierarchy> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
         //!@}
+
+        /*!
+        \brief Whether layer li of a saved hierarchy can be loaded into layer li of this one
+        Same encoder type, hidden and chunk size, and number, size, radius and samples of the visible layers.
+        */
+        bool isLayerCompatible(const schemas::FeatureHierarchy* fbFeatureHierarchy, int li) const;
+
+        /*!
+        \brief Load a single layer (and its desc), see isLayerCompatible
+        */
+        void loadLayer(const schemas::FeatureHierarchy* fbFeatureHierarchy, int li, ComputeSystem &cs, CheckpointReader* reader = nullptr);
     };
 }
\ No newline at end of file
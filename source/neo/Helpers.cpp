@@ -7,9 +7,325 @@
 // ----------------------------------------------------------------------------
 
 #include "Helpers.h"
+#include "Checkpoint.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 using namespace ogmaneo;
 
+namespace {
+    // Compressed pixels: header | block sizes | blocks
+    struct CompressedHeader {
+        uint64_t _size;
+        uint32_t _numBlocks;
+        uint32_t _stride;
+    };
+
+    const size_t compressedBlockSize = 64 * 1024;
+
+    // Set in a block size when the block is stored raw
+    const uint32_t rawBlockFlag = 0x80000000u;
+
+    // Runs of at least minRun repeated bytes are encoded as (0x80 | (length - minRun), byte),
+    // anything else as literals (length - 1, bytes...)
+    const size_t minRun = 3;
+    const size_t maxRun = 0x7f + minRun;
+    const size_t maxLiterals = 0x80;
+
+    // Threads shared by all compressions of the process, started on first use and kept until exit
+    class WorkerPool {
+    private:
+        std::vector<std::thread> _threads;
+
+        // One job at a time, compressions of other threads (AsyncCheckpointer) wait their turn
+        std::mutex _runMutex;
+
+        std::mutex _mutex;
+        std::condition_variable _started;
+        std::condition_variable _finished;
+
+        const std::function<void()>* _job;
+        uint64_t _generation;
+        size_t _numBusy;
+        bool _stop;
+
+        void work() {
+            uint64_t generation = 0;
+
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            for (;;) {
+                _started.wait(lock, [&]() { return _stop || _generation != generation; });
+
+                if (_stop)
+                    return;
+
+                generation = _generation;
+
+                const std::function<void()>* job = _job;
+
+                lock.unlock();
+
+                (*job)();
+
+                lock.lock();
+
+                if (--_numBusy == 0)
+                    _finished.notify_all();
+            }
+        }
+
+    public:
+        WorkerPool()
+            : _job(nullptr), _generation(0), _numBusy(0), _stop(false)
+        {
+            // The calling thread is the last worker
+            for (unsigned int t = 1; t < std::thread::hardware_concurrency(); t++)
+                _threads.push_back(std::thread(&WorkerPool::work, this));
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                _stop = true;
+            }
+
+            _started.notify_all();
+
+            for (std::thread &thread : _threads)
+                thread.join();
+        }
+
+        // Run job once on every thread, the calling one included, and wait for all of them
+        void run(const std::function<void()> &job) {
+            std::lock_guard<std::mutex> runLock(_runMutex);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                _job = &job;
+                _generation++;
+                _numBusy = _threads.size();
+            }
+
+            _started.notify_all();
+
+            job();
+
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _finished.wait(lock, [&]() { return _numBusy == 0; });
+        }
+    };
+
+    WorkerPool &getWorkerPool() {
+        static WorkerPool pool;
+
+        return pool;
+    }
+
+    // Run f(i) for i in [0, count) on the worker pool
+    template<class F>
+    void parallelFor(size_t count, const F &f) {
+        if (count <= 1 || std::thread::hardware_concurrency() <= 1) {
+            for (size_t i = 0; i < count; i++)
+                f(i);
+
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+
+        std::function<void()> worker = [&]() {
+            for (size_t i = next++; i < count; i = next++)
+                f(i);
+        };
+
+        getWorkerPool().run(worker);
+    }
+
+    // Group bytes by significance, so that slowly varying scalars give long runs
+    void shuffle(const uint8_t* src, uint8_t* dst, size_t size, size_t stride) {
+        size_t numScalars = size / stride;
+
+        for (size_t i = 0; i < numScalars; i++)
+            for (size_t b = 0; b < stride; b++)
+                dst[b * numScalars + i] = src[i * stride + b];
+
+        memcpy(dst + numScalars * stride, src + numScalars * stride, size - numScalars * stride);
+    }
+
+    void unshuffle(const uint8_t* src, uint8_t* dst, size_t size, size_t stride) {
+        size_t numScalars = size / stride;
+
+        for (size_t i = 0; i < numScalars; i++)
+            for (size_t b = 0; b < stride; b++)
+                dst[i * stride + b] = src[b * numScalars + i];
+
+        memcpy(dst + numScalars * stride, src + numScalars * stride, size - numScalars * stride);
+    }
+
+    void encodeRuns(const uint8_t* src, size_t size, std::vector<uint8_t> &dst) {
+        size_t literalStart = 0;
+        size_t i = 0;
+
+        auto flushLiterals = [&](size_t end) {
+            while (literalStart < end) {
+                size_t count = std::min(maxLiterals, end - literalStart);
+
+                dst.push_back(static_cast<uint8_t>(count - 1));
+                dst.insert(dst.end(), src + literalStart, src + literalStart + count);
+
+                literalStart += count;
+            }
+        };
+
+        while (i < size) {
+            size_t run = 1;
+
+            while (i + run < size && run < maxRun && src[i + run] == src[i])
+                run++;
+
+            if (run >= minRun) {
+                flushLiterals(i);
+
+                dst.push_back(static_cast<uint8_t>(0x80 | (run - minRun)));
+                dst.push_back(src[i]);
+
+                i += run;
+
+                literalStart = i;
+            }
+            else
+                i += run;
+        }
+
+        flushLiterals(size);
+    }
+
+    bool decodeRuns(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize) {
+        size_t i = 0;
+        size_t o = 0;
+
+        while (i < size) {
+            uint8_t control = src[i++];
+
+            if (control & 0x80) {
+                size_t run = (control & 0x7f) + minRun;
+
+                if (i >= size || run > dstSize - o)
+                    return false;
+
+                memset(dst + o, src[i++], run);
+
+                o += run;
+            }
+            else {
+                size_t count = control + 1;
+
+                if (count > size - i || count > dstSize - o)
+                    return false;
+
+                memcpy(dst + o, src + i, count);
+
+                i += count;
+                o += count;
+            }
+        }
+
+        return o == dstSize;
+    }
+
+    // IEEE 754 half conversions, rounding to nearest even
+    uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        uint32_t exponent = (bits >> 23) & 0xff;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        // Inf and NaN
+        if (exponent == 0xff)
+            return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+
+        int halfExponent = static_cast<int>(exponent) - 127 + 15;
+
+        // Overflow to inf
+        if (halfExponent >= 0x1f)
+            return sign | 0x7c00;
+
+        // Subnormal or zero
+        if (halfExponent <= 0) {
+            if (halfExponent < -10)
+                return sign;
+
+            mantissa |= 0x800000;
+
+            uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+
+            if (remainder > halfway || (remainder == halfway && (half & 1)))
+                half++;
+
+            return sign | static_cast<uint16_t>(half);
+        }
+
+        uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1fff;
+
+        // A carry into the exponent is still correct (up to inf)
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+            half++;
+
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    float halfToFloat(uint16_t half) {
+        uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+
+        uint32_t bits;
+
+        if (exponent == 0x1f)
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        else if (exponent != 0)
+            bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        else if (mantissa == 0)
+            bits = sign;
+        else {
+            // Subnormal, normalize
+            exponent = 127 - 15 + 1;
+
+            while ((mantissa & 0x400) == 0) {
+                mantissa <<= 1;
+                exponent--;
+            }
+
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+
+        return value;
+    }
+}
+
 DoubleBuffer2D ogmaneo::createDoubleBuffer2D(ComputeSystem &cs, cl_int2 size, cl_channel_order channelOrder, cl_channel_type channelType) {
     DoubleBuffer2D db;
 
@@ -28,6 +344,112 @@ DoubleBuffer3D ogmaneo::createDoubleBuffer3D(ComputeSystem &cs, cl_int3 size, cl
     return db;
 }
 
+cl::Image2D ogmaneo::copy(const cl::Image2D &img, ComputeSystem &cs) {
+    if (img() == nullptr)
+        return cl::Image2D();
+
+    cl::size_type width = img.getImageInfo<CL_IMAGE_WIDTH>();
+    cl::size_type height = img.getImageInfo<CL_IMAGE_HEIGHT>();
+
+    cl::Image2D copied(cs.getContext(), CL_MEM_READ_WRITE, img.getImageInfo<CL_IMAGE_FORMAT>(), width, height);
+
+    cs.getQueue().enqueueCopyImage(img, copied, { 0, 0, 0 }, { 0, 0, 0 }, { width, height, 1 });
+
+    return copied;
+}
+
+cl::Image3D ogmaneo::copy(const cl::Image3D &img, ComputeSystem &cs) {
+    if (img() == nullptr)
+        return cl::Image3D();
+
+    cl::size_type width = img.getImageInfo<CL_IMAGE_WIDTH>();
+    cl::size_type height = img.getImageInfo<CL_IMAGE_HEIGHT>();
+    cl::size_type depth = img.getImageInfo<CL_IMAGE_DEPTH>();
+
+    cl::Image3D copied(cs.getContext(), CL_MEM_READ_WRITE, img.getImageInfo<CL_IMAGE_FORMAT>(), width, height, depth);
+
+    cs.getQueue().enqueueCopyImage(img, copied, { 0, 0, 0 }, { 0, 0, 0 }, { width, height, depth });
+
+    return copied;
+}
+
+DoubleBuffer2D ogmaneo::copy(const DoubleBuffer2D &db, ComputeSystem &cs) {
+    DoubleBuffer2D copied;
+
+    copied[_front] = ogmaneo::copy(db[_front], cs);
+    copied[_back] = ogmaneo::copy(db[_back], cs);
+
+    return copied;
+}
+
+DoubleBuffer3D ogmaneo::copy(const DoubleBuffer3D &db, ComputeSystem &cs) {
+    DoubleBuffer3D copied;
+
+    copied[_front] = ogmaneo::copy(db[_front], cs);
+    copied[_back] = ogmaneo::copy(db[_back], cs);
+
+    return copied;
+}
+
+cl::Kernel ogmaneo::copy(const cl::Kernel &kernel) {
+    if (kernel() == nullptr)
+        return cl::Kernel();
+
+    // Kernels hold their arguments, so copies must not share them
+    return cl::Kernel(kernel.getInfo<CL_KERNEL_PROGRAM>(), kernel.getInfo<CL_KERNEL_FUNCTION_NAME>().c_str());
+}
+
+void MemoryUsage::add(MemoryCategory category, size_t imageBytes, int numImages) {
+    size_t bytes = imageBytes * numImages;
+
+    switch (category) {
+    case _memoryWeights:    _weights += bytes; break;
+    case _memorySamples:    _samples += bytes; break;
+    case _memoryStates:     _states += bytes; break;
+    case _memoryTemps:      _temps += bytes; break;
+    }
+
+    if (numImages > 0)
+        _largestImage = std::max(_largestImage, imageBytes);
+}
+
+void MemoryUsage::add(const MemoryUsage &other) {
+    _weights += other._weights;
+    _samples += other._samples;
+    _states += other._states;
+    _temps += other._temps;
+    _largestImage = std::max(_largestImage, other._largestImage);
+}
+
+size_t ogmaneo::imageBytes(const cl::Image &img) {
+    if (img() == nullptr)
+        return 0;
+
+    // 0 for 2D images
+    size_t depth = std::max<size_t>(img.getImageInfo<CL_IMAGE_DEPTH>(), 1);
+
+    return img.getImageInfo<CL_IMAGE_WIDTH>() * img.getImageInfo<CL_IMAGE_HEIGHT>() * depth * img.getImageInfo<CL_IMAGE_ELEMENT_SIZE>();
+}
+
+size_t ogmaneo::imageBytes(cl_int3 size, int numChannels) {
+    return static_cast<size_t>(size.x) * size.y * std::max(size.z, 1) * numChannels * sizeof(cl_float);
+}
+
+void ogmaneo::addMemory(MemoryUsage &usage, MemoryCategory category, const cl::Image &img) {
+    if (img() != nullptr)
+        usage.add(category, imageBytes(img));
+}
+
+void ogmaneo::addMemory(MemoryUsage &usage, MemoryCategory category, const DoubleBuffer2D &db) {
+    addMemory(usage, category, db[_front]);
+    addMemory(usage, category, db[_back]);
+}
+
+void ogmaneo::addMemory(MemoryUsage &usage, MemoryCategory category, const DoubleBuffer3D &db) {
+    addMemory(usage, category, db[_front]);
+    addMemory(usage, category, db[_back]);
+}
+
 void ogmaneo::randomUniform(cl::Image2D &image2D, ComputeSystem &cs, cl::Kernel &randomUniform2DKernel, cl_int2 size, cl_float4 lowerBounds, cl_float4 upperBounds, cl_float4 mask, cl_float4 fillConstants, std::mt19937 &rng) {
     int argIndex = 0;
 
@@ -42,7 +464,7 @@ void ogmaneo::randomUniform(cl::Image2D &image2D, ComputeSystem &cs, cl::Kernel
     randomUniform2DKernel.setArg(argIndex++, mask);
     randomUniform2DKernel.setArg(argIndex++, fillConstants);
 
-    cs.getQueue().enqueueNDRangeKernel(randomUniform2DKernel, cl::NullRange, cl::NDRange(size.x, size.y));
+    cs.enqueueKernel(randomUniform2DKernel, cl::NDRange(size.x, size.y));
 }
 
 void ogmaneo::randomUniform(cl::Image3D &image3D, ComputeSystem &cs, cl::Kernel &randomUniform3DKernel, cl_int3 size, cl_float4 lowerBounds, cl_float4 upperBounds, cl_float4 mask, cl_float4 fillConstants, std::mt19937 &rng) {
@@ -59,84 +481,140 @@ void ogmaneo::randomUniform(cl::Image3D &image3D, ComputeSystem &cs, cl::Kernel
     randomUniform3DKernel.setArg(argIndex++, mask);
     randomUniform3DKernel.setArg(argIndex++, fillConstants);
 
-    cs.getQueue().enqueueNDRangeKernel(randomUniform3DKernel, cl::NullRange, cl::NDRange(size.x, size.y, size.z));
+    cs.enqueueKernel(randomUniform3DKernel, cl::NDRange(size.x, size.y, size.z));
 }
 
-void ogmaneo::load(cl::Image2D &img, const schemas::Image2D* fbImg, ComputeSystem &cs) {
-    uint32_t width = (uint32_t)img.getImageInfo<CL_IMAGE_WIDTH>();
-    uint32_t height = (uint32_t)img.getImageInfo<CL_IMAGE_HEIGHT>();
-    uint32_t elementSize = (uint32_t)img.getImageInfo<CL_IMAGE_ELEMENT_SIZE>();
+namespace {
+    /*!
+    \brief Reject image data that does not fit the image it is loaded into (truncated, corrupt or mismatched file)
+    Checked in release builds too, the upload would otherwise read past the end of the data.
+    */
+    void checkPixels(bool valid, const char* message) {
+        if (!valid)
+            throw std::runtime_error(std::string("Unable to load image: ") + message);
+    }
 
-    assert(width == fbImg->width());
-    assert(height == fbImg->height());
-    assert(elementSize == fbImg->elementSize());
+    /*!
+    \brief Enqueue the upload of the pixels of a flatbuffer image (Image2D or Image3D) into img, of the given size
+    */
+    template<class FbImage>
+    void loadPixels(cl::Image &img, const FbImage* fbImg, uint32_t width, uint32_t height, uint32_t depth, uint32_t elementSize, ComputeSystem &cs, CheckpointReader* reader) {
+        size_t bytes = static_cast<size_t>(width) * height * depth * elementSize;
 
-    schemas::PixelData pixelType = fbImg->pixels_type();
-    switch (fbImg->pixels_type())
-    {
-    case schemas::PixelData::PixelData_FloatArray:
-    {
-        const schemas::FloatArray* fbFloatArray =
-            reinterpret_cast<const schemas::FloatArray*>(fbImg->pixels());
+        cl::array<cl::size_type, 3> region = { width, height, depth };
 
-        cs.getQueue().enqueueWriteImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, 1 }, 0, 0, static_cast<void*>(const_cast<float*>(fbFloatArray->data()->data())));
-        cs.getQueue().finish();
-        break;
-    }
-    case schemas::PixelData::PixelData_ByteArray:
-    {
-        const schemas::ByteArray* fbByteArray =
-            reinterpret_cast<const schemas::ByteArray*>(fbImg->pixels());
+        const void* pixels = nullptr;
 
-        cs.getQueue().enqueueWriteImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, 1 }, 0, 0, static_cast<void*>(const_cast<uint8_t*>(fbByteArray->data()->data())));
-        cs.getQueue().finish();
-        break;
-    }
-    default:
-        assert(0);
-        break;
+        switch (fbImg->pixels_type())
+        {
+        case schemas::PixelData::PixelData_FloatArray:
+        {
+            const schemas::FloatArray* fbFloatArray =
+                reinterpret_cast<const schemas::FloatArray*>(fbImg->pixels());
+
+            checkPixels(fbFloatArray->data() != nullptr && fbFloatArray->data()->size() * sizeof(float) == bytes, "pixel data size does not match");
+
+            pixels = fbFloatArray->data()->data();
+            break;
+        }
+        case schemas::PixelData::PixelData_ByteArray:
+        {
+            const schemas::ByteArray* fbByteArray =
+                reinterpret_cast<const schemas::ByteArray*>(fbImg->pixels());
+
+            checkPixels(fbByteArray->data() != nullptr && fbByteArray->data()->size() == bytes, "pixel data size does not match");
+
+            pixels = fbByteArray->data()->data();
+            break;
+        }
+        case schemas::PixelData::PixelData_ExternalArray:
+        {
+            const schemas::ExternalArray* fbExternalArray =
+                reinterpret_cast<const schemas::ExternalArray*>(fbImg->pixels());
+
+            checkPixels(reader != nullptr, "pixels are in a checkpoint payload, but no checkpoint is read");
+
+            size_t size = 0;
+            pixels = reader->getPayload(fbExternalArray->index(), size);
+
+            checkPixels(pixels != nullptr && size == bytes, "payload missing or of the wrong size");
+            break;
+        }
+        case schemas::PixelData::PixelData_CompressedArray:
+        {
+            const schemas::CompressedArray* fbCompressedArray =
+                reinterpret_cast<const schemas::CompressedArray*>(fbImg->pixels());
+
+            checkPixels(reader != nullptr, "pixels are in a checkpoint payload, but no checkpoint is read");
+
+            size_t compressedSize = 0;
+            const uint8_t* compressed = reader->getPayload(fbCompressedArray->index(), compressedSize);
+
+            checkPixels(compressed != nullptr && fbCompressedArray->size() == bytes, "payload missing or of the wrong size");
+
+            // The upload is non-blocking, so the pixels are kept by the reader
+            uint8_t* decompressed = reader->allocate(bytes);
+
+            checkPixels(decompressPixels(compressed, compressedSize, decompressed, bytes), "corrupt compressed payload");
+
+            pixels = decompressed;
+            break;
+        }
+        case schemas::PixelData::PixelData_QuantizedArray:
+        {
+            const schemas::QuantizedArray* fbQuantizedArray =
+                reinterpret_cast<const schemas::QuantizedArray*>(fbImg->pixels());
+
+            checkPixels(reader != nullptr, "pixels are in a checkpoint payload, but no checkpoint is read");
+
+            size_t quantizedSize = 0;
+            const uint8_t* quantized = reader->getPayload(fbQuantizedArray->index(), quantizedSize);
+
+            checkPixels(quantized != nullptr, "payload missing");
+
+            // The upload is non-blocking, so the weights are kept by the reader
+            uint8_t* weights = reader->allocate(bytes);
+
+            checkPixels(dequantizeWeights(quantized, quantizedSize, static_cast<size_t>(width) * height, elementSize / sizeof(float), depth,
+                static_cast<WeightPrecision>(fbQuantizedArray->precision()), reinterpret_cast<float*>(weights)), "quantized payload of the wrong size or precision");
+
+            pixels = weights;
+            break;
+        }
+        default:
+            checkPixels(false, "unknown pixel data type");
+            break;
+        }
+
+        cs.getQueue().enqueueWriteImage(img, CL_FALSE, { 0, 0, 0 }, region, 0, 0, const_cast<void*>(pixels));
+        cs.countTransfer(_hostToDevice, "load", bytes);
     }
 }
 
-void ogmaneo::load(cl::Image3D &img, const schemas::Image3D* fbImg, ComputeSystem &cs) {
+void ogmaneo::load(cl::Image2D &img, const schemas::Image2D* fbImg, ComputeSystem &cs, CheckpointReader* reader) {
     uint32_t width = (uint32_t)img.getImageInfo<CL_IMAGE_WIDTH>();
     uint32_t height = (uint32_t)img.getImageInfo<CL_IMAGE_HEIGHT>();
-    uint32_t depth = (uint32_t)img.getImageInfo<CL_IMAGE_DEPTH>();
     uint32_t elementSize = (uint32_t)img.getImageInfo<CL_IMAGE_ELEMENT_SIZE>();
 
-    assert(width == fbImg->width());
-    assert(height == fbImg->height());
-    assert(depth == fbImg->depth());
-    assert(elementSize == fbImg->elementSize());
+    checkPixels(fbImg != nullptr && width == fbImg->width() && height == fbImg->height() && elementSize == fbImg->elementSize(),
+        "size or format differs from the image it is loaded into");
 
-    schemas::PixelData pixelType = fbImg->pixels_type();
-    switch (fbImg->pixels_type())
-    {
-    case schemas::PixelData::PixelData_FloatArray:
-    {
-        const schemas::FloatArray* fbFloatArray =
-            reinterpret_cast<const schemas::FloatArray*>(fbImg->pixels());
+    loadPixels(img, fbImg, width, height, 1, elementSize, cs, reader);
+}
 
-        cs.getQueue().enqueueWriteImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, depth }, 0, 0, static_cast<void*>(const_cast<float*>(fbFloatArray->data()->data())));
-        cs.getQueue().finish();
-        break;
-    }
-    case schemas::PixelData::PixelData_ByteArray:
-    {
-        const schemas::ByteArray* fbByteArray =
-            reinterpret_cast<const schemas::ByteArray*>(fbImg->pixels());
+void ogmaneo::load(cl::Image3D &img, const schemas::Image3D* fbImg, ComputeSystem &cs, CheckpointReader* reader) {
+    uint32_t width = (uint32_t)img.getImageInfo<CL_IMAGE_WIDTH>();
+    uint32_t height = (uint32_t)img.getImageInfo<CL_IMAGE_HEIGHT>();
+    uint32_t depth = (uint32_t)img.getImageInfo<CL_IMAGE_DEPTH>();
+    uint32_t elementSize = (uint32_t)img.getImageInfo<CL_IMAGE_ELEMENT_SIZE>();
 
-        cs.getQueue().enqueueWriteImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, depth }, 0, 0, static_cast<void*>(const_cast<uint8_t*>(fbByteArray->data()->data())));
-        cs.getQueue().finish();
-        break;
-    }
-    default:
-        assert(0);
-        break;
-    }
+    checkPixels(fbImg != nullptr && width == fbImg->width() && height == fbImg->height() && depth == fbImg->depth() && elementSize == fbImg->elementSize(),
+        "size or format differs from the image it is loaded into");
+
+    loadPixels(img, fbImg, width, height, depth, elementSize, cs, reader);
 }
 
-flatbuffers::Offset<schemas::Image2D> ogmaneo::save(cl::Image2D &img, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::Image2D> ogmaneo::save(cl::Image2D &img, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs, CheckpointWriter* writer) {
     uint32_t width = (uint32_t)img.getImageInfo<CL_IMAGE_WIDTH>();
     uint32_t height = (uint32_t)img.getImageInfo<CL_IMAGE_HEIGHT>();
     uint32_t elementSize = (uint32_t)img.getImageInfo<CL_IMAGE_ELEMENT_SIZE>();
@@ -149,6 +627,30 @@ flatbuffers::Offset<schemas::Image2D> ogmaneo::save(cl::Image2D &img, flatbuffer
         static_cast<schemas::ChannelDataType>(channelType)
     );
 
+    // Stream the pixels straight to the checkpoint file
+    if (writer != nullptr) {
+        uint32_t index = writer->writeImage(img, { width, height, 1 }, static_cast<size_t>(width * height * elementSize), cs);
+
+        if (writer->isQuantizing()) {
+            flatbuffers::Offset<schemas::QuantizedArray> quantizedArray = schemas::CreateQuantizedArray(builder, index, static_cast<schemas::WeightPrecision>(writer->getPrecision()));
+
+            return schemas::CreateImage2D(builder,
+                &format, width, height, elementSize, schemas::PixelData_QuantizedArray, quantizedArray.Union());
+        }
+
+        if (writer->isCompressing()) {
+            flatbuffers::Offset<schemas::CompressedArray> compressedArray = schemas::CreateCompressedArray(builder, index, static_cast<uint64_t>(width * height * elementSize));
+
+            return schemas::CreateImage2D(builder,
+                &format, width, height, elementSize, schemas::PixelData_CompressedArray, compressedArray.Union());
+        }
+
+        flatbuffers::Offset<schemas::ExternalArray> externalArray = schemas::CreateExternalArray(builder, index);
+
+        return schemas::CreateImage2D(builder,
+            &format, width, height, elementSize, schemas::PixelData_ExternalArray, externalArray.Union());
+    }
+
     flatbuffers::Offset<schemas::Image2D> ret;
 
     switch (channelType) {
@@ -156,7 +658,7 @@ flatbuffers::Offset<schemas::Image2D> ogmaneo::save(cl::Image2D &img, flatbuffer
     {
         std::vector<float> pixels(width * height * (elementSize / sizeof(float)), 0.0f);
         cs.getQueue().enqueueReadImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, 1 }, 0, 0, pixels.data());
-        cs.getQueue().finish();
+        cs.countTransfer(_deviceToHost, "save", static_cast<size_t>(width * height) * elementSize);
 
         flatbuffers::Offset<flatbuffers::Vector<float>> floatVector = builder.CreateVector(pixels.data(), pixels.size());
         flatbuffers::Offset<schemas::FloatArray> floatArray = schemas::CreateFloatArray(builder, floatVector);
@@ -169,7 +671,7 @@ flatbuffers::Offset<schemas::Image2D> ogmaneo::save(cl::Image2D &img, flatbuffer
     {
         std::vector<unsigned char> pixels(width * height * (elementSize / sizeof(unsigned char)), 0);
         cs.getQueue().enqueueReadImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, 1 }, 0, 0, pixels.data());
-        cs.getQueue().finish();
+        cs.countTransfer(_deviceToHost, "save", static_cast<size_t>(width * height) * elementSize);
 
         flatbuffers::Offset<flatbuffers::Vector<unsigned char>> byteVector = builder.CreateVector(pixels.data(), pixels.size());
         flatbuffers::Offset<schemas::ByteArray> byteArray = schemas::CreateByteArray(builder, byteVector);
@@ -185,7 +687,7 @@ flatbuffers::Offset<schemas::Image2D> ogmaneo::save(cl::Image2D &img, flatbuffer
     return ret;
 }
 
-flatbuffers::Offset<schemas::Image3D> ogmaneo::save(cl::Image3D &img, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::Image3D> ogmaneo::save(cl::Image3D &img, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs, CheckpointWriter* writer) {
     uint32_t width = (uint32_t)img.getImageInfo<CL_IMAGE_WIDTH>();
     uint32_t height = (uint32_t)img.getImageInfo<CL_IMAGE_HEIGHT>();
     uint32_t depth = (uint32_t)img.getImageInfo<CL_IMAGE_DEPTH>();
@@ -199,6 +701,30 @@ flatbuffers::Offset<schemas::Image3D> ogmaneo::save(cl::Image3D &img, flatbuffer
         static_cast<schemas::ChannelDataType>(channelType)
     );
 
+    // Stream the pixels straight to the checkpoint file
+    if (writer != nullptr) {
+        uint32_t index = writer->writeImage(img, { width, height, depth }, static_cast<size_t>(width * height * depth * elementSize), cs);
+
+        if (writer->isQuantizing()) {
+            flatbuffers::Offset<schemas::QuantizedArray> quantizedArray = schemas::CreateQuantizedArray(builder, index, static_cast<schemas::WeightPrecision>(writer->getPrecision()));
+
+            return schemas::CreateImage3D(builder,
+                &format, width, height, depth, elementSize, schemas::PixelData_QuantizedArray, quantizedArray.Union());
+        }
+
+        if (writer->isCompressing()) {
+            flatbuffers::Offset<schemas::CompressedArray> compressedArray = schemas::CreateCompressedArray(builder, index, static_cast<uint64_t>(width * height * depth * elementSize));
+
+            return schemas::CreateImage3D(builder,
+                &format, width, height, depth, elementSize, schemas::PixelData_CompressedArray, compressedArray.Union());
+        }
+
+        flatbuffers::Offset<schemas::ExternalArray> externalArray = schemas::CreateExternalArray(builder, index);
+
+        return schemas::CreateImage3D(builder,
+            &format, width, height, depth, elementSize, schemas::PixelData_ExternalArray, externalArray.Union());
+    }
+
     flatbuffers::Offset<schemas::Image3D> ret;
 
     switch (channelType) {
@@ -206,7 +732,7 @@ flatbuffers::Offset<schemas::Image3D> ogmaneo::save(cl::Image3D &img, flatbuffer
     {
         std::vector<float> pixels(width * height * depth * (elementSize / sizeof(float)), 0.0f);
         cs.getQueue().enqueueReadImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, depth }, 0, 0, pixels.data());
-        cs.getQueue().finish();
+        cs.countTransfer(_deviceToHost, "save", static_cast<size_t>(width * height * depth) * elementSize);
 
         flatbuffers::Offset<flatbuffers::Vector<float>> floatVector = builder.CreateVector(pixels.data(), pixels.size());
         flatbuffers::Offset<schemas::FloatArray> floatArray = schemas::CreateFloatArray(builder, floatVector);
@@ -219,7 +745,7 @@ flatbuffers::Offset<schemas::Image3D> ogmaneo::save(cl::Image3D &img, flatbuffer
     {
         std::vector<unsigned char> pixels(width * height * depth * (elementSize / sizeof(unsigned char)), 0);
         cs.getQueue().enqueueReadImage(img, CL_TRUE, { 0, 0, 0 }, { width, height, depth }, 0, 0, pixels.data());
-        cs.getQueue().finish();
+        cs.countTransfer(_deviceToHost, "save", static_cast<size_t>(width * height * depth) * elementSize);
 
         flatbuffers::Offset<flatbuffers::Vector<unsigned char>> byteVector = builder.CreateVector(pixels.data(), pixels.size());
         flatbuffers::Offset<schemas::ByteArray> byteArray = schemas::CreateByteArray(builder, byteVector);
@@ -235,38 +761,348 @@ flatbuffers::Offset<schemas::Image3D> ogmaneo::save(cl::Image3D &img, flatbuffer
     return ret;
 }
 
-void ogmaneo::load(DoubleBuffer2D &db, const schemas::DoubleBuffer2D* fbDB, ComputeSystem &cs) {
+void ogmaneo::load(DoubleBuffer2D &db, const schemas::DoubleBuffer2D* fbDB, ComputeSystem &cs, CheckpointReader* reader) {
     if (db[_front].get() == nullptr || db[_back].get() == nullptr)
         return;
 
-    ogmaneo::load(db[_front], fbDB->_front(), cs);
-    ogmaneo::load(db[_back], fbDB->_back(), cs);
+    // Scratch buffer omitted from a compact checkpoint
+    if (fbDB == nullptr || fbDB->_back() == nullptr)
+        return;
+
+    ogmaneo::load(db[_back], fbDB->_back(), cs, reader);
+
+    if (fbDB->_front() != nullptr)
+        ogmaneo::load(db[_front], fbDB->_front(), cs, reader);
+    else {
+        cl::size_type width = db[_back].getImageInfo<CL_IMAGE_WIDTH>();
+        cl::size_type height = db[_back].getImageInfo<CL_IMAGE_HEIGHT>();
+
+        cs.getQueue().enqueueCopyImage(db[_back], db[_front], { 0, 0, 0 }, { 0, 0, 0 }, { width, height, 1 });
+    }
 }
 
-void ogmaneo::load(DoubleBuffer3D &db, const schemas::DoubleBuffer3D* fbDB, ComputeSystem &cs) {
+void ogmaneo::load(DoubleBuffer3D &db, const schemas::DoubleBuffer3D* fbDB, ComputeSystem &cs, CheckpointReader* reader) {
     if (db[_front].get() == nullptr || db[_back].get() == nullptr)
         return;
 
-    ogmaneo::load(db[_front], fbDB->_front(), cs);
-    ogmaneo::load(db[_back], fbDB->_back(), cs);
+    // Scratch buffer omitted from a compact checkpoint
+    if (fbDB == nullptr || fbDB->_back() == nullptr)
+        return;
+
+    ogmaneo::load(db[_back], fbDB->_back(), cs, reader);
+
+    if (fbDB->_front() != nullptr)
+        ogmaneo::load(db[_front], fbDB->_front(), cs, reader);
+    else {
+        cl::size_type width = db[_back].getImageInfo<CL_IMAGE_WIDTH>();
+        cl::size_type height = db[_back].getImageInfo<CL_IMAGE_HEIGHT>();
+        cl::size_type depth = db[_back].getImageInfo<CL_IMAGE_DEPTH>();
+
+        cs.getQueue().enqueueCopyImage(db[_back], db[_front], { 0, 0, 0 }, { 0, 0, 0 }, { width, height, depth });
+    }
 }
 
-flatbuffers::Offset<schemas::DoubleBuffer2D> ogmaneo::save(DoubleBuffer2D &db, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::DoubleBuffer2D> ogmaneo::save(DoubleBuffer2D &db, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs, CheckpointWriter* writer, DoubleBufferLiveness liveness) {
     if (db[_front].get() == nullptr || db[_back].get() == nullptr)
         return schemas::CreateDoubleBuffer2D(builder, 0, 0);
 
+    if (writer != nullptr && writer->isCompact()) {
+        if (liveness == _scratch || (liveness == _learning && writer->isInference()))
+            return schemas::CreateDoubleBuffer2D(builder, 0, 0);
+
+        if (liveness != _bothLive || writer->isInference())
+            return schemas::CreateDoubleBuffer2D(builder, 0, ogmaneo::save(db[_back], builder, cs, writer));
+    }
+
     return schemas::CreateDoubleBuffer2D(builder,
-        ogmaneo::save(db[_front], builder, cs),
-        ogmaneo::save(db[_back], builder, cs)
+        ogmaneo::save(db[_front], builder, cs, writer),
+        ogmaneo::save(db[_back], builder, cs, writer)
     );
 }
 
-flatbuffers::Offset<schemas::DoubleBuffer3D> ogmaneo::save(DoubleBuffer3D &db, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::DoubleBuffer3D> ogmaneo::save(DoubleBuffer3D &db, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs, CheckpointWriter* writer, DoubleBufferLiveness liveness) {
     if (db[_front].get() == nullptr || db[_back].get() == nullptr)
         return schemas::CreateDoubleBuffer3D(builder, 0, 0);
 
+    if (writer != nullptr && writer->isCompact()) {
+        if (liveness == _scratch || (liveness == _learning && writer->isInference()))
+            return schemas::CreateDoubleBuffer3D(builder, 0, 0);
+
+        if (liveness != _bothLive || writer->isInference())
+            return schemas::CreateDoubleBuffer3D(builder, 0, ogmaneo::save(db[_back], builder, cs, writer));
+    }
+
     return schemas::CreateDoubleBuffer3D(builder,
-        ogmaneo::save(db[_front], builder, cs),
-        ogmaneo::save(db[_back], builder, cs)
+        ogmaneo::save(db[_front], builder, cs, writer),
+        ogmaneo::save(db[_back], builder, cs, writer)
     );
 }
+
+flatbuffers::Offset<schemas::DoubleBuffer3D> ogmaneo::saveWeights(DoubleBuffer3D &db, flatbuffers::FlatBufferBuilder& builder, ComputeSystem &cs, CheckpointWriter* writer, bool &changed) {
+    if (writer == nullptr)
+        return ogmaneo::save(db, builder, cs);
+
+    writer->setUnchanged(!changed);
+    writer->setQuantize(true);
+
+    flatbuffers::Offset<schemas::DoubleBuffer3D> ret = ogmaneo::save(db, builder, cs, writer);
+
+    writer->setUnchanged(false);
+    writer->setQuantize(false);
+
+    if (writer->isRecordingBase())
+        changed = false;
+
+    return ret;
+}
+
+void ogmaneo::compressPixels(const uint8_t* data, size_t size, size_t stride, std::vector<uint8_t> &compressed) {
+    stride = std::max<size_t>(1, stride);
+
+    size_t numBlocks = (size + compressedBlockSize - 1) / compressedBlockSize;
+
+    std::vector<std::vector<uint8_t>> blocks(numBlocks);
+
+    parallelFor(numBlocks, [&](size_t b) {
+        size_t offset = b * compressedBlockSize;
+        size_t blockSize = std::min(compressedBlockSize, size - offset);
+
+        std::vector<uint8_t> shuffled(blockSize);
+
+        shuffle(data + offset, shuffled.data(), blockSize, stride);
+
+        encodeRuns(shuffled.data(), blockSize, blocks[b]);
+
+        if (blocks[b].size() >= blockSize)
+            blocks[b].clear();
+    });
+
+    CompressedHeader header;
+    header._size = size;
+    header._numBlocks = static_cast<uint32_t>(numBlocks);
+    header._stride = static_cast<uint32_t>(stride);
+
+    size_t total = sizeof(header) + numBlocks * sizeof(uint32_t);
+
+    std::vector<uint32_t> blockSizes(numBlocks);
+
+    for (size_t b = 0; b < numBlocks; b++) {
+        size_t blockSize = std::min(compressedBlockSize, size - b * compressedBlockSize);
+
+        blockSizes[b] = blocks[b].empty() ? (rawBlockFlag | static_cast<uint32_t>(blockSize)) : static_cast<uint32_t>(blocks[b].size());
+
+        total += blockSizes[b] & ~rawBlockFlag;
+    }
+
+    compressed.resize(total);
+
+    uint8_t* dst = compressed.data();
+
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+
+    if (numBlocks > 0) {
+        memcpy(dst, blockSizes.data(), numBlocks * sizeof(uint32_t));
+        dst += numBlocks * sizeof(uint32_t);
+    }
+
+    for (size_t b = 0; b < numBlocks; b++) {
+        if (blockSizes[b] & rawBlockFlag)
+            memcpy(dst, data + b * compressedBlockSize, blockSizes[b] & ~rawBlockFlag);
+        else
+            memcpy(dst, blocks[b].data(), blocks[b].size());
+
+        dst += blockSizes[b] & ~rawBlockFlag;
+    }
+}
+
+bool ogmaneo::decompressPixels(const uint8_t* compressed, size_t compressedSize, uint8_t* data, size_t size) {
+    CompressedHeader header;
+
+    if (compressed == nullptr || compressedSize < sizeof(header))
+        return false;
+
+    memcpy(&header, compressed, sizeof(header));
+
+    size_t numBlocks = (size + compressedBlockSize - 1) / compressedBlockSize;
+
+    if (header._size != size || header._numBlocks != numBlocks || header._stride == 0 ||
+        numBlocks > (compressedSize - sizeof(header)) / sizeof(uint32_t))
+        return false;
+
+    std::vector<uint32_t> blockSizes(numBlocks);
+
+    if (numBlocks > 0)
+        memcpy(blockSizes.data(), compressed + sizeof(header), numBlocks * sizeof(uint32_t));
+
+    // Blocks are independent, locate them all first
+    std::vector<size_t> blockOffsets(numBlocks);
+
+    size_t offset = sizeof(header) + numBlocks * sizeof(uint32_t);
+
+    for (size_t b = 0; b < numBlocks; b++) {
+        size_t blockSize = blockSizes[b] & ~rawBlockFlag;
+
+        if (blockSize > compressedSize - offset)
+            return false;
+
+        blockOffsets[b] = offset;
+
+        offset += blockSize;
+    }
+
+    std::atomic<bool> good(true);
+
+    parallelFor(numBlocks, [&](size_t b) {
+        size_t dataOffset = b * compressedBlockSize;
+        size_t dataSize = std::min(compressedBlockSize, size - dataOffset);
+
+        const uint8_t* src = compressed + blockOffsets[b];
+
+        if (blockSizes[b] & rawBlockFlag) {
+            if ((blockSizes[b] & ~rawBlockFlag) != dataSize)
+                good = false;
+            else
+                memcpy(data + dataOffset, src, dataSize);
+
+            return;
+        }
+
+        std::vector<uint8_t> shuffled(dataSize);
+
+        if (!decodeRuns(src, blockSizes[b], shuffled.data(), dataSize)) {
+            good = false;
+
+            return;
+        }
+
+        unshuffle(shuffled.data(), data + dataOffset, dataSize, header._stride);
+    });
+
+    return good;
+}
+
+void ogmaneo::quantizeWeights(const float* weights, size_t numUnits, size_t numChannels, size_t depth, WeightPrecision precision, std::vector<uint8_t> &quantized) {
+    size_t numWeights = numUnits * numChannels * depth;
+
+    switch (precision) {
+    case _int8:
+    {
+        // Per unit range, so units whose weights sit close together (chunk weights start near 1) keep their steps
+        std::vector<float> minima(numUnits, std::numeric_limits<float>::max());
+        std::vector<float> maxima(numUnits, -std::numeric_limits<float>::max());
+
+        for (size_t z = 0; z < depth; z++)
+            for (size_t u = 0; u < numUnits; u++)
+                for (size_t c = 0; c < numChannels; c++) {
+                    float w = weights[(z * numUnits + u) * numChannels + c];
+
+                    minima[u] = std::min(minima[u], w);
+                    maxima[u] = std::max(maxima[u], w);
+                }
+
+        std::vector<float> scales(numUnits, 0.0f);
+
+        for (size_t u = 0; u < numUnits; u++) {
+            // No weights (numChannels or depth of 0)
+            if (minima[u] > maxima[u])
+                minima[u] = maxima[u] = 0.0f;
+
+            scales[u] = (maxima[u] - minima[u]) / 255.0f;
+        }
+
+        quantized.resize(2 * numUnits * sizeof(float) + numWeights);
+
+        memcpy(quantized.data(), scales.data(), numUnits * sizeof(float));
+        memcpy(quantized.data() + numUnits * sizeof(float), minima.data(), numUnits * sizeof(float));
+
+        uint8_t* dst = quantized.data() + 2 * numUnits * sizeof(float);
+
+        for (size_t z = 0; z < depth; z++)
+            for (size_t u = 0; u < numUnits; u++) {
+                float invScale = scales[u] > 0.0f ? 1.0f / scales[u] : 0.0f;
+
+                for (size_t c = 0; c < numChannels; c++) {
+                    size_t i = (z * numUnits + u) * numChannels + c;
+
+                    dst[i] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, std::round((weights[i] - minima[u]) * invScale))));
+                }
+            }
+
+        break;
+    }
+    case _float16:
+    {
+        quantized.resize(numWeights * sizeof(uint16_t));
+
+        for (size_t i = 0; i < numWeights; i++) {
+            uint16_t half = floatToHalf(weights[i]);
+
+            memcpy(quantized.data() + i * sizeof(uint16_t), &half, sizeof(uint16_t));
+        }
+
+        break;
+    }
+    default:
+        quantized.resize(numWeights * sizeof(float));
+
+        memcpy(quantized.data(), weights, quantized.size());
+
+        break;
+    }
+}
+
+bool ogmaneo::dequantizeWeights(const uint8_t* quantized, size_t quantizedSize, size_t numUnits, size_t numChannels, size_t depth, WeightPrecision precision, float* weights) {
+    size_t numWeights = numUnits * numChannels * depth;
+
+    switch (precision) {
+    case _int8:
+    {
+        if (quantizedSize != 2 * numUnits * sizeof(float) + numWeights)
+            return false;
+
+        std::vector<float> scales(numUnits);
+        std::vector<float> minima(numUnits);
+
+        memcpy(scales.data(), quantized, numUnits * sizeof(float));
+        memcpy(minima.data(), quantized + numUnits * sizeof(float), numUnits * sizeof(float));
+
+        const uint8_t* src = quantized + 2 * numUnits * sizeof(float);
+
+        for (size_t z = 0; z < depth; z++)
+            for (size_t u = 0; u < numUnits; u++)
+                for (size_t c = 0; c < numChannels; c++) {
+                    size_t i = (z * numUnits + u) * numChannels + c;
+
+                    weights[i] = minima[u] + src[i] * scales[u];
+                }
+
+        return true;
+    }
+    case _float16:
+    {
+        if (quantizedSize != numWeights * sizeof(uint16_t))
+            return false;
+
+        for (size_t i = 0; i < numWeights; i++) {
+            uint16_t half;
+            memcpy(&half, quantized + i * sizeof(uint16_t), sizeof(uint16_t));
+
+            weights[i] = halfToFloat(half);
+        }
+
+        return true;
+    }
+    case _float32:
+    {
+        if (quantizedSize != numWeights * sizeof(float))
+            return false;
+
+        memcpy(weights, quantized, quantizedSize);
+
+        return true;
+    }
+    default:
+        return false;
+    }
+}
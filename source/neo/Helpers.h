@@ -14,6 +14,7 @@
 #include "schemas/Helpers_generated.h"
 
 #include <random>
+#include <vector>
 #include <assert.h>
 
 #ifdef _DEBUG
@@ -36,6 +37,11 @@ namespace ogmaneo {
     const char *clErrorString(cl_int error);
 #endif
 
+    // Streaming checkpoint file access (see Checkpoint.h)
+    class CheckpointReader;
+    class CheckpointWriter;
+    struct CheckpointBase;
+
     /*!
     \brief Buffer types (can be used as indices)
     */
@@ -43,6 +49,23 @@ namespace ogmaneo {
         _front = 0, _back = 1
     };
 
+    /*!
+    \brief Which halves of a double buffer hold state between steps (after stepEnd)
+    Compact checkpoints (see CheckpointWriter) only store the live halves.
+    Inference exports also drop the _front of _bothLive buffers (only read by learn), and _learning buffers
+    (back live, but only read by learn).
+    */
+    enum DoubleBufferLiveness {
+        _backLive = 0, _bothLive = 1, _scratch = 2, _learning = 3
+    };
+
+    /*!
+    \brief Storage precision of weights in inference exports
+    */
+    enum WeightPrecision {
+        _float32 = 0, _float16 = 1, _int8 = 2
+    };
+
     //!@{
     /*!
     \brief Double buffer types
@@ -59,6 +82,97 @@ namespace ogmaneo {
     DoubleBuffer3D createDoubleBuffer3D(ComputeSystem &cs, cl_int3 size, cl_channel_order channelOrder, cl_channel_type channelType);
     //!@}
 
+    //!@{
+    /*!
+    \brief Device side copy helpers (see Hierarchy::clone)
+    Create images of the same format and size and enqueue device to device copies, nothing is staged on the host.
+    Kernels are recreated from the same program (arguments are not copied).
+    */
+    cl::Image2D copy(const cl::Image2D &img, ComputeSystem &cs);
+    cl::Image3D copy(const cl::Image3D &img, ComputeSystem &cs);
+    DoubleBuffer2D copy(const DoubleBuffer2D &db, ComputeSystem &cs);
+    DoubleBuffer3D copy(const DoubleBuffer3D &db, ComputeSystem &cs);
+    cl::Kernel copy(const cl::Kernel &kernel);
+    //!@}
+
+    /*!
+    \brief Device memory categories (see MemoryUsage)
+    */
+    enum MemoryCategory {
+        _memoryWeights = 0, _memorySamples = 1, _memoryStates = 2, _memoryTemps = 3
+    };
+
+    /*!
+    \brief Device memory of a part of a hierarchy (its inputs, or an encoder or predictor layer), in bytes
+    See Architect::estimateMemory and Hierarchy::getMemoryUsage.
+    */
+    struct MemoryUsage {
+        /*!
+        \brief "inputs", "encoder" or "predictor"
+        */
+        std::string _scope;
+
+        /*!
+        \brief Layer index, -1 for the inputs
+        */
+        int _layer;
+
+        /*!
+        \brief Weights (double buffered)
+        */
+        size_t _weights;
+
+        /*!
+        \brief Encoder samples and derived inputs
+        */
+        size_t _samples;
+
+        /*!
+        \brief Hidden states, activations, chunk winners and input images
+        */
+        size_t _states;
+
+        /*!
+        \brief Summation buffers and sample slices
+        */
+        size_t _temps;
+
+        /*!
+        \brief Largest single image, allocations fail above CL_DEVICE_MAX_MEM_ALLOC_SIZE
+        */
+        size_t _largestImage;
+
+        MemoryUsage(const std::string &scope = "", int layer = -1)
+            : _scope(scope), _layer(layer), _weights(0), _samples(0), _states(0), _temps(0), _largestImage(0)
+        {}
+
+        size_t getTotal() const {
+            return _weights + _samples + _states + _temps;
+        }
+
+        /*!
+        \brief Add numImages images of imageBytes each
+        */
+        void add(MemoryCategory category, size_t imageBytes, int numImages = 1);
+
+        /*!
+        \brief Accumulate the categories of other
+        */
+        void add(const MemoryUsage &other);
+    };
+
+    //!@{
+    /*!
+    \brief Device memory helpers
+    Live sizes of existing images (0 for null images), and estimated sizes of float images.
+    */
+    size_t imageBytes(const cl::Image &img);
+    size_t imageBytes(cl_int3 size, int numChannels);
+    void addMemory(MemoryUsage &usage, MemoryCategory category, const cl::Image &img);
+    void addMemory(MemoryUsage &usage, MemoryCategory category, const DoubleBuffer2D &db);
+    void addMemory(MemoryUsage &usage, MemoryCategory category, const DoubleBuffer3D &db);
+    //!@}
+
     //!@{
     /*!
     \brief Double buffer initialization helpers
@@ -67,18 +181,73 @@ namespace ogmaneo {
     void randomUniform(cl::Image3D &image3D, ComputeSystem &cs, cl::Kernel &randomUniform3DKernel, cl_int3 size, cl_float4 lowerBounds, cl_float4 upperBounds, cl_float4 mask, cl_float4 fillConstants, std::mt19937 &rng);
     //!@}
 
-    //!@{
     /*!
     \brief Image and Double buffer serialization helpers
+    With a writer, pixels are streamed to the checkpoint file and only referenced (ExternalArray) from the flatbuffer.
+    A reader is required to load images saved that way.
+    Double buffers saved without a _front are restored by copying _back, and ones saved empty (scratch) are left untouched.
+    */
+
+    /*!
+    \brief Enqueue the upload of an image, without waiting for it
+    The write is non-blocking and reads straight from the flatbuffer (or from memory of the reader), so fbImg and reader
+    must stay valid until cs.getQueue().finish() returns. Hierarchy::load does this once for all images.
+    Throws std::runtime_error if the stored image does not match img or its pixel data is truncated, nothing is enqueued then.
+    */
+    void load(cl::Image2D &img, const schemas::Image2D* fbImg, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+
+    /*!
+    \brief Enqueue the upload of an image, without waiting for it (same lifetime requirement and errors as the Image2D overload)
+    */
+    void load(cl::Image3D &img, const schemas::Image3D* fbImg, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+
+    flatbuffers::Offset<schemas::Image2D> save(cl::Image2D &img, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
+    flatbuffers::Offset<schemas::Image3D> save(cl::Image3D &img, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
+
+    /*!
+    \brief Enqueue the upload of a double buffer, without waiting for it
+    fbDB and reader must stay valid until cs.getQueue().finish() returns (see load of an Image2D).
     */
-    void load(cl::Image2D &img, const schemas::Image2D* fbImg, ComputeSystem &cs);
-    void load(cl::Image3D &img, const schemas::Image3D* fbImg, ComputeSystem &cs);
-    flatbuffers::Offset<schemas::Image2D> save(cl::Image2D &img, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
-    flatbuffers::Offset<schemas::Image3D> save(cl::Image3D &img, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+    void load(DoubleBuffer2D &db, const schemas::DoubleBuffer2D* fbDB, ComputeSystem &cs, CheckpointReader* reader = nullptr);
 
-    void load(DoubleBuffer2D &db, const schemas::DoubleBuffer2D* fbDB, ComputeSystem &cs);
-    void load(DoubleBuffer3D &db, const schemas::DoubleBuffer3D* fbDB, ComputeSystem &cs);
-    flatbuffers::Offset<schemas::DoubleBuffer2D> save(DoubleBuffer2D &db, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
-    flatbuffers::Offset<schemas::DoubleBuffer3D> save(DoubleBuffer3D &db, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+    /*!
+    \brief Enqueue the upload of a double buffer, without waiting for it
+    fbDB and reader must stay valid until cs.getQueue().finish() returns (see load of an Image2D).
+    */
+    void load(DoubleBuffer3D &db, const schemas::DoubleBuffer3D* fbDB, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+
+    flatbuffers::Offset<schemas::DoubleBuffer2D> save(DoubleBuffer2D &db, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr, DoubleBufferLiveness liveness = _backLive);
+    flatbuffers::Offset<schemas::DoubleBuffer3D> save(DoubleBuffer3D &db, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr, DoubleBufferLiveness liveness = _backLive);
+
+    /*!
+    \brief Save learned weights
+    Delta checkpoints skip the readback when changed is false, saving a base checkpoint resets changed.
+    \param changed whether the weights were updated since the last base checkpoint (set by learn).
+    */
+    flatbuffers::Offset<schemas::DoubleBuffer3D> saveWeights(DoubleBuffer3D &db, flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer, bool &changed);
+
+    //!@{
+    /*!
+    \brief Block compression of pixel data
+    Pixels are split into independent blocks, (de)compressed on multiple threads. Within a block, bytes are
+    grouped by significance (shuffled) and run length encoded, which suits weights that stay close to their
+    initial values and mostly zero states. Blocks that do not shrink are stored raw.
+    \param stride size of a scalar in bytes (4 for CL_FLOAT), 1 disables shuffling.
+    \return (decompressPixels) false if compressed is malformed or does not decompress to exactly size bytes.
+    */
+    void compressPixels(const uint8_t* data, size_t size, size_t stride, std::vector<uint8_t> &compressed);
+    bool decompressPixels(const uint8_t* compressed, size_t compressedSize, uint8_t* data, size_t size);
+    //!@}
+
+    //!@{
+    /*!
+    \brief Weight quantization for inference exports
+    Weights are laid out as read back from a weight image: weights[(z * numUnits + unit) * numChannels + channel],
+    where a unit is a hidden (x, y) column. _int8 stores one float scale per unit ((max - min) / 255), then one float
+    zero point per unit (its min weight), then 8 bit codes with weight = min + code * scale, _float16 stores the IEEE half weights only.
+    \return (dequantizeWeights) false if quantizedSize does not match.
+    */
+    void quantizeWeights(const float* weights, size_t numUnits, size_t numChannels, size_t depth, WeightPrecision precision, std::vector<uint8_t> &quantized);
+    bool dequantizeWeights(const uint8_t* quantized, size_t quantizedSize, size_t numUnits, size_t numChannels, size_t depth, WeightPrecision precision, float* weights);
     //!@}
 }
\ No newline at end of file
@@ -7,45 +7,158 @@
 // ----------------------------------------------------------------------------
 
 #include "Hierarchy.h"
+#include "Checkpoint.h"
+
+#include "system/MappedFile.h"
 
 #include <assert.h>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 
 using namespace ogmaneo;
 
+namespace {
+    /*!
+    \brief Finishes a queue when leaving a scope, also when a load throws
+    Non-blocking uploads read from the mapped file, so they must be done before the mapping is released.
+    */
+    class QueueFinisher {
+    private:
+        cl::CommandQueue &_queue;
+
+    public:
+        QueueFinisher(cl::CommandQueue &queue)
+            : _queue(queue)
+        {}
+
+        ~QueueFinisher() {
+            _queue.finish();
+        }
+    };
+}
+
 void Hierarchy::activate(std::vector<ValueField2D> &inputsFeed) {
     // Write input
     for (int i = 0; i < _inputImagesFeed.size(); i++)
-        _resources->_cs->getQueue().enqueueWriteImage(_inputImagesFeed[i], CL_TRUE, { 0, 0, 0 }, { static_cast<cl::size_type>(inputsFeed[i].getSize().x), static_cast<cl::size_type>(inputsFeed[i].getSize().y), 1 }, 0, 0, inputsFeed[i].getData().data());
+        writeInputFeed(i, inputsFeed[i].getData().data());
 
-    _p.activate(*_resources->_cs, _inputImagesFeed, _rng);
+    activate();
 
     // Get predictions
-    for (int i = 0; i < _predictions.size(); i++) {
-        _resources->_cs->getQueue().enqueueReadImage(_p.getPredictions(i)[_back], CL_TRUE, { 0, 0, 0 }, { static_cast<cl::size_type>(_predictions[i].getSize().x), static_cast<cl::size_type>(_predictions[i].getSize().y), 1 }, 0, 0, _predictions[i].getData().data());
-    }
+    for (int i = 0; i < _predictions.size(); i++)
+        readPredictions(i, _predictions[i].getData().data());
 }
 
 void Hierarchy::learn(std::vector<ValueField2D> &inputsPredict, float tdError) {
     // Write input
     for (int i = 0; i < _inputImagesPredict.size(); i++)
-        _resources->_cs->getQueue().enqueueWriteImage(_inputImagesPredict[i], CL_TRUE, { 0, 0, 0 }, { static_cast<cl::size_type>(inputsPredict[i].getSize().x), static_cast<cl::size_type>(inputsPredict[i].getSize().y), 1 }, 0, 0, inputsPredict[i].getData().data());
+        writeInputPredict(i, inputsPredict[i].getData().data());
+
+    learn(tdError);
+}
+
+void Hierarchy::activate() {
+    TraceScope scope(_resources->_cs->getTracer(), "hierarchy", "activate");
+
+    loadLazyLayers();
+
+    if (_resources->_cs->isProfiling())
+        _resources->_cs->beginProfileStep();
+
+    _p.activate(*_resources->_cs, _inputImagesFeed, _rng);
+}
+
+void Hierarchy::learn(float tdError) {
+    TraceScope scope(_resources->_cs->getTracer(), "hierarchy", "learn");
+
+    loadLazyLayers();
 
     _p.learn(*_resources->_cs, _inputImagesPredict, _rng, tdError);
 }
 
-void Hierarchy::load(const schemas::Hierarchy* fbHierarchy, ComputeSystem &cs) {
-    assert(_inputImagesFeed.size() == fbHierarchy->_inputImagesFeed()->Length());
-    assert(_inputImagesPredict.size() == fbHierarchy->_inputImagesPredict()->Length());
-    assert(_predictions.size() == fbHierarchy->_predictions()->Length());
+void Hierarchy::writeInputFeed(int i, const float* data) {
+    TraceScope scope(_resources->_cs->getTracer(), "hierarchy", "writeInputFeed", i);
+
+    Vec2i size = getInputSize(i);
+
+    _resources->_cs->getQueue().enqueueWriteImage(_inputImagesFeed[i], CL_TRUE, { 0, 0, 0 }, { static_cast<cl::size_type>(size.x), static_cast<cl::size_type>(size.y), 1 }, 0, 0, data);
+    _resources->_cs->countTransfer(_hostToDevice, "inputFeed", size.x * size.y * sizeof(float));
+}
+
+void Hierarchy::writeInputPredict(int i, const float* data) {
+    TraceScope scope(_resources->_cs->getTracer(), "hierarchy", "writeInputPredict", i);
+
+    Vec2i size = getInputSize(i);
+
+    _resources->_cs->getQueue().enqueueWriteImage(_inputImagesPredict[i], CL_TRUE, { 0, 0, 0 }, { static_cast<cl::size_type>(size.x), static_cast<cl::size_type>(size.y), 1 }, 0, 0, data);
+    _resources->_cs->countTransfer(_hostToDevice, "inputPredict", size.x * size.y * sizeof(float));
+}
+
+void Hierarchy::readPredictions(int i, float* data) {
+    // Blocks until the step is done on the device
+    TraceScope scope(_resources->_cs->getTracer(), "hierarchy", "readPredictions", i);
+
+    Vec2i size = getInputSize(i);
+
+    _resources->_cs->getQueue().enqueueReadImage(_p.getPredictions(i)[_back], CL_TRUE, { 0, 0, 0 }, { static_cast<cl::size_type>(size.x), static_cast<cl::size_type>(size.y), 1 }, 0, 0, data);
+    _resources->_cs->countTransfer(_deviceToHost, "predictions", size.x * size.y * sizeof(float));
+}
+
+bool Hierarchy::areInputsCompatible(const schemas::Hierarchy* fbHierarchy) const {
+    if (_inputImagesFeed.size() != fbHierarchy->_inputImagesFeed()->Length() ||
+        _inputImagesPredict.size() != fbHierarchy->_inputImagesPredict()->Length() ||
+        _predictions.size() != fbHierarchy->_predictions()->Length())
+        return false;
+
+    // Prediction sizes are those of the input layers (getInputSize)
+    for (flatbuffers::uoffset_t i = 0; i < fbHierarchy->_predictions()->Length(); i++) {
+        const schemas::Vec2i* size = fbHierarchy->_predictions()->Get(i)->_size();
+
+        if (size == nullptr || size->x() != _predictions[i].getSize().x || size->y() != _predictions[i].getSize().y)
+            return false;
+    }
+
+    return true;
+}
+
+void Hierarchy::checkCompatible(const schemas::Hierarchy* fbHierarchy) const {
+    if (!areInputsCompatible(fbHierarchy))
+        throw std::runtime_error("Unable to load hierarchy: the input layers differ");
+
+    const schemas::Predictor* fbPredictor = fbHierarchy->_p();
 
-    _p.load(fbHierarchy->_p(), cs);
+    if (_p.getHierarchy().getNumLayers() != fbPredictor->_h()->_layers()->Length() ||
+        _p.getNumPredLayers() != fbPredictor->_pLayers()->Length())
+        throw std::runtime_error("Unable to load hierarchy: the number of layers differs");
+
+    for (int li = 0; li < static_cast<int>(_p.getHierarchy().getNumLayers()); li++) {
+        if (!_p.getHierarchy().isLayerCompatible(fbPredictor->_h(), li))
+            throw std::runtime_error("Unable to load hierarchy: feature layer " + std::to_string(li) + " differs");
+    }
+
+    for (int li = 0; li < static_cast<int>(_p.getNumPredLayers()); li++) {
+        if (!_p.isPredLayerCompatible(fbPredictor, li))
+            throw std::runtime_error("Unable to load hierarchy: predictor layer " + std::to_string(li) + " differs");
+    }
+}
+
+void Hierarchy::load(const schemas::Hierarchy* fbHierarchy, ComputeSystem &cs, CheckpointReader* reader) {
+    checkCompatible(fbHierarchy);
+
+    _p.load(fbHierarchy->_p(), cs, reader);
+
+    loadInputs(fbHierarchy, cs, reader);
+}
 
+void Hierarchy::loadInputs(const schemas::Hierarchy* fbHierarchy, ComputeSystem &cs, CheckpointReader* reader) {
     for (flatbuffers::uoffset_t i = 0; i < fbHierarchy->_inputImagesFeed()->Length(); i++) {
-        ogmaneo::load(_inputImagesFeed[i], fbHierarchy->_inputImagesFeed()->Get(i), cs);
+        ogmaneo::load(_inputImagesFeed[i], fbHierarchy->_inputImagesFeed()->Get(i), cs, reader);
     }
 
     for (flatbuffers::uoffset_t i = 0; i < fbHierarchy->_inputImagesPredict()->Length(); i++) {
-        ogmaneo::load(_inputImagesPredict[i], fbHierarchy->_inputImagesPredict()->Get(i), cs);
+        ogmaneo::load(_inputImagesPredict[i], fbHierarchy->_inputImagesPredict()->Get(i), cs, reader);
     }
 
     for (flatbuffers::uoffset_t i = 0; i < fbHierarchy->_predictions()->Length(); i++) {
@@ -53,51 +166,272 @@ void Hierarchy::load(const schemas::Hierarchy* fbHierarchy, ComputeSystem &cs) {
     }
 }
 
-flatbuffers::Offset<schemas::Hierarchy> Hierarchy::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::Hierarchy> Hierarchy::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
+    // Layers still in a lazily loaded file would be saved uninitialized
+    loadLazyLayers();
+
     std::vector<flatbuffers::Offset<schemas::Image2D>> inputImagesFeed;
     for (cl::Image2D image : _inputImagesFeed)
-        inputImagesFeed.push_back(ogmaneo::save(image, builder, cs));
+        inputImagesFeed.push_back(ogmaneo::save(image, builder, cs, writer));
 
     std::vector<flatbuffers::Offset<schemas::Image2D>> inputImagesPredict;
     for (cl::Image2D image : _inputImagesPredict)
-        inputImagesPredict.push_back(ogmaneo::save(image, builder, cs));
+        inputImagesPredict.push_back(ogmaneo::save(image, builder, cs, writer));
 
     std::vector<flatbuffers::Offset<schemas::ValueField2D>> predictions;
     for (ValueField2D values : _predictions)
         predictions.push_back(values.save(builder, cs));
 
     return schemas::CreateHierarchy(builder,
-        _p.save(builder, cs),
+        _p.save(builder, cs, writer),
         builder.CreateVector(inputImagesFeed),
         builder.CreateVector(inputImagesPredict),
         builder.CreateVector(predictions));
 }
 
-void Hierarchy::load(ComputeSystem &cs, const std::string &fileName) {
-    FILE* file = fopen(fileName.c_str(), "rb");
-    fseek(file, 0L, SEEK_END);
-    size_t length = ftell(file);
-    fseek(file, 0L, SEEK_SET);
-    std::vector<uint8_t> data(length);
-    fread(data.data(), sizeof(uint8_t), length, file);
-    fclose(file);
+struct Hierarchy::MappedHierarchy {
+    MappedFile _file;
+
+    // Set for streaming checkpoints, whose Hierarchy flatbuffer (metadata) references payloads elsewhere in the file
+    CheckpointReader _checkpoint;
+    CheckpointReader* _reader;
+
+    const schemas::Hierarchy* _hierarchy;
+
+    //!@{
+    /*!
+    \brief Parts of each layer not loaded yet (lazy loads)
+    */
+    std::vector<bool> _pendingFeatures;
+    std::vector<bool> _pendingPredictor;
+    //!@}
+
+    MappedHierarchy()
+        : _reader(nullptr), _hierarchy(nullptr)
+    {}
+
+    /*!
+    \brief Read ahead the payloads of a layer, if the file has sections
+    */
+    void prefetch(schemas::CheckpointSectionType type, int li) {
+        const uint8_t* data;
+        size_t size;
+
+        if (_reader != nullptr) {
+            const schemas::CheckpointSection* section = _reader->findSection(type, static_cast<uint32_t>(li));
 
-    flatbuffers::Verifier verifier = flatbuffers::Verifier(data.data(), length);
+            if (section != nullptr && _reader->getSectionRange(section, data, size))
+                _file.prefetch(data, size);
+        }
+    }
+};
+
+std::shared_ptr<Hierarchy::MappedHierarchy> Hierarchy::openFile(const std::string &fileName) {
+    // Map the file rather than reading it, images are uploaded straight from the mapping
+    std::shared_ptr<MappedHierarchy> file = std::make_shared<MappedHierarchy>();
+
+    if (!file->_file.open(fileName)) {
+#ifdef SYS_DEBUG
+        std::cout << "Unable to open " << fileName << std::endl;
+#endif
+        return nullptr;
+    }
+
+    const uint8_t* buf = file->_file.data();
+    size_t size = file->_file.size();
+
+    if (CheckpointReader::isCheckpoint(buf, size)) {
+        if (!file->_checkpoint.open(buf, size)) {
+#ifdef SYS_DEBUG
+            std::cout << "Invalid checkpoint " << fileName << std::endl;
+#endif
+            return nullptr;
+        }
+
+        if (file->_checkpoint.isDelta()) {
+#ifdef SYS_DEBUG
+            std::cout << fileName << " is a delta checkpoint, compact it with its base first" << std::endl;
+#endif
+            return nullptr;
+        }
+
+        buf = file->_checkpoint.getMetadata();
+        size = file->_checkpoint.getMetadataSize();
+        file->_reader = &file->_checkpoint;
+    }
+
+    flatbuffers::Verifier verifier = flatbuffers::Verifier(buf, size);
 
     bool verified =
         schemas::VerifyHierarchyBuffer(verifier) |
-        schemas::HierarchyBufferHasIdentifier(data.data());
+        schemas::HierarchyBufferHasIdentifier(buf);
+
+    if (!verified) {
+#ifdef SYS_DEBUG
+        std::cout << "Invalid hierarchy " << fileName << std::endl;
+#endif
+        return nullptr;
+    }
+
+    file->_hierarchy = schemas::GetHierarchy(buf);
+
+    return file;
+}
+
+bool Hierarchy::load(ComputeSystem &cs, const std::string &fileName) {
+    std::shared_ptr<MappedHierarchy> file = openFile(fileName);
 
-    if (verified) {
-        const schemas::Hierarchy* h = schemas::GetHierarchy(data.data());
+    if (file == nullptr)
+        return false;
 
-        load(h, cs);
+    // Layers pending from an earlier lazy load are replaced
+    if (_lazyFile != nullptr) {
+        cs.getQueue().finish();
+
+        _lazyFile.reset();
     }
 
-    return; //verified;
+    // Single sync for all the (non-blocking) image uploads, before the mapping goes away
+    QueueFinisher finisher(cs.getQueue());
+
+    // Deltas are relative to a state that is replaced (even if only in part, when an image does not match)
+    _checkpointBase.reset();
+
+    load(file->_hierarchy, cs, file->_reader);
+
+    return true;
 }
 
-void Hierarchy::save(ComputeSystem &cs, const std::string &fileName) {
+bool Hierarchy::loadLazy(ComputeSystem &cs, const std::string &fileName) {
+    std::shared_ptr<MappedHierarchy> file = openFile(fileName);
+
+    if (file == nullptr)
+        return false;
+
+    // Layers are only loaded when first used, check them all now, so that a mismatch leaves the hierarchy as it was
+    checkCompatible(file->_hierarchy);
+
+    if (_lazyFile != nullptr) {
+        cs.getQueue().finish();
+
+        _lazyFile.reset();
+    }
+
+    {
+        // Only the inputs are uploaded now, the layers read from the mapping later
+        QueueFinisher finisher(cs.getQueue());
+
+        loadInputs(file->_hierarchy, cs, file->_reader);
+    }
+
+    file->_pendingFeatures.assign(_p.getHierarchy().getNumLayers(), true);
+    file->_pendingPredictor.assign(_p.getNumPredLayers(), true);
+
+    _lazyFile = file;
+
+    _checkpointBase.reset();
+
+    return true;
+}
+
+void Hierarchy::loadLazyLayer(int li) {
+    if (_lazyFile == nullptr)
+        return;
+
+    ComputeSystem &cs = *_resources->_cs;
+
+    const schemas::Predictor* fbPredictor = _lazyFile->_hierarchy->_p();
+
+    bool loadFeatures = li < _lazyFile->_pendingFeatures.size() && _lazyFile->_pendingFeatures[li];
+    bool loadPredictor = li < _lazyFile->_pendingPredictor.size() && _lazyFile->_pendingPredictor[li];
+
+    if (loadFeatures)
+        _lazyFile->prefetch(schemas::CheckpointSectionType_CST_FEATURE_LAYER, li);
+
+    if (loadPredictor)
+        _lazyFile->prefetch(schemas::CheckpointSectionType_CST_PREDICTOR_LAYER, li);
+
+    if (loadFeatures || loadPredictor)
+        _p.loadLayer(fbPredictor, li, cs, _lazyFile->_reader, loadFeatures, loadPredictor);
+
+    if (li < _lazyFile->_pendingFeatures.size())
+        _lazyFile->_pendingFeatures[li] = false;
+
+    if (li < _lazyFile->_pendingPredictor.size())
+        _lazyFile->_pendingPredictor[li] = false;
+
+    if (std::find(_lazyFile->_pendingFeatures.begin(), _lazyFile->_pendingFeatures.end(), true) == _lazyFile->_pendingFeatures.end() &&
+        std::find(_lazyFile->_pendingPredictor.begin(), _lazyFile->_pendingPredictor.end(), true) == _lazyFile->_pendingPredictor.end())
+    {
+        // Uploads read from the mapping
+        cs.getQueue().finish();
+
+        _lazyFile.reset();
+    }
+}
+
+void Hierarchy::loadLazyLayers() {
+    for (int li = 0; _lazyFile != nullptr && li < std::max(_lazyFile->_pendingFeatures.size(), _lazyFile->_pendingPredictor.size()); li++)
+        loadLazyLayer(li);
+}
+
+bool Hierarchy::isLayerLoaded(int li) const {
+    return _lazyFile == nullptr ||
+        !((li < _lazyFile->_pendingFeatures.size() && _lazyFile->_pendingFeatures[li]) ||
+        (li < _lazyFile->_pendingPredictor.size() && _lazyFile->_pendingPredictor[li]));
+}
+
+bool Hierarchy::loadLayers(ComputeSystem &cs, const std::string &fileName, int firstLayer, int numLayers, bool loadFeatures, bool loadPredictor) {
+    std::shared_ptr<MappedHierarchy> file = openFile(fileName);
+
+    if (file == nullptr)
+        return false;
+
+    const schemas::Predictor* fbPredictor = file->_hierarchy->_p();
+
+    // Check everything first, so that a mismatch leaves the hierarchy as it was
+    for (int li = firstLayer; li < firstLayer + numLayers; li++) {
+        if ((loadFeatures && !_p.getHierarchy().isLayerCompatible(fbPredictor->_h(), li)) ||
+            (loadPredictor && !_p.isPredLayerCompatible(fbPredictor, li)))
+        {
+#ifdef SYS_DEBUG
+            std::cout << "Layer " << li << " of " << fileName << " is missing or does not match" << std::endl;
+#endif
+            return false;
+        }
+    }
+
+    for (int li = firstLayer; li < firstLayer + numLayers; li++) {
+        if (loadFeatures)
+            file->prefetch(schemas::CheckpointSectionType_CST_FEATURE_LAYER, li);
+
+        if (loadPredictor)
+            file->prefetch(schemas::CheckpointSectionType_CST_PREDICTOR_LAYER, li);
+    }
+
+    QueueFinisher finisher(cs.getQueue());
+
+    _checkpointBase.reset();
+
+    for (int li = firstLayer; li < firstLayer + numLayers; li++) {
+        _p.loadLayer(fbPredictor, li, cs, file->_reader, loadFeatures, loadPredictor);
+
+        // Do not let a pending lazy load overwrite what was just loaded
+        if (_lazyFile != nullptr) {
+            if (loadFeatures && li < _lazyFile->_pendingFeatures.size())
+                _lazyFile->_pendingFeatures[li] = false;
+
+            if (loadPredictor && li < _lazyFile->_pendingPredictor.size())
+                _lazyFile->_pendingPredictor[li] = false;
+        }
+    }
+
+    return true;
+}
+
+bool Hierarchy::save(ComputeSystem &cs, const std::string &fileName) {
+    TraceScope scope(cs.getTracer(), "hierarchy", "save");
+
     flatbuffers::FlatBufferBuilder builder;
 
     flatbuffers::Offset<schemas::Hierarchy> h = save(builder, cs);
@@ -115,19 +449,239 @@ void Hierarchy::save(ComputeSystem &cs, const std::string &fileName) {
         schemas::VerifyHierarchyBuffer(verifier) |
         schemas::HierarchyBufferHasIdentifier(buf);
 
-    if (verified) {
-        FILE* file = fopen(fileName.c_str(), "wb");
-        fwrite(buf, sizeof(uint8_t), size, file);
-        fclose(file);
-    }
+    if (!verified)
+        return false;
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+
+    if (file == nullptr)
+        return false;
+
+    bool written = fwrite(buf, sizeof(uint8_t), size, file) == size;
+
+    // Buffered data is only flushed (and a full disk reported) on close
+    return fclose(file) == 0 && written;
+}
+
+bool Hierarchy::saveCheckpoint(ComputeSystem &cs, const std::string &fileName, bool compact, bool compress) {
+    TraceScope scope(cs.getTracer(), "hierarchy", "saveCheckpoint");
+
+    CheckpointWriter writer(compact);
+
+    writer.setCompress(compress);
+
+    if (!writer.open(fileName))
+        return false;
+
+    // Only the metadata goes through the builder, images are streamed by the writer as they are read back
+    flatbuffers::FlatBufferBuilder builder;
+
+    flatbuffers::Offset<schemas::Hierarchy> h = save(builder, cs, &writer);
+
+    schemas::FinishHierarchyBuffer(builder, h);
+
+    return writer.finish(builder.GetBufferPointer(), builder.GetSize());
+}
+
+bool Hierarchy::exportInference(ComputeSystem &cs, const std::string &fileName, WeightPrecision precision) {
+    CheckpointWriter writer;
+
+    writer.setInference(precision);
+
+    if (!writer.open(fileName))
+        return false;
+
+    flatbuffers::FlatBufferBuilder builder;
+
+    flatbuffers::Offset<schemas::Hierarchy> h = save(builder, cs, &writer);
+
+    schemas::FinishHierarchyBuffer(builder, h);
+
+    return writer.finish(builder.GetBufferPointer(), builder.GetSize());
+}
+
+bool Hierarchy::saveBaseCheckpoint(ComputeSystem &cs, const std::string &fileName, bool compact) {
+    TraceScope scope(cs.getTracer(), "hierarchy", "saveBaseCheckpoint");
+
+    // Saving resets the weight change flags, so the old base is unusable even if this save fails
+    _checkpointBase.reset();
+
+    std::shared_ptr<CheckpointBase> base = std::make_shared<CheckpointBase>();
+
+    CheckpointWriter writer(compact);
+
+    writer.recordBase(base.get());
+
+    if (!writer.open(fileName))
+        return false;
+
+    flatbuffers::FlatBufferBuilder builder;
+
+    flatbuffers::Offset<schemas::Hierarchy> h = save(builder, cs, &writer);
+
+    schemas::FinishHierarchyBuffer(builder, h);
+
+    if (!writer.finish(builder.GetBufferPointer(), builder.GetSize()))
+        return false;
+
+    _checkpointBase = base;
+
+    return true;
+}
+
+bool Hierarchy::saveDeltaCheckpoint(ComputeSystem &cs, const std::string &fileName) {
+    TraceScope scope(cs.getTracer(), "hierarchy", "saveDeltaCheckpoint");
+
+    if (_checkpointBase == nullptr)
+        return false;
+
+    CheckpointWriter writer(_checkpointBase->_compact);
+
+    writer.setDeltaBase(_checkpointBase.get());
+
+    if (!writer.open(fileName))
+        return false;
+
+    flatbuffers::FlatBufferBuilder builder;
+
+    flatbuffers::Offset<schemas::Hierarchy> h = save(builder, cs, &writer);
+
+    schemas::FinishHierarchyBuffer(builder, h);
+
+    return writer.finish(builder.GetBufferPointer(), builder.GetSize());
+}
 
-    return; //verified;
+std::shared_ptr<Hierarchy> Hierarchy::clone() {
+    loadLazyLayers();
+
+    ComputeSystem &cs = *_resources->_cs;
+
+    std::shared_ptr<Hierarchy> h = std::make_shared<Hierarchy>();
+
+    h->_p = _p.clone(cs);
+    h->_rng = _rng;
+    h->_resources = _resources;
+
+    for (const cl::Image2D &image : _inputImagesFeed)
+        h->_inputImagesFeed.push_back(ogmaneo::copy(image, cs));
+
+    for (const cl::Image2D &image : _inputImagesPredict)
+        h->_inputImagesPredict.push_back(ogmaneo::copy(image, cs));
+
+    h->_predictions = _predictions;
+
+    // Chunk winner index buffers are created on first read, and deltas need a base checkpoint of the copy
+
+    return h;
+}
+
+void Hierarchy::checkLayerIndex(int li) const {
+    int numLayers = static_cast<int>(_p.getHierarchy().getNumLayers());
+
+    if (li < 0 || li >= numLayers)
+        throw std::out_of_range("Layer index " + std::to_string(li) + " out of range, the hierarchy has " + std::to_string(numLayers) + " layers");
 }
 
 void Hierarchy::readChunkStates(int li, ValueField2D &valueField) {
+    checkLayerIndex(li);
+
+    loadLazyLayer(li);
+
     assert(getPredictor().getHierarchy().getLayer(li)._sf->_type == _chunk);
 
     valueField = ValueField2D(ogmaneo::Vec2i(getPredictor().getHierarchy().getLayer(li)._sf->getHiddenSize().x, getPredictor().getHierarchy().getLayer(li)._sf->getHiddenSize().y));
 
     _resources->getComputeSystem()->getQueue().enqueueReadImage(getPredictor().getHierarchy().getLayer(li)._sf->getHiddenStates()[_back], CL_TRUE, { 0, 0, 0 }, { static_cast<cl::size_type>(getPredictor().getHierarchy().getLayer(li)._sf->getHiddenSize().x), static_cast<cl::size_type>(getPredictor().getHierarchy().getLayer(li)._sf->getHiddenSize().y), 1 }, 0, 0, valueField.getData().data());
-}
\ No newline at end of file
+    _resources->_cs->countTransfer(_deviceToHost, "chunkStates", valueField.getData().size() * sizeof(float));
+}
+
+void Hierarchy::readChunkWinners(int li, int* indices, bool blocking) {
+    checkLayerIndex(li);
+
+    if (indices == nullptr)
+        throw std::invalid_argument("Null chunk winner indices");
+
+    loadLazyLayer(li);
+
+    FeatureHierarchy &h = _p.getHierarchy();
+
+    cl_int2 numChunks = h.getNumChunks(li);
+
+    if (_chunkWinnerIndices.size() != h.getNumLayers())
+        _chunkWinnerIndices.resize(h.getNumLayers());
+
+    if (_chunkWinnerIndices[li]() == nullptr)
+        _chunkWinnerIndices[li] = cl::Buffer(_resources->_cs->getContext(), CL_MEM_READ_WRITE, numChunks.x * numChunks.y * sizeof(cl_int));
+
+    h.getChunkWinnerIndices(*_resources->_cs, li, _chunkWinnerIndices[li]);
+
+    _resources->_cs->getQueue().enqueueReadBuffer(_chunkWinnerIndices[li], blocking ? CL_TRUE : CL_FALSE, 0, numChunks.x * numChunks.y * sizeof(cl_int), indices);
+    _resources->_cs->countTransfer(_deviceToHost, "chunkWinners", numChunks.x * numChunks.y * sizeof(cl_int));
+}
+
+void Hierarchy::waitForReads() {
+    _resources->_cs->getQueue().finish();
+}
+
+void Hierarchy::setProfiling(bool enabled) {
+    _resources->_cs->setProfiling(enabled);
+}
+
+bool Hierarchy::isProfiling() const {
+    return _resources->_cs->isProfiling();
+}
+
+std::vector<KernelTiming> Hierarchy::getStepTimings() {
+    return _resources->_cs->getProfileStepTimings();
+}
+
+std::vector<KernelStats> Hierarchy::getKernelStats() {
+    return _resources->_cs->getProfileStats();
+}
+
+void Hierarchy::resetKernelStats() {
+    _resources->_cs->resetProfile();
+}
+
+std::vector<TransferStats> Hierarchy::getTransferStats() {
+    return _resources->_cs->getTransferStats();
+}
+
+void Hierarchy::resetTransferStats() {
+    _resources->_cs->resetTransferStats();
+}
+
+std::vector<MemoryUsage> Hierarchy::getMemoryUsage() const {
+    std::vector<MemoryUsage> usages;
+
+    MemoryUsage inputs("inputs", -1);
+
+    for (int i = 0; i < _inputImagesFeed.size(); i++) {
+        addMemory(inputs, _memoryStates, _inputImagesFeed[i]);
+        addMemory(inputs, _memoryStates, _inputImagesPredict[i]);
+    }
+
+    usages.push_back(inputs);
+
+    std::vector<MemoryUsage> layerUsages = _p.getMemoryUsage();
+
+    usages.insert(usages.end(), layerUsages.begin(), layerUsages.end());
+
+    return usages;
+}
+
+void Hierarchy::startTrace(size_t capacity) {
+    _resources->_cs->startTrace(capacity);
+}
+
+void Hierarchy::stopTrace() {
+    _resources->_cs->stopTrace();
+}
+
+bool Hierarchy::saveTrace(const std::string &fileName) {
+    return _resources->_cs->saveTrace(fileName);
+}
+
+void Hierarchy::setMetricsSink(const std::shared_ptr<MetricsSink> &sink) {
+    _resources->_cs->setMetricsSink(sink);
+}
@@ -38,12 +38,62 @@ namespace ogmaneo {
 
         std::shared_ptr<Resources> _resources;
 
+        /*!
+        \brief Device side chunk winner indices per layer, created on first read
+        */
+        std::vector<cl::Buffer> _chunkWinnerIndices;
+
+        /*!
+        \brief Last base checkpoint, that delta checkpoints are relative to
+        */
+        std::shared_ptr<CheckpointBase> _checkpointBase;
+
+        /*!
+        \brief Mapped hierarchy file (see load)
+        */
+        struct MappedHierarchy;
+
+        /*!
+        \brief File of a lazy load, kept until all its layers are loaded
+        */
+        std::shared_ptr<MappedHierarchy> _lazyFile;
+
+        /*!
+        \brief Map and validate a hierarchy file (plain or checkpoint), returns nullptr if it can not be loaded
+        */
+        static std::shared_ptr<MappedHierarchy> openFile(const std::string &fileName);
+
+        /*!
+        \brief Load the parts of layer li still pending from a lazy load, and release the file once all are loaded
+        */
+        void loadLazyLayer(int li);
+
+        /*!
+        \brief Throw std::out_of_range if li is not a layer index
+        */
+        void checkLayerIndex(int li) const;
+
+        /*!
+        \brief Load the input images and predictions
+        */
+        void loadInputs(const ogmaneo::schemas::Hierarchy* fbHierarchy, ComputeSystem &cs, CheckpointReader* reader);
+
+        /*!
+        \brief Whether the input layers of a file have the number and sizes of those of this hierarchy
+        */
+        bool areInputsCompatible(const ogmaneo::schemas::Hierarchy* fbHierarchy) const;
+
+        /*!
+        \brief Throw std::runtime_error unless the inputs and every layer of a file match this hierarchy (see isLayerCompatible, isPredLayerCompatible)
+        */
+        void checkCompatible(const ogmaneo::schemas::Hierarchy* fbHierarchy) const;
+
         //!@{
         /*!
         \brief Serialization
         */
-        void load(const ogmaneo::schemas::Hierarchy* fbHierarchy, ComputeSystem &cs);
-        flatbuffers::Offset<ogmaneo::schemas::Hierarchy> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+        void load(const ogmaneo::schemas::Hierarchy* fbHierarchy, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+        flatbuffers::Offset<ogmaneo::schemas::Hierarchy> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
         //!@}
 
     public:
@@ -53,6 +103,40 @@ namespace ogmaneo {
         void activate(std::vector<ValueField2D> &inputsFeed);
         void learn(std::vector<ValueField2D> &inputsPredict, float tdError = 0.0f);
 
+        //!@{
+        /*!
+        \brief Run a single simulation tick on inputs already written with writeInputFeed/writeInputPredict
+        Predictions are not read back, use readPredictions for the layers required.
+        */
+        void activate();
+        void learn(float tdError = 0.0f);
+        //!@}
+
+        //!@{
+        /*!
+        \brief Raw input/output for bindings that manage their own memory
+        \param i index of the input layer.
+        \param data row major, getInputSize(i).x * getInputSize(i).y floats. Written and read directly, no staging copy is made.
+        */
+        void writeInputFeed(int i, const float* data);
+        void writeInputPredict(int i, const float* data);
+        void readPredictions(int i, float* data);
+        //!@}
+
+        /*!
+        \brief Get the size of an input layer (and its predictions)
+        */
+        Vec2i getInputSize(int i) const {
+            return _predictions[i].getSize();
+        }
+
+        /*!
+        \brief Get the number of input layers
+        */
+        int getNumInputs() const {
+            return static_cast<int>(_inputImagesFeed.size());
+        }
+
         /*!
         \brief Get the feed images (input)
         */
@@ -83,17 +167,189 @@ namespace ogmaneo {
 
         /*!
         \brief Specifically for accessing chunk states from bindings
+        Throws std::out_of_range if li is not a layer index.
         */
         void readChunkStates(int li, ValueField2D &valueField);
 
-        //!@{
         /*!
-        \brief Serialization
+        \brief Read the winner of each chunk of a layer as one index per chunk (dx + dy * chunkSize.x)
+        Only getNumChunks(li).x * getNumChunks(li).y ints are transferred, instead of the full hidden states.
+        \param li index of the layer.
+        \param indices caller owned, at least getNumChunks(li).x * getNumChunks(li).y ints, row major by chunk.
+        \param blocking if false the read is only enqueued, indices must stay valid until waitForReads() (or any blocking call) returns.
+        Throws std::out_of_range if li is not a layer index, and std::invalid_argument if indices is nullptr.
         */
-        void load(ComputeSystem &cs, const std::string &fileName);
-        void save(ComputeSystem &cs, const std::string &fileName);
-        //!@}
+        void readChunkWinners(int li, int* indices, bool blocking = true);
+
+        /*!
+        \brief Get the number of chunks in each dimension of a layer
+        */
+        Vec2i getNumChunks(int li) const {
+            cl_int2 numChunks = _p.getHierarchy().getNumChunks(li);
+
+            return Vec2i(numChunks.x, numChunks.y);
+        }
+
+        /*!
+        \brief Wait for outstanding non-blocking reads to complete
+        */
+        void waitForReads();
+
+        /*!
+        \brief Enable or disable per kernel profiling on the ComputeSystem of this hierarchy (see ComputeSystem::setProfiling)
+        Each activate starts a new profiling step. Kernels are tagged with their scope ("encoder", "predictor") and layer.
+        Profiling applies to all hierarchies sharing the ComputeSystem. Only call this between steps.
+        */
+        void setProfiling(bool enabled);
+
+        /*!
+        \brief Whether per kernel profiling is enabled
+        */
+        bool isProfiling() const;
+
+        /*!
+        \brief Kernel timings of the current step (the last activate and the learn that followed), waits for them to complete
+        */
+        std::vector<KernelTiming> getStepTimings();
+
+        /*!
+        \brief Kernel timings aggregated by kernel, scope and layer since profiling was enabled or reset, waits for pending kernels
+        */
+        std::vector<KernelStats> getKernelStats();
+
+        /*!
+        \brief Clear the profiling timings
+        */
+        void resetKernelStats();
+
+        /*!
+        \brief Bytes and number of host/device transfers per call site and direction (see ComputeSystem::countTransfer)
+        Counted on the ComputeSystem, so this includes all hierarchies sharing it.
+        */
+        std::vector<TransferStats> getTransferStats();
+
+        /*!
+        \brief Clear the transfer counters
+        */
+        void resetTransferStats();
+
+        /*!
+        \brief Device memory of the allocated images, in the layout of Architect::estimateMemory
+        Layers pending from loadLazy are already allocated, so they are included.
+        */
+        std::vector<MemoryUsage> getMemoryUsage() const;
+
+        /*!
+        \brief Start recording a timeline of this hierarchy into a ring buffer (see ComputeSystem::startTrace)
+        Host spans (activate, learn, input writes, prediction reads, saves, and the per layer calls of the encoders and predictors)
+        are recorded together with the device interval of each kernel. Applies to all hierarchies sharing the ComputeSystem.
+        \param capacity maximum number of events kept, the oldest are overwritten so tracing can stay on.
+        */
+        void startTrace(size_t capacity = 65536);
+
+        /*!
+        \brief Stop recording, the events recorded so far can still be saved
+        */
+        void stopTrace();
+
+        /*!
+        \brief Save the recorded events as a Chrome trace JSON file (open in Perfetto or chrome://tracing)
+        \return false if nothing was traced or the file could not be written.
+        */
+        bool saveTrace(const std::string &fileName);
+
+        /*!
+        \brief Report the hot path metrics of the encoders and predictors to a sink, nullptr to stop (see ComputeSystem::setMetricsSink)
+        Pass a MetricsAggregator to keep totals per scope and layer. Applies to all hierarchies sharing the ComputeSystem.
+        */
+        void setMetricsSink(const std::shared_ptr<MetricsSink> &sink);
+
+        /*!
+        \brief Load a hierarchy file (full, checkpoint or compact)
+        Throws std::runtime_error if the file does not match this hierarchy (inputs, layer shapes, image sizes) or its pixel data is truncated.
+        The hierarchy is then only partly loaded, and should be loaded again or discarded.
+        \return false (and nothing is loaded) if the file could not be opened, is not a valid hierarchy or checkpoint, or is a delta checkpoint.
+        */
+        bool load(ComputeSystem &cs, const std::string &fileName);
+
+        /*!
+        \brief Save the whole hierarchy as a single flatbuffer
+        \return false if the buffer did not verify or the file could not be written.
+        */
+        bool save(ComputeSystem &cs, const std::string &fileName);
+
+        /*!
+        \brief Load a hierarchy file, deferring each layer until its first use
+        Only the inputs are restored immediately. The file stays mapped and each layer is uploaded when it is first used
+        (activate, learn, saves and clone load all layers, readChunkStates/readChunkWinners only their layer).
+        Call loadLazyLayers before accessing layers through getPredictor.
+        Every layer is checked up front (see loadLayers), throws std::runtime_error without changing the hierarchy if one does not match.
+        \return false (and nothing is loaded) if the file could not be read (see load).
+        */
+        bool loadLazy(ComputeSystem &cs, const std::string &fileName);
+
+        /*!
+        \brief Load the layers still pending from loadLazy
+        */
+        void loadLazyLayers();
+
+        /*!
+        \brief Whether layer li is loaded (false while pending from loadLazy)
+        */
+        bool isLayerLoaded(int li) const;
+
+        /*!
+        \brief Restore a range of layers from a hierarchy file, leaving other layers untouched
+        Allows swapping single layers, or warm starting a deeper hierarchy from a shallower one
+        (the top layer of the shallower one usually only matches without its predictor, which also receives feedback in the deeper one).
+        Checkpoint files are only read for the payloads of the loaded layers.
+        \param loadFeatures restore the feature (encoder) layers.
+        \param loadPredictor restore the predictor layers.
+        \return false (and nothing is loaded) if the file could not be read, or a layer is missing or differs in shape.
+        */
+        bool loadLayers(ComputeSystem &cs, const std::string &fileName, int firstLayer, int numLayers, bool loadFeatures = true, bool loadPredictor = true);
+
+        /*!
+        \brief Copy this hierarchy, for forking a model (A/B tests, rollouts)
+        The copy lives on the same ComputeSystem, every image is copied device to device without host staging.
+        Copies are only enqueued, both hierarchies can be used straight away (the queue is in order).
+        Layers pending from loadLazy are loaded first. The copy continues from the same random state.
+        */
+        std::shared_ptr<Hierarchy> clone();
+
+        /*!
+        \brief Save as a streaming checkpoint (see Checkpoint.h), loaded with load like any other hierarchy file
+        Images are written to the file as they are read back from the device, so peak host memory
+        is bounded staging memory plus the (pixel free) metadata rather than the whole serialized model.
+        \param compact only store the halves of double buffers that are live between steps, and skip scratch buffers (about half the size).
+        \param compress block compress the images (see compressPixels), on multiple threads.
+        \return false if the file could not be written.
+        */
+        bool saveCheckpoint(ComputeSystem &cs, const std::string &fileName, bool compact = false, bool compress = false);
+
+        /*!
+        \brief Save an inference-only model, loaded with load like any other hierarchy file
+        Only the state read by activate is stored (no learning state or previous step buffers), and weights
+        are quantized over the range of each unit (see quantizeWeights). The loaded hierarchy runs activate as before, it is not meant to learn further.
+        \param precision storage precision of the weights (dequantized to float on load).
+        \return false if the file could not be written.
+        */
+        bool exportInference(ComputeSystem &cs, const std::string &fileName, WeightPrecision precision = _int8);
+
+        /*!
+        \brief Save a full checkpoint that later delta checkpoints are relative to
+        */
+        bool saveBaseCheckpoint(ComputeSystem &cs, const std::string &fileName, bool compact = false);
+
+        /*!
+        \brief Save a delta checkpoint, holding only what changed since the last base checkpoint
+        Weights of layers that did not learn are not even read back, others only store the tiles that differ.
+        Deltas can not be loaded directly, merge them with their base using compactCheckpoint (or the OgmaCompactCheckpoint tool).
+        \return false if no base checkpoint was saved (since the last load), or the file could not be written.
+        */
+        bool saveDeltaCheckpoint(ComputeSystem &cs, const std::string &fileName);
 
         friend class Architect;
+        friend class AsyncCheckpointer;
     };
 }
\ No newline at end of file
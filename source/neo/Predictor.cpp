@@ -7,6 +7,7 @@
 // ----------------------------------------------------------------------------
 
 #include "Predictor.h"
+#include "Checkpoint.h"
 
 #include <iostream>
 
@@ -78,8 +79,12 @@ void Predictor::activate(ComputeSystem &cs, const std::vector<cl::Image2D> &inpu
     // Forward pass through predictor to get next prediction
     for (int l = _pLayers.size() - 1; l >= 0; l--) {
         if (_h.getLayer(l)._tpReset) {
+            TraceScope scope(cs.getTracer(), "predictor", "activate", l);
+
             _needsUpdate[l] = true;
 
+            cs.setProfileTag("predictor", l);
+
             // Others make corrections over multiple (destrided) timesteps
             if (l < _pLayers.size() - 1) {
                 for (int k = 0; k < _pLayers[l].size(); k++)
@@ -93,7 +98,11 @@ void Predictor::activate(ComputeSystem &cs, const std::vector<cl::Image2D> &inpu
             for (int k = 0; k < _pLayers[l].size(); k++)
                 _pLayers[l][k].stepEnd(cs);
         }
+        else
+            OGMA_METRIC_COUNT_AT(cs, "skips", "predictor", l, 1);
     }
+
+    cs.setProfileTag(nullptr, -1);
 }
 
 void Predictor::learn(ComputeSystem &cs, const std::vector<cl::Image2D> &inputsPredict, std::mt19937 &rng, float tdError) {
@@ -107,6 +116,10 @@ void Predictor::learn(ComputeSystem &cs, const std::vector<cl::Image2D> &inputsP
 
     for (int l = 0; l < _pLayers.size(); l++) {
         if ((l == 0 || _h.getLayer(l - 1)._clock == 1) && _needsUpdate[l]) { // == 1 ?
+            TraceScope scope(cs.getTracer(), "predictor", "learn", l);
+
+            cs.setProfileTag("predictor", l);
+
             if (l == 0) {
                 for (int k = 0; k < _pLayers[l].size(); k++)
                     _pLayers[l][k].learn(cs, inputsPredict[k], true, tdError);
@@ -119,6 +132,81 @@ void Predictor::learn(ComputeSystem &cs, const std::vector<cl::Image2D> &inputsP
             _needsUpdate[l] = false;
         }
     }
+
+    cs.setProfileTag(nullptr, -1);
+}
+
+Predictor Predictor::clone(ComputeSystem &cs) const {
+    Predictor p = *this;
+
+    p._h = _h.clone(cs);
+
+    for (int l = 0; l < _pLayers.size(); l++) {
+        for (int k = 0; k < _pLayers[l].size(); k++)
+            p._pLayers[l][k] = _pLayers[l][k].clone(cs);
+    }
+
+    return p;
+}
+
+std::vector<MemoryUsage> Predictor::getMemoryUsage() const {
+    std::vector<MemoryUsage> usages;
+
+    for (int l = 0; l < _pLayers.size(); l++) {
+        MemoryUsage encoder = _h.getLayer(l)._sf->getMemoryUsage();
+
+        encoder._scope = "encoder";
+        encoder._layer = l;
+
+        usages.push_back(encoder);
+
+        MemoryUsage predictor("predictor", l);
+
+        for (int k = 0; k < _pLayers[l].size(); k++)
+            predictor.add(_pLayers[l][k].getMemoryUsage());
+
+        usages.push_back(predictor);
+    }
+
+    return usages;
+}
+
+std::vector<MemoryUsage> Predictor::estimateMemory(const std::vector<cl_int2> &inputSizes,
+    const std::vector<std::vector<PredLayerDesc>> &pLayerDescs, const std::vector<FeatureHierarchy::LayerDesc> &hLayerDescs)
+{
+    assert(pLayerDescs.size() == hLayerDescs.size());
+
+    std::vector<MemoryUsage> usages;
+
+    // Same shapes as createRandom
+    for (int l = 0; l < pLayerDescs.size(); l++) {
+        MemoryUsage encoder = hLayerDescs[l]._sfDesc->estimateMemory();
+
+        encoder._scope = "encoder";
+        encoder._layer = l;
+
+        usages.push_back(encoder);
+
+        MemoryUsage predictor("predictor", l);
+
+        for (int k = 0; k < pLayerDescs[l].size(); k++) {
+            std::vector<PredictorLayer::VisibleLayerDesc> pVisibleLayerDescs(l < pLayerDescs.size() - 1 ? 2 : 1);
+
+            for (PredictorLayer::VisibleLayerDesc &vld : pVisibleLayerDescs) {
+                vld._radius = pLayerDescs[l][k]._radius;
+                vld._size = hLayerDescs[l]._sfDesc->getHiddenSize();
+            }
+
+            if (l == 0)
+                predictor.add(PredictorLayer::estimateMemory(inputSizes[k], pVisibleLayerDescs, pLayerDescs[l][k]._isQ ? PredictorLayer::_q : PredictorLayer::_none));
+            else
+                predictor.add(PredictorLayer::estimateMemory(hLayerDescs[l - 1]._sfDesc->getHiddenSize(), pVisibleLayerDescs, PredictorLayer::_inhibitBinary));
+        }
+
+        usages.push_back(predictor);
+    }
+
+    return usages;
 }
 
 void Predictor::PredLayerDesc::load(const schemas::PredLayerDesc* fbPredLayerDesc, ComputeSystem &cs) {
@@ -134,30 +222,66 @@ flatbuffers::Offset<schemas::PredLayerDesc> Predictor::PredLayerDesc::save(flatb
     return schemas::CreatePredLayerDesc(builder, _isQ, _radius, _alpha, _beta, _lambda, _gamma);
 }
 
-void Predictor::load(const schemas::Predictor* fbPredictor, ComputeSystem &cs) {
+void Predictor::load(const schemas::Predictor* fbPredictor, ComputeSystem &cs, CheckpointReader* reader) {
     assert(_pLayerDescs.size() == fbPredictor->_pLayerDescs()->Length());
     assert(_pLayers.size() == fbPredictor->_pLayers()->Length());
 
-    _h.load(fbPredictor->_h(), cs);
+    _h.load(fbPredictor->_h(), cs, reader);
+
+    for (flatbuffers::uoffset_t i = 0; i < fbPredictor->_pLayers()->Length(); i++) {
+        loadLayer(fbPredictor, i, cs, reader, false, true);
+    }
+}
+
+bool Predictor::isPredLayerCompatible(const schemas::Predictor* fbPredictor, int li) const {
+    if (li < 0 || li >= _pLayers.size() || li >= fbPredictor->_pLayers()->Length() || li >= fbPredictor->_pLayerDescs()->Length())
+        return false;
 
-    for (flatbuffers::uoffset_t i = 0; i < fbPredictor->_pLayerDescs()->Length(); i++) {
-        assert(_pLayerDescs[i].size() == fbPredictor->_pLayerDescs()->Get(i)->_pLayerDescs()->Length());
+    const schemas::PredictorLayers* fbPredictorLayers = fbPredictor->_pLayers()->Get(li);
 
-        for (flatbuffers::uoffset_t j = 0; j < fbPredictor->_pLayerDescs()->Get(i)->_pLayerDescs()->Length(); j++) {
-            _pLayerDescs[i][j].load(fbPredictor->_pLayerDescs()->Get(i)->_pLayerDescs()->Get(j), cs);
+    if (fbPredictorLayers->_pLayers()->Length() != _pLayers[li].size() ||
+        fbPredictor->_pLayerDescs()->Get(li)->_pLayerDescs()->Length() != _pLayerDescs[li].size())
+        return false;
+
+    for (flatbuffers::uoffset_t j = 0; j < fbPredictorLayers->_pLayers()->Length(); j++) {
+        const schemas::PredictorLayer* fbPredictorLayer = fbPredictorLayers->_pLayers()->Get(j);
+        const PredictorLayer &layer = _pLayers[li][j];
+
+        if (fbPredictorLayer->_hiddenSize()->x() != layer.getHiddenSize().x || fbPredictorLayer->_hiddenSize()->y() != layer.getHiddenSize().y ||
+            fbPredictorLayer->_visibleLayers()->Length() != layer.getNumLayers())
+            return false;
+
+        for (flatbuffers::uoffset_t k = 0; k < fbPredictorLayer->_visibleLayerDescs()->Length(); k++) {
+            const schemas::VisiblePredictorLayerDesc* fbVisibleLayerDesc = fbPredictorLayer->_visibleLayerDescs()->Get(k);
+
+            if (fbVisibleLayerDesc->_size().x() != layer.getLayerDesc(k)._size.x || fbVisibleLayerDesc->_size().y() != layer.getLayerDesc(k)._size.y ||
+                fbVisibleLayerDesc->_radius() != layer.getLayerDesc(k)._radius)
+                return false;
         }
     }
 
-    for (flatbuffers::uoffset_t i = 0; i < fbPredictor->_pLayers()->Length(); i++) {
-        assert(_pLayers[i].size() == fbPredictor->_pLayers()->Get(i)->_pLayers()->Length());
+    return true;
+}
 
-        for (flatbuffers::uoffset_t j = 0; j < fbPredictor->_pLayerDescs()->Get(i)->_pLayerDescs()->Length(); j++) {
-            _pLayers[i][j].load(fbPredictor->_pLayers()->Get(i)->_pLayers()->Get(j), cs);
-        }
+void Predictor::loadLayer(const schemas::Predictor* fbPredictor, int li, ComputeSystem &cs, CheckpointReader* reader, bool loadFeatures, bool loadPredictor) {
+    if (loadFeatures)
+        _h.loadLayer(fbPredictor->_h(), li, cs, reader);
+
+    if (!loadPredictor)
+        return;
+
+    assert(isPredLayerCompatible(fbPredictor, li));
+
+    for (flatbuffers::uoffset_t j = 0; j < fbPredictor->_pLayerDescs()->Get(li)->_pLayerDescs()->Length(); j++) {
+        _pLayerDescs[li][j].load(fbPredictor->_pLayerDescs()->Get(li)->_pLayerDescs()->Get(j), cs);
+    }
+
+    for (flatbuffers::uoffset_t j = 0; j < fbPredictor->_pLayers()->Get(li)->_pLayers()->Length(); j++) {
+        _pLayers[li][j].load(fbPredictor->_pLayers()->Get(li)->_pLayers()->Get(j), cs, reader);
     }
 }
 
-flatbuffers::Offset<schemas::Predictor> Predictor::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::Predictor> Predictor::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
     std::vector<flatbuffers::Offset<schemas::PredLayerDescs>> predLayerDescs;
     for (std::vector<PredLayerDesc> layerDescs : _pLayerDescs) {
         std::vector<flatbuffers::Offset<schemas::PredLayerDesc>> predLayerDesc;
@@ -168,14 +292,20 @@ flatbuffers::Offset<schemas::Predictor> Predictor::save(flatbuffers::FlatBufferB
     }
 
     std::vector<flatbuffers::Offset<schemas::PredictorLayers>> predictorLayers;
-    for (std::vector<PredictorLayer> layers : _pLayers) {
+    for (int l = 0; l < _pLayers.size(); l++) {
+        if (writer != nullptr)
+            writer->beginSection();
+
         std::vector<flatbuffers::Offset<schemas::PredictorLayer>> predictorLayer;
-        for (PredictorLayer layer : layers)
-            predictorLayer.push_back(layer.save(builder, cs));
+        for (PredictorLayer &layer : _pLayers[l])
+            predictorLayer.push_back(layer.save(builder, cs, writer));
+
+        if (writer != nullptr)
+            writer->endSection(schemas::CheckpointSectionType_CST_PREDICTOR_LAYER, l);
 
         predictorLayers.push_back(schemas::CreatePredictorLayers(builder, builder.CreateVector(predictorLayer)));
     }
 
     return schemas::CreatePredictor(builder,
-        _h.save(builder, cs), builder.CreateVector(predLayerDescs), builder.CreateVector(predictorLayers));
+        _h.save(builder, cs, writer), builder.CreateVector(predLayerDescs), builder.CreateVector(predictorLayers));
 }
\ No newline at end of file
@@ -112,6 +112,22 @@ namespace ogmaneo {
         */
         void learn(ComputeSystem &cs, const std::vector<cl::Image2D> &inputsPredict, std::mt19937 &rng, float tdError = 0.0f);
 
+        /*!
+        \brief Copy with device side copies of all images (see Hierarchy::clone)
+        */
+        Predictor clone(ComputeSystem &cs) const;
+
+        /*!
+        \brief Device memory of each encoder layer and each predictor layer (summed over its predictions)
+        */
+        std::vector<MemoryUsage> getMemoryUsage() const;
+
+        /*!
+        \brief Device memory createRandom will allocate for the given descs, in the same layout as getMemoryUsage
+        */
+        static std::vector<MemoryUsage> estimateMemory(const std::vector<cl_int2> &inputSizes,
+            const std::vector<std::vector<PredLayerDesc>> &pLayerDescs, const std::vector<FeatureHierarchy::LayerDesc> &hLayerDescs);
+
         /*!
         \brief Get number of predictor layers
         Matches the number of layers in the feature hierarchy.
@@ -148,12 +164,26 @@ namespace ogmaneo {
             return _h;
         }
 
+        const FeatureHierarchy &getHierarchy() const {
+            return _h;
+        }
+
         //!@{
         /*!
         \brief Serialization
         */
-        void load(const schemas::Predictor* fbPredictor, ComputeSystem &cs);
-        flatbuffers::Offset<schemas::Predictor> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+        void load(const schemas::Predictor* fbPredictor, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+        flatbuffers::Offset<schemas::Predictor> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
         //!@}
+
+        /*!
+        \brief Whether the predictor layers li of a saved predictor can be loaded into this one (same count, hidden and visible layer sizes)
+        */
+        bool isPredLayerCompatible(const schemas::Predictor* fbPredictor, int li) const;
+
+        /*!
+        \brief Load a single layer, its feature layer and/or its predictor layers (see isPredLayerCompatible)
+        */
+        void loadLayer(const schemas::Predictor* fbPredictor, int li, ComputeSystem &cs, CheckpointReader* reader = nullptr, bool loadFeatures = true, bool loadPredictor = true);
     };
 }
\ No newline at end of file
@@ -95,6 +95,8 @@ void PredictorLayer::createRandom(ComputeSystem &cs, ComputeProgram &plProgram,
 }
 
 void PredictorLayer::activate(ComputeSystem &cs, const std::vector<cl::Image2D> &visibleStates, std::mt19937 &rng) {
+    OGMA_METRIC_SCOPE(cs, "pl.activate");
+
     cl::array<cl::size_type, 3> zeroOrigin = { 0, 0, 0 };
     cl::array<cl::size_type, 3> hiddenRegion = { static_cast<cl_uint>(_hiddenSize.x), static_cast<cl_uint>(_hiddenSize.y), 1 };
 
@@ -115,7 +117,7 @@ void PredictorLayer::activate(ComputeSystem &cs, const std::vector<cl::Image2D>
             _deriveInputsKernel.setArg(argIndex++, vl._derivedInput[_front]);
             _deriveInputsKernel.setArg(argIndex++, vld._gamma);
 
-            cs.getQueue().enqueueNDRangeKernel(_deriveInputsKernel, cl::NullRange, cl::NDRange(vld._size.x, vld._size.y));
+            cs.enqueueKernel(_deriveInputsKernel, cl::NDRange(vld._size.x, vld._size.y));
         }
 
         {
@@ -130,10 +132,12 @@ void PredictorLayer::activate(ComputeSystem &cs, const std::vector<cl::Image2D>
             _stimulusKernel.setArg(argIndex++, vld._radius);
             _stimulusKernel.setArg(argIndex++, _chunkSize);
 
-            cs.getQueue().enqueueNDRangeKernel(_stimulusKernel, cl::NullRange, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
+            cs.enqueueKernel(_stimulusKernel, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
 
             // Swap buffers
             std::swap(_hiddenSummationTemp[_front], _hiddenSummationTemp[_back]);
+
+            OGMA_METRIC_COUNT(cs, "swaps", 1);
         }  
     }
 
@@ -149,13 +153,15 @@ void PredictorLayer::activate(ComputeSystem &cs, const std::vector<cl::Image2D>
         _inhibitBinaryKernel.setArg(argIndex++, _hiddenSize);
         _inhibitBinaryKernel.setArg(argIndex++, _chunkSize);
 
-        cs.getQueue().enqueueNDRangeKernel(_inhibitBinaryKernel, cl::NullRange, cl::NDRange(chunksInX, chunksInY));
+        cs.enqueueKernel(_inhibitBinaryKernel, cl::NDRange(chunksInX, chunksInY));
     }
     else
         cs.getQueue().enqueueCopyImage(_hiddenSummationTemp[_back], _hiddenStates[_front], { 0, 0, 0 }, { 0, 0, 0 }, { static_cast<cl::size_type>(_hiddenSize.x), static_cast<cl::size_type>(_hiddenSize.y), 1 });
 }
 
 void PredictorLayer::propagate(ComputeSystem &cs, const cl::Image2D &hiddenStates, const cl::Image2D &hiddenTargets, int vli, DoubleBuffer2D &visibleStates, std::mt19937 &rng) {
+    OGMA_METRIC_SCOPE(cs, "pl.propagate");
+
     VisibleLayer &vl = _visibleLayers[vli];
     VisibleLayerDesc &vld = _visibleLayerDescs[vli];
 
@@ -173,7 +179,7 @@ void PredictorLayer::propagate(ComputeSystem &cs, const cl::Image2D &hiddenState
     _propagateKernel.setArg(argIndex++, vld._radius);
     _propagateKernel.setArg(argIndex++, vl._reverseRadii);
 
-    cs.getQueue().enqueueNDRangeKernel(_propagateKernel, cl::NullRange, cl::NDRange(vld._size.x, vld._size.y));
+    cs.enqueueKernel(_propagateKernel, cl::NDRange(vld._size.x, vld._size.y));
 }
 
 void PredictorLayer::stepEnd(ComputeSystem &cs) {
@@ -189,9 +195,13 @@ void PredictorLayer::stepEnd(ComputeSystem &cs) {
 
         std::swap(vl._derivedInput[_front], vl._derivedInput[_back]);
     }
+
+    OGMA_METRIC_COUNT(cs, "swaps", 1 + _visibleLayers.size());
 }
 
 void PredictorLayer::learn(ComputeSystem &cs, const cl::Image2D &targets, bool predictFromPrevious, float tdError) {
+    OGMA_METRIC_SCOPE(cs, "pl.learn");
+
     if (_type == _inhibitBinary) {
         // Learn weights
         for (int vli = 0; vli < _visibleLayers.size(); vli++) {
@@ -211,9 +221,13 @@ void PredictorLayer::learn(ComputeSystem &cs, const cl::Image2D &targets, bool p
             _learnPredWeightsKernel.setArg(argIndex++, _chunkSize);
             _learnPredWeightsKernel.setArg(argIndex++, vld._alpha);
 
-            cs.getQueue().enqueueNDRangeKernel(_learnPredWeightsKernel, cl::NullRange, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
+            cs.enqueueKernel(_learnPredWeightsKernel, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
 
             std::swap(vl._weights[_front], vl._weights[_back]);
+
+            OGMA_METRIC_COUNT(cs, "swaps", 1);
+
+            vl._weightsChanged = true;
         }
     }
     else if (_type == _q) {
@@ -237,9 +251,13 @@ void PredictorLayer::learn(ComputeSystem &cs, const cl::Image2D &targets, bool p
             _learnPredWeightsKernel.setArg(argIndex++, tdError);
             _learnPredWeightsKernel.setArg(argIndex++, vld._lambda);
 
-            cs.getQueue().enqueueNDRangeKernel(_learnPredWeightsKernel, cl::NullRange, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
+            cs.enqueueKernel(_learnPredWeightsKernel, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
 
             std::swap(vl._weights[_front], vl._weights[_back]);
+
+            OGMA_METRIC_COUNT(cs, "swaps", 1);
+
+            vl._weightsChanged = true;
         }
     }
     else {
@@ -261,9 +279,13 @@ void PredictorLayer::learn(ComputeSystem &cs, const cl::Image2D &targets, bool p
             _learnPredWeightsKernel.setArg(argIndex++, _chunkSize);
             _learnPredWeightsKernel.setArg(argIndex++, vld._alpha);
 
-            cs.getQueue().enqueueNDRangeKernel(_learnPredWeightsKernel, cl::NullRange, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
+            cs.enqueueKernel(_learnPredWeightsKernel, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
 
             std::swap(vl._weights[_front], vl._weights[_back]);
+
+            OGMA_METRIC_COUNT(cs, "swaps", 1);
+
+            vl._weightsChanged = true;
         }
     }
 }
@@ -278,6 +300,57 @@ void PredictorLayer::clearMemory(ComputeSystem &cs) {
     cs.getQueue().enqueueFillImage(_hiddenStates[_back], zeroColor, zeroOrigin, hiddenRegion);
 }
 
+PredictorLayer PredictorLayer::clone(ComputeSystem &cs) const {
+    PredictorLayer layer = *this;
+
+    for (VisibleLayer &vl : layer._visibleLayers) {
+        vl._derivedInput = ogmaneo::copy(vl._derivedInput, cs);
+        vl._weights = ogmaneo::copy(vl._weights, cs);
+    }
+
+    layer._hiddenSummationTemp = ogmaneo::copy(_hiddenSummationTemp, cs);
+    layer._hiddenStates = ogmaneo::copy(_hiddenStates, cs);
+
+    layer._deriveInputsKernel = ogmaneo::copy(_deriveInputsKernel);
+    layer._stimulusKernel = ogmaneo::copy(_stimulusKernel);
+    layer._learnPredWeightsKernel = ogmaneo::copy(_learnPredWeightsKernel);
+    layer._propagateKernel = ogmaneo::copy(_propagateKernel);
+    layer._inhibitBinaryKernel = ogmaneo::copy(_inhibitBinaryKernel);
+
+    return layer;
+}
+
+MemoryUsage PredictorLayer::getMemoryUsage() const {
+    MemoryUsage usage;
+
+    for (const VisibleLayer &vl : _visibleLayers) {
+        addMemory(usage, _memoryWeights, vl._weights);
+        addMemory(usage, _memorySamples, vl._derivedInput);
+    }
+
+    addMemory(usage, _memoryStates, _hiddenStates);
+    addMemory(usage, _memoryTemps, _hiddenSummationTemp);
+
+    return usage;
+}
+
+MemoryUsage PredictorLayer::estimateMemory(cl_int2 hiddenSize, const std::vector<VisibleLayerDesc> &visibleLayerDescs, Type type) {
+    // Mirrors the allocations of createRandom
+    MemoryUsage usage;
+
+    for (const VisibleLayerDesc &vld : visibleLayerDescs) {
+        int weightDiam = vld._radius * 2 + 1;
+
+        usage.add(_memoryWeights, imageBytes({ hiddenSize.x, hiddenSize.y, weightDiam * weightDiam }, type == _q ? 2 : 1), 2);
+        usage.add(_memorySamples, imageBytes({ vld._size.x, vld._size.y, 1 }, 2), 2);
+    }
+
+    usage.add(_memoryStates, imageBytes({ hiddenSize.x, hiddenSize.y, 1 }, type == _inhibitBinary ? 2 : 1), 2);
+    usage.add(_memoryTemps, imageBytes({ hiddenSize.x, hiddenSize.y, 1 }, 1), 2);
+
+    return usage;
+}
+
 void PredictorLayer::VisibleLayerDesc::load(const schemas::VisiblePredictorLayerDesc* fbVisiblePredictorLayerDesc, ComputeSystem &cs) {
     _size = cl_int2{ fbVisiblePredictorLayerDesc->_size().x(), fbVisiblePredictorLayerDesc->_size().y() };
     _radius = fbVisiblePredictorLayerDesc->_radius();
@@ -291,26 +364,26 @@ schemas::VisiblePredictorLayerDesc PredictorLayer::VisibleLayerDesc::save(flatbu
     return schemas::VisiblePredictorLayerDesc(size, _radius, _alpha, _lambda, _gamma);
 }
 
-void PredictorLayer::VisibleLayer::load(const schemas::VisiblePredictorLayer* fbVisiblePredictorLayer, ComputeSystem &cs) {
+void PredictorLayer::VisibleLayer::load(const schemas::VisiblePredictorLayer* fbVisiblePredictorLayer, ComputeSystem &cs, CheckpointReader* reader) {
     _hiddenToVisible = cl_float2{ fbVisiblePredictorLayer->_hiddenToVisible()->x(), fbVisiblePredictorLayer->_hiddenToVisible()->y() };
     _visibleToHidden = cl_float2{ fbVisiblePredictorLayer->_visibleToHidden()->x(), fbVisiblePredictorLayer->_visibleToHidden()->y() };
     _reverseRadii = cl_int2{ fbVisiblePredictorLayer->_reverseRadii()->x(), fbVisiblePredictorLayer->_reverseRadii()->y() };
-    ogmaneo::load(_derivedInput, fbVisiblePredictorLayer->_derivedInput(), cs);
-    ogmaneo::load(_weights, fbVisiblePredictorLayer->_weights(), cs);
+    ogmaneo::load(_derivedInput, fbVisiblePredictorLayer->_derivedInput(), cs, reader);
+    ogmaneo::load(_weights, fbVisiblePredictorLayer->_weights(), cs, reader);
 }
 
-flatbuffers::Offset<schemas::VisiblePredictorLayer> PredictorLayer::VisibleLayer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::VisiblePredictorLayer> PredictorLayer::VisibleLayer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
     schemas::float2 hiddenToVisible(_hiddenToVisible.x, _hiddenToVisible.y);
     schemas::float2 visibleToHidden(_visibleToHidden.x, _visibleToHidden.y);
     schemas::int2 reverseRadii(_reverseRadii.x, _reverseRadii.y);
 
     return schemas::CreateVisiblePredictorLayer(builder,
-        ogmaneo::save(_derivedInput, builder, cs),
-        ogmaneo::save(_weights, builder, cs),
+        ogmaneo::save(_derivedInput, builder, cs, writer, _bothLive),
+        ogmaneo::saveWeights(_weights, builder, cs, writer, _weightsChanged),
         &hiddenToVisible, &visibleToHidden, &reverseRadii);
 }
 
-void PredictorLayer::load(const schemas::PredictorLayer* fbPredictorLayer, ComputeSystem &cs) {
+void PredictorLayer::load(const schemas::PredictorLayer* fbPredictorLayer, ComputeSystem &cs, CheckpointReader* reader) {
     assert(_hiddenSize.x == fbPredictorLayer->_hiddenSize()->x());
     assert(_hiddenSize.y == fbPredictorLayer->_hiddenSize()->y());
     assert(_visibleLayerDescs.size() == fbPredictorLayer->_visibleLayerDescs()->Length());
@@ -325,19 +398,19 @@ void PredictorLayer::load(const schemas::PredictorLayer* fbPredictorLayer, Compu
 
     _hiddenSize = cl_int2{ fbPredictorLayer->_hiddenSize()->x(), fbPredictorLayer->_hiddenSize()->y() };
 
-    ogmaneo::load(_hiddenSummationTemp, fbPredictorLayer->_hiddenSummationTemp(), cs);
-    ogmaneo::load(_hiddenStates, fbPredictorLayer->_hiddenStates(), cs);
+    ogmaneo::load(_hiddenSummationTemp, fbPredictorLayer->_hiddenSummationTemp(), cs, reader);
+    ogmaneo::load(_hiddenStates, fbPredictorLayer->_hiddenStates(), cs, reader);
 
     for (flatbuffers::uoffset_t i = 0; i < fbPredictorLayer->_visibleLayerDescs()->Length(); i++) {
         _visibleLayerDescs[i].load(fbPredictorLayer->_visibleLayerDescs()->Get(i), cs);
     }
 
     for (flatbuffers::uoffset_t i = 0; i < fbPredictorLayer->_visibleLayers()->Length(); i++) {
-        _visibleLayers[i].load(fbPredictorLayer->_visibleLayers()->Get(i), cs);
+        _visibleLayers[i].load(fbPredictorLayer->_visibleLayers()->Get(i), cs, reader);
     }
 }
 
-flatbuffers::Offset<schemas::PredictorLayer> PredictorLayer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::PredictorLayer> PredictorLayer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
     schemas::int2 hiddenSize(_hiddenSize.x, _hiddenSize.y);
     schemas::PredictorLayerType type;
 
@@ -354,13 +427,13 @@ flatbuffers::Offset<schemas::PredictorLayer> PredictorLayer::save(flatbuffers::F
         visibleLayerDescs.push_back(layerDesc.save(builder, cs));
 
     std::vector<flatbuffers::Offset<schemas::VisiblePredictorLayer>> visibleLayers;
-    for (VisibleLayer layer : _visibleLayers)
-        visibleLayers.push_back(layer.save(builder, cs));
+    for (VisibleLayer &layer : _visibleLayers)
+        visibleLayers.push_back(layer.save(builder, cs, writer));
 
     return schemas::CreatePredictorLayer(builder,
         type, &hiddenSize,
-        ogmaneo::save(_hiddenSummationTemp, builder, cs),
-        ogmaneo::save(_hiddenStates, builder, cs),
+        ogmaneo::save(_hiddenSummationTemp, builder, cs, writer, _scratch),
+        ogmaneo::save(_hiddenStates, builder, cs, writer, _bothLive),
         builder.CreateVectorOfStructs(visibleLayerDescs),
         builder.CreateVector(visibleLayers));
 }
\ No newline at end of file
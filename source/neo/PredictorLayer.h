@@ -84,12 +84,21 @@ namespace ogmaneo {
             cl_int2 _reverseRadii;
             //!@}
 
+            /*!
+            \brief Whether the weights were updated since the last base checkpoint (see saveWeights)
+            */
+            bool _weightsChanged;
+
+            VisibleLayer()
+                : _weightsChanged(true)
+            {}
+
             //!@{
             /*!
             \brief Serialization
             */
-            void load(const schemas::VisiblePredictorLayer* fbVisiblePredictorLayer, ComputeSystem &cs);
-            flatbuffers::Offset<schemas::VisiblePredictorLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+            void load(const schemas::VisiblePredictorLayer* fbVisiblePredictorLayer, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+            flatbuffers::Offset<schemas::VisiblePredictorLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
             //!@}
         };
 
@@ -190,6 +199,21 @@ namespace ogmaneo {
         */
         void clearMemory(ComputeSystem &cs);
 
+        /*!
+        \brief Copy with device side copies of all images (see Hierarchy::clone)
+        */
+        PredictorLayer clone(ComputeSystem &cs) const;
+
+        /*!
+        \brief Device memory of all images
+        */
+        MemoryUsage getMemoryUsage() const;
+
+        /*!
+        \brief Device memory createRandom will allocate for the given parameters (see Architect::estimateMemory)
+        */
+        static MemoryUsage estimateMemory(cl_int2 hiddenSize, const std::vector<VisibleLayerDesc> &visibleLayerDescs, Type type);
+
         /*!
         \brief Get number of layers
         */
@@ -236,8 +260,8 @@ namespace ogmaneo {
         /*!
         \brief Serialization
         */
-        void load(const schemas::PredictorLayer* fbPredictorLayer, ComputeSystem &cs);
-        flatbuffers::Offset<schemas::PredictorLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+        void load(const schemas::PredictorLayer* fbPredictorLayer, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+        flatbuffers::Offset<schemas::PredictorLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
         //!@}
     };
 }
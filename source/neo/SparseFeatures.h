@@ -43,6 +43,16 @@ namespace ogmaneo {
 
             virtual std::shared_ptr<SparseFeatures> sparseFeaturesFactory() = 0;
 
+            /*!
+            \brief Copy of this descriptor, not shared with this one
+            */
+            virtual std::shared_ptr<SparseFeaturesDesc> clone() const = 0;
+
+            /*!
+            \brief Device memory the encoder will allocate (see Architect::estimateMemory)
+            */
+            virtual MemoryUsage estimateMemory() const = 0;
+
             /*!
             \brief Initialize defaults
             */
@@ -128,6 +138,11 @@ namespace ogmaneo {
         */
         virtual const DoubleBuffer2D &getHiddenStates() const = 0;
 
+        /*!
+        \brief Get chunk winners (position of the winner within each chunk, RG float)
+        */
+        virtual const DoubleBuffer2D &getChunkWinners() const = 0;
+
         /*!
         \brief Get context
         */
@@ -140,12 +155,22 @@ namespace ogmaneo {
         */
         virtual void clearMemory(ComputeSystem &cs) = 0;
 
+        /*!
+        \brief Copy of these sparse features, with device side copies of all images (see Hierarchy::clone)
+        */
+        virtual std::shared_ptr<SparseFeatures> clone(ComputeSystem &cs) const = 0;
+
+        /*!
+        \brief Device memory of the images of the encoder
+        */
+        virtual MemoryUsage getMemoryUsage() const = 0;
+
         //!@{
         /*!
         \brief Serialization
         */
-        virtual void load(const schemas::SparseFeatures* fbSparseFeatures, ComputeSystem &cs) = 0;
-        virtual flatbuffers::Offset<schemas::SparseFeatures> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) = 0;
+        virtual void load(const schemas::SparseFeatures* fbSparseFeatures, ComputeSystem &cs, CheckpointReader* reader = nullptr) = 0;
+        virtual flatbuffers::Offset<schemas::SparseFeatures> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr) = 0;
         //!@}
     };
 }
\ No newline at end of file
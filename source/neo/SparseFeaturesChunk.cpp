@@ -113,6 +113,8 @@ SparseFeaturesChunk::SparseFeaturesChunk(ComputeSystem &cs, ComputeProgram &sfcP
 }
 
 void SparseFeaturesChunk::subSample(ComputeSystem &cs, const std::vector<cl::Image2D> &visibleStates, std::mt19937 &rng) {
+    OGMA_METRIC_SCOPE(cs, "sfc.subSample");
+
     // Find up stimulus
     for (int vli = 0; vli < _visibleLayers.size(); vli++) {
         VisibleLayer &vl = _visibleLayers[vli];
@@ -127,7 +129,7 @@ void SparseFeaturesChunk::subSample(ComputeSystem &cs, const std::vector<cl::Ima
             _deriveInputsKernel.setArg(argIndex++, vl._derivedInputs[_front]);
             _deriveInputsKernel.setArg(argIndex++, vld._lambda);
 
-            cs.getQueue().enqueueNDRangeKernel(_deriveInputsKernel, cl::NullRange, cl::NDRange(vld._size.x, vld._size.y));
+            cs.enqueueKernel(_deriveInputsKernel, cl::NDRange(vld._size.x, vld._size.y));
         }
 
         // Add sample
@@ -139,11 +141,13 @@ void SparseFeaturesChunk::subSample(ComputeSystem &cs, const std::vector<cl::Ima
             _addSampleKernel.setArg(argIndex++, vl._samplesAccum[_front]);
             _addSampleKernel.setArg(argIndex++, vld._numSamples);
 
-            cs.getQueue().enqueueNDRangeKernel(_addSampleKernel, cl::NullRange, cl::NDRange(vld._size.x, vld._size.y)); 
+            cs.enqueueKernel(_addSampleKernel, cl::NDRange(vld._size.x, vld._size.y)); 
         }
 
         std::swap(vl._derivedInputs[_front], vl._derivedInputs[_back]);
         std::swap(vl._samplesAccum[_front], vl._samplesAccum[_back]);
+
+        OGMA_METRIC_COUNT(cs, "swaps", 2);
     }
 }
 
@@ -159,7 +163,7 @@ cl::Image2D &SparseFeaturesChunk::getSubSample(ComputeSystem &cs, int vli, int i
         _sliceKernel.setArg(argIndex++, vl._samplesSlice);
         _sliceKernel.setArg(argIndex++, index);
 
-        cs.getQueue().enqueueNDRangeKernel(_sliceKernel, cl::NullRange, cl::NDRange(vld._size.x, vld._size.y));
+        cs.enqueueKernel(_sliceKernel, cl::NDRange(vld._size.x, vld._size.y));
     }
 
     return vl._samplesSlice;
@@ -177,13 +181,15 @@ cl::Image2D &SparseFeaturesChunk::getSubSampleAccum(ComputeSystem &cs, int vli,
         _sliceKernel.setArg(argIndex++, vl._samplesSlice);
         _sliceKernel.setArg(argIndex++, index);
 
-        cs.getQueue().enqueueNDRangeKernel(_sliceKernel, cl::NullRange, cl::NDRange(vld._size.x, vld._size.y));
+        cs.enqueueKernel(_sliceKernel, cl::NDRange(vld._size.x, vld._size.y));
     }
 
     return vl._samplesSlice;
 }
 
 void SparseFeaturesChunk::activate(ComputeSystem &cs, std::mt19937 &rng) {
+    OGMA_METRIC_SCOPE(cs, "sfc.activate");
+
     cl::array<cl::size_type, 3> zeroOrigin = { 0, 0, 0 };
     cl::array<cl::size_type, 3> hiddenRegion = { static_cast<cl_uint>(_hiddenSize.x), static_cast<cl_uint>(_hiddenSize.y), 1 };
 
@@ -211,10 +217,12 @@ void SparseFeaturesChunk::activate(ComputeSystem &cs, std::mt19937 &rng) {
         _stimulusKernel.setArg(argIndex++, vld._numSamples);
         _stimulusKernel.setArg(argIndex++, vld._ignoreMiddle);
 
-        cs.getQueue().enqueueNDRangeKernel(_stimulusKernel, cl::NullRange, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
+        cs.enqueueKernel(_stimulusKernel, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
 
         // Swap buffers
         std::swap(_hiddenSummationTemp[_front], _hiddenSummationTemp[_back]);
+
+        OGMA_METRIC_COUNT(cs, "swaps", 1);
     }
 
     // Activate
@@ -225,7 +233,7 @@ void SparseFeaturesChunk::activate(ComputeSystem &cs, std::mt19937 &rng) {
         _activateKernel.setArg(argIndex++, _hiddenStates[_back]);
         _activateKernel.setArg(argIndex++, _hiddenActivations[_front]);
 
-        cs.getQueue().enqueueNDRangeKernel(_activateKernel, cl::NullRange, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
+        cs.enqueueKernel(_activateKernel, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
     }
 
     // Inhibit
@@ -241,7 +249,7 @@ void SparseFeaturesChunk::activate(ComputeSystem &cs, std::mt19937 &rng) {
         _inhibitKernel.setArg(argIndex++, _hiddenSize);
         _inhibitKernel.setArg(argIndex++, _chunkSize);
 
-        cs.getQueue().enqueueNDRangeKernel(_inhibitKernel, cl::NullRange, cl::NDRange(chunksInX, chunksInY));
+        cs.enqueueKernel(_inhibitKernel, cl::NDRange(chunksInX, chunksInY));
     }
 }
 
@@ -259,9 +267,13 @@ void SparseFeaturesChunk::stepEnd(ComputeSystem &cs) {
 
         std::swap(vl._samples[_front], vl._samples[_back]);
     }
+
+    OGMA_METRIC_COUNT(cs, "swaps", 3 + _visibleLayers.size());
 }
 
 void SparseFeaturesChunk::learn(ComputeSystem &cs, std::mt19937 &rng) {
+    OGMA_METRIC_SCOPE(cs, "sfc.learn");
+
     // Learn weights
     for (int vli = 0; vli < _visibleLayers.size(); vli++) {
         VisibleLayer &vl = _visibleLayers[vli];
@@ -285,10 +297,14 @@ void SparseFeaturesChunk::learn(ComputeSystem &cs, std::mt19937 &rng) {
             _learnWeightsKernel.setArg(argIndex++, vld._numSamples);
             _learnWeightsKernel.setArg(argIndex++, _gamma);
 
-            cs.getQueue().enqueueNDRangeKernel(_learnWeightsKernel, cl::NullRange, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
+            cs.enqueueKernel(_learnWeightsKernel, cl::NDRange(_hiddenSize.x, _hiddenSize.y));
         }
 
         std::swap(vl._weights[_front], vl._weights[_back]);
+
+        OGMA_METRIC_COUNT(cs, "swaps", 1);
+
+        vl._weightsChanged = true;
     }
 }
 
@@ -304,7 +320,7 @@ void SparseFeaturesChunk::inhibit(ComputeSystem &cs, const cl::Image2D &activati
     _inhibitOtherKernel.setArg(argIndex++, _hiddenSize);
     _inhibitOtherKernel.setArg(argIndex++, _chunkSize);
 
-    cs.getQueue().enqueueNDRangeKernel(_inhibitOtherKernel, cl::NullRange, cl::NDRange(chunksInX, chunksInY));
+    cs.enqueueKernel(_inhibitOtherKernel, cl::NDRange(chunksInX, chunksInY));
 }
 
 void SparseFeaturesChunk::clearMemory(ComputeSystem &cs) {
@@ -331,6 +347,79 @@ void SparseFeaturesChunk::clearMemory(ComputeSystem &cs) {
     }
 }
 
+std::shared_ptr<SparseFeatures> SparseFeaturesChunk::clone(ComputeSystem &cs) const {
+    // Copies all parameters and descs, then replaces the (shared) images and kernels
+    std::shared_ptr<SparseFeaturesChunk> sf = std::make_shared<SparseFeaturesChunk>(*this);
+
+    for (VisibleLayer &vl : sf->_visibleLayers) {
+        vl._derivedInputs = ogmaneo::copy(vl._derivedInputs, cs);
+        vl._samples = ogmaneo::copy(vl._samples, cs);
+        vl._samplesAccum = ogmaneo::copy(vl._samplesAccum, cs);
+        vl._samplesSlice = ogmaneo::copy(vl._samplesSlice, cs);
+        vl._weights = ogmaneo::copy(vl._weights, cs);
+    }
+
+    sf->_hiddenStates = ogmaneo::copy(_hiddenStates, cs);
+    sf->_hiddenActivations = ogmaneo::copy(_hiddenActivations, cs);
+    sf->_chunkWinners = ogmaneo::copy(_chunkWinners, cs);
+    sf->_hiddenSummationTemp = ogmaneo::copy(_hiddenSummationTemp, cs);
+
+    sf->_addSampleKernel = ogmaneo::copy(_addSampleKernel);
+    sf->_stimulusKernel = ogmaneo::copy(_stimulusKernel);
+    sf->_activateKernel = ogmaneo::copy(_activateKernel);
+    sf->_inhibitKernel = ogmaneo::copy(_inhibitKernel);
+    sf->_inhibitOtherKernel = ogmaneo::copy(_inhibitOtherKernel);
+    sf->_learnWeightsKernel = ogmaneo::copy(_learnWeightsKernel);
+    sf->_deriveInputsKernel = ogmaneo::copy(_deriveInputsKernel);
+    sf->_sumKernel = ogmaneo::copy(_sumKernel);
+    sf->_sliceKernel = ogmaneo::copy(_sliceKernel);
+
+    return sf;
+}
+
+MemoryUsage SparseFeaturesChunk::getMemoryUsage() const {
+    MemoryUsage usage;
+
+    for (const VisibleLayer &vl : _visibleLayers) {
+        addMemory(usage, _memoryWeights, vl._weights);
+        addMemory(usage, _memorySamples, vl._derivedInputs);
+        addMemory(usage, _memorySamples, vl._samples);
+        addMemory(usage, _memorySamples, vl._samplesAccum);
+        addMemory(usage, _memoryTemps, vl._samplesSlice);
+    }
+
+    addMemory(usage, _memoryStates, _hiddenStates);
+    addMemory(usage, _memoryStates, _hiddenActivations);
+    addMemory(usage, _memoryStates, _chunkWinners);
+    addMemory(usage, _memoryTemps, _hiddenSummationTemp);
+
+    return usage;
+}
+
+MemoryUsage SparseFeaturesChunk::SparseFeaturesChunkDesc::estimateMemory() const {
+    // Mirrors the allocations of the SparseFeaturesChunk constructor
+    MemoryUsage usage;
+
+    int chunksInX = static_cast<int>(std::ceil(static_cast<float>(_hiddenSize.x) / static_cast<float>(_chunkSize.x)));
+    int chunksInY = static_cast<int>(std::ceil(static_cast<float>(_hiddenSize.y) / static_cast<float>(_chunkSize.y)));
+
+    for (const VisibleLayerDesc &vld : _visibleLayerDescs) {
+        int weightDiam = vld._radius * 2 + 1;
+
+        usage.add(_memoryWeights, imageBytes({ _hiddenSize.x, _hiddenSize.y, weightDiam * weightDiam * vld._numSamples }, 1), 2);
+        usage.add(_memorySamples, imageBytes({ vld._size.x, vld._size.y, 1 }, 2), 2);
+        usage.add(_memorySamples, imageBytes({ vld._size.x, vld._size.y, vld._numSamples }, 1), 4);
+        usage.add(_memoryTemps, imageBytes({ vld._size.x, vld._size.y, 1 }, 1));
+    }
+
+    usage.add(_memoryStates, imageBytes({ _hiddenSize.x, _hiddenSize.y, 1 }, 1), 2);
+    usage.add(_memoryStates, imageBytes({ _hiddenSize.x, _hiddenSize.y, 1 }, 1), 2);
+    usage.add(_memoryStates, imageBytes({ chunksInX, chunksInY, 1 }, 2), 2);
+    usage.add(_memoryTemps, imageBytes({ _hiddenSize.x, _hiddenSize.y, 1 }, 1), 2);
+
+    return usage;
+}
+
 void SparseFeaturesChunk::VisibleLayerDesc::load(const schemas::VisibleChunkLayerDesc* fbVisibleChunkLayerDesc, ComputeSystem &cs) {
     _size = cl_int2{ fbVisibleChunkLayerDesc->_size().x(), fbVisibleChunkLayerDesc->_size().y() };
     _numSamples = fbVisibleChunkLayerDesc->_numSamples();
@@ -345,24 +434,24 @@ schemas::VisibleChunkLayerDesc SparseFeaturesChunk::VisibleLayerDesc::save(flatb
     return schemas::VisibleChunkLayerDesc(size, _numSamples, _radius, _ignoreMiddle, _weightAlpha, _lambda);
 }
 
-void SparseFeaturesChunk::VisibleLayer::load(const schemas::VisibleChunkLayer* fbVisibleChunkLayer, ComputeSystem &cs) {
-    ogmaneo::load(_samples, fbVisibleChunkLayer->_samples(), cs);
-    ogmaneo::load(_samplesAccum, fbVisibleChunkLayer->_samplesAccum(), cs);
-    ogmaneo::load(_weights, fbVisibleChunkLayer->_weights(), cs);
+void SparseFeaturesChunk::VisibleLayer::load(const schemas::VisibleChunkLayer* fbVisibleChunkLayer, ComputeSystem &cs, CheckpointReader* reader) {
+    ogmaneo::load(_samples, fbVisibleChunkLayer->_samples(), cs, reader);
+    ogmaneo::load(_samplesAccum, fbVisibleChunkLayer->_samplesAccum(), cs, reader);
+    ogmaneo::load(_weights, fbVisibleChunkLayer->_weights(), cs, reader);
     _hiddenToVisible = cl_float2{ fbVisibleChunkLayer->_hiddenToVisible()->x(), fbVisibleChunkLayer->_hiddenToVisible()->y() };
     _visibleToHidden = cl_float2{ fbVisibleChunkLayer->_visibleToHidden()->x(), fbVisibleChunkLayer->_visibleToHidden()->y() };
     _reverseRadii = cl_int2{ fbVisibleChunkLayer->_reverseRadii()->x(), fbVisibleChunkLayer->_reverseRadii()->y() };
 }
 
-flatbuffers::Offset<schemas::VisibleChunkLayer> SparseFeaturesChunk::VisibleLayer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::VisibleChunkLayer> SparseFeaturesChunk::VisibleLayer::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
     schemas::float2 hiddenToVisible(_hiddenToVisible.x, _hiddenToVisible.y);
     schemas::float2 visibleToHidden(_visibleToHidden.x, _visibleToHidden.y);
     schemas::int2 reverseRadii(_reverseRadii.x, _reverseRadii.y);
 
     return schemas::CreateVisibleChunkLayer(builder,
-        ogmaneo::save(_samples, builder, cs),
-        ogmaneo::save(_samplesAccum, builder, cs),
-        ogmaneo::save(_weights, builder, cs),
+        ogmaneo::save(_samples, builder, cs, writer, _learning),
+        ogmaneo::save(_samplesAccum, builder, cs, writer),
+        ogmaneo::saveWeights(_weights, builder, cs, writer, _weightsChanged),
         &hiddenToVisible, &visibleToHidden, &reverseRadii);
 }
 
@@ -396,7 +485,7 @@ flatbuffers::Offset<schemas::SparseFeaturesChunkDesc> SparseFeaturesChunk::Spars
         &initWeightRange, builder.CreateVectorOfStructs(visibleLayerDescs));
 }
 
-void SparseFeaturesChunk::load(const schemas::SparseFeatures* fbSparseFeatures, ComputeSystem &cs) {
+void SparseFeaturesChunk::load(const schemas::SparseFeatures* fbSparseFeatures, ComputeSystem &cs, CheckpointReader* reader) {
     assert(fbSparseFeatures->_sf_type() == schemas::SparseFeaturesType::SparseFeaturesType_SparseFeaturesChunk);
     schemas::SparseFeaturesChunk* fbSparseFeaturesChunk =
         (schemas::SparseFeaturesChunk*)(fbSparseFeatures->_sf());
@@ -411,21 +500,21 @@ void SparseFeaturesChunk::load(const schemas::SparseFeatures* fbSparseFeatures,
 
     _gamma = fbSparseFeaturesChunk->_gamma();
 
-    ogmaneo::load(_hiddenStates, fbSparseFeaturesChunk->_hiddenStates(), cs);
-    ogmaneo::load(_hiddenActivations, fbSparseFeaturesChunk->_hiddenActivations(), cs);
-    ogmaneo::load(_chunkWinners, fbSparseFeaturesChunk->_chunkWinners(), cs);
-    ogmaneo::load(_hiddenSummationTemp, fbSparseFeaturesChunk->_hiddenSummationTemp(), cs);
+    ogmaneo::load(_hiddenStates, fbSparseFeaturesChunk->_hiddenStates(), cs, reader);
+    ogmaneo::load(_hiddenActivations, fbSparseFeaturesChunk->_hiddenActivations(), cs, reader);
+    ogmaneo::load(_chunkWinners, fbSparseFeaturesChunk->_chunkWinners(), cs, reader);
+    ogmaneo::load(_hiddenSummationTemp, fbSparseFeaturesChunk->_hiddenSummationTemp(), cs, reader);
 
     for (flatbuffers::uoffset_t i = 0; i < fbSparseFeaturesChunk->_visibleLayerDescs()->Length(); i++) {
         _visibleLayerDescs[i].load(fbSparseFeaturesChunk->_visibleLayerDescs()->Get(i), cs);
     }
 
     for (flatbuffers::uoffset_t i = 0; i < fbSparseFeaturesChunk->_visibleLayers()->Length(); i++) {
-        _visibleLayers[i].load(fbSparseFeaturesChunk->_visibleLayers()->Get(i), cs);
+        _visibleLayers[i].load(fbSparseFeaturesChunk->_visibleLayers()->Get(i), cs, reader);
     }
 }
 
-flatbuffers::Offset<schemas::SparseFeatures> SparseFeaturesChunk::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) {
+flatbuffers::Offset<schemas::SparseFeatures> SparseFeaturesChunk::save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer) {
     schemas::int2 hiddenSize(_hiddenSize.x, _hiddenSize.y);
     schemas::int2 chunkSize(_chunkSize.x, _chunkSize.y);
 
@@ -434,15 +523,15 @@ flatbuffers::Offset<schemas::SparseFeatures> SparseFeaturesChunk::save(flatbuffe
         visibleLayerDescs.push_back(layerDesc.save(builder, cs));
 
     std::vector<flatbuffers::Offset<schemas::VisibleChunkLayer>> visibleLayers;
-    for (VisibleLayer layer : _visibleLayers)
-        visibleLayers.push_back(layer.save(builder, cs));
+    for (VisibleLayer &layer : _visibleLayers)
+        visibleLayers.push_back(layer.save(builder, cs, writer));
 
     flatbuffers::Offset<schemas::SparseFeaturesChunk> sf = schemas::CreateSparseFeaturesChunk(builder,
-        ogmaneo::save(_hiddenStates, builder, cs),
-        ogmaneo::save(_hiddenActivations, builder, cs),
-        ogmaneo::save(_chunkWinners, builder, cs),
+        ogmaneo::save(_hiddenStates, builder, cs, writer),
+        ogmaneo::save(_hiddenActivations, builder, cs, writer),
+        ogmaneo::save(_chunkWinners, builder, cs, writer),
         &hiddenSize, &chunkSize, _gamma,
-        ogmaneo::save(_hiddenSummationTemp, builder, cs),
+        ogmaneo::save(_hiddenSummationTemp, builder, cs, writer, _scratch),
         builder.CreateVectorOfStructs(visibleLayerDescs),
         builder.CreateVector(visibleLayers));
 
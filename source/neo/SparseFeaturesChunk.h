@@ -111,12 +111,21 @@ namespace ogmaneo {
             cl_int2 _reverseRadii;
             //!@}
 
+            /*!
+            \brief Whether the weights were updated since the last base checkpoint (see saveWeights)
+            */
+            bool _weightsChanged;
+
+            VisibleLayer()
+                : _weightsChanged(true)
+            {}
+
             //!@{
             /*!
             \brief Serialization
             */
-            void load(const schemas::VisibleChunkLayer* fbVisibleChunkLayer, ComputeSystem &cs);
-            flatbuffers::Offset<schemas::VisibleChunkLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs);
+            void load(const schemas::VisibleChunkLayer* fbVisibleChunkLayer, ComputeSystem &cs, CheckpointReader* reader = nullptr);
+            flatbuffers::Offset<schemas::VisibleChunkLayer> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr);
             //!@}
         };
 
@@ -171,6 +180,12 @@ namespace ogmaneo {
                 return std::make_shared<SparseFeaturesChunk>(*_cs, *_sfcProgram, _visibleLayerDescs, _hiddenSize, _chunkSize, _gamma, _initWeightRange, _rng);
             }
 
+            std::shared_ptr<SparseFeaturesDesc> clone() const override {
+                return std::make_shared<SparseFeaturesChunkDesc>(*this);
+            }
+
+            MemoryUsage estimateMemory() const override;
+
             //!@{
             /*!
             \brief Serialization
@@ -355,7 +370,7 @@ namespace ogmaneo {
         /*!
         \brief Get hidden chunk winner
         */
-        const DoubleBuffer2D &getChunkWinners() const {
+        const DoubleBuffer2D &getChunkWinners() const override {
             return _chunkWinners;
         }
 
@@ -364,12 +379,22 @@ namespace ogmaneo {
         */
         void clearMemory(ComputeSystem &cs) override;
 
+        /*!
+        \brief Copy with device side copies of all images
+        */
+        std::shared_ptr<SparseFeatures> clone(ComputeSystem &cs) const override;
+
+        /*!
+        \brief Device memory of all images
+        */
+        MemoryUsage getMemoryUsage() const override;
+
         //!@{
         /*!
         \brief Serialization
         */
-        void load(const schemas::SparseFeatures* fbSparseFeatures, ComputeSystem &cs) override;
-        flatbuffers::Offset<schemas::SparseFeatures> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs) override;
+        void load(const schemas::SparseFeatures* fbSparseFeatures, ComputeSystem &cs, CheckpointReader* reader = nullptr) override;
+        flatbuffers::Offset<schemas::SparseFeatures> save(flatbuffers::FlatBufferBuilder &builder, ComputeSystem &cs, CheckpointWriter* writer = nullptr) override;
         //!@}
     };
 }
\ No newline at end of file
@@ -8,10 +8,22 @@
 
 #include "ComputeSystem.h"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace ogmaneo;
 
+namespace {
+    // Profiling counters are unsigned, and not all implementations keep them ordered
+    int64_t elapsedNs(cl_ulong from, cl_ulong to) {
+        return to > from ? static_cast<int64_t>(to - from) : 0;
+    }
+
+    double elapsedMs(cl_ulong from, cl_ulong to) {
+        return elapsedNs(from, to) * 1e-6;
+    }
+}
+
 bool ComputeSystem::create(DeviceType type, int platformIndex, int deviceIndex, bool createFromGLContext) {
     int index;
     std::vector<cl::Platform> allPlatforms;
@@ -149,7 +161,232 @@ bool ComputeSystem::create(DeviceType type, int platformIndex, int deviceIndex,
 #endif
         _context = _device;
 
-    _queue = cl::CommandQueue(_context, _device);
+    _queue = cl::CommandQueue(_context, _device, _profiling ? CL_QUEUE_PROFILING_ENABLE : 0);
 
     return true;
 }
+
+void ComputeSystem::setProfiling(bool enabled) {
+    if (enabled == _profiling)
+        return;
+
+    if (_queue() != nullptr) {
+        _queue.finish();
+
+        std::lock_guard<std::mutex> lock(_profileMutex);
+
+        resolveProfile();
+    }
+
+    _profiling = enabled;
+
+    if (_queue() != nullptr)
+        _queue = cl::CommandQueue(_context, _device, _profiling ? CL_QUEUE_PROFILING_ENABLE : 0);
+}
+
+void ComputeSystem::enqueueKernel(cl::Kernel &kernel, const cl::NDRange &globalRange) {
+    OGMA_METRIC_COUNT(*this, "kernels", 1);
+
+    if (!_profiling)
+        _queue.enqueueNDRangeKernel(kernel, cl::NullRange, globalRange);
+    else
+        enqueueProfiledKernel(kernel, globalRange);
+}
+
+void ComputeSystem::enqueueProfiledKernel(cl::Kernel &kernel, const cl::NDRange &globalRange) {
+    PendingKernel pending;
+
+    _queue.enqueueNDRangeKernel(kernel, cl::NullRange, globalRange, cl::NullRange, nullptr, &pending._event);
+
+    pending._kernel = kernel;
+    pending._scope = _profileScope;
+    pending._layer = _profileLayer;
+    pending._hostQueued = _tracing ? Tracer::now() : 0;
+
+    std::lock_guard<std::mutex> lock(_profileMutex);
+
+    _profilePending.push_back(pending);
+}
+
+void ComputeSystem::resolveProfile() {
+    if (_profilePending.empty())
+        return;
+
+    for (PendingKernel &pending : _profilePending) {
+        pending._event.wait();
+
+        KernelTiming timing;
+
+        timing._kernel = pending._kernel.getInfo<CL_KERNEL_FUNCTION_NAME>();
+        timing._scope = pending._scope != nullptr ? pending._scope : "";
+        timing._layer = pending._layer;
+        timing._step = _profileStep;
+        timing._queued = pending._event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+        timing._submit = pending._event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+        timing._start = pending._event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        timing._end = pending._event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+        // Function names may keep their terminator
+        while (!timing._kernel.empty() && timing._kernel.back() == '\0')
+            timing._kernel.pop_back();
+
+        double executionMs = elapsedMs(timing._start, timing._end);
+
+        std::vector<KernelStats>::iterator it = std::find_if(_profileStats.begin(), _profileStats.end(), [&timing](const KernelStats &stats) {
+            return stats._layer == timing._layer && stats._kernel == timing._kernel && stats._scope == timing._scope;
+        });
+
+        if (it == _profileStats.end()) {
+            KernelStats stats;
+
+            stats._kernel = timing._kernel;
+            stats._scope = timing._scope;
+            stats._layer = timing._layer;
+            stats._count = 0;
+            stats._totalMs = 0.0;
+            stats._minMs = executionMs;
+            stats._maxMs = executionMs;
+            stats._queuedMs = 0.0;
+            stats._waitMs = 0.0;
+
+            _profileStats.push_back(stats);
+
+            it = _profileStats.end() - 1;
+        }
+
+        it->_count++;
+        it->_totalMs += executionMs;
+        it->_minMs = std::min(it->_minMs, executionMs);
+        it->_maxMs = std::max(it->_maxMs, executionMs);
+        it->_queuedMs += elapsedMs(timing._queued, timing._submit);
+        it->_waitMs += elapsedMs(timing._submit, timing._start);
+
+        _profileStepTimings.push_back(timing);
+
+        // The device clock is not the host clock, offset from the host time of the enqueue
+        if (_tracing) {
+            _tracer->addEvent(pending._scope != nullptr ? pending._scope : "kernel", timing._kernel, Tracer::_deviceTrack, timing._layer,
+                pending._hostQueued + elapsedNs(timing._queued, timing._start), elapsedNs(timing._start, timing._end));
+        }
+    }
+
+    _profilePending.clear();
+}
+
+void ComputeSystem::beginProfileStep() {
+    std::lock_guard<std::mutex> lock(_profileMutex);
+
+    resolveProfile();
+
+    _profileStepTimings.clear();
+
+    _profileStep++;
+}
+
+std::vector<KernelTiming> ComputeSystem::getProfileStepTimings() {
+    std::lock_guard<std::mutex> lock(_profileMutex);
+
+    resolveProfile();
+
+    return _profileStepTimings;
+}
+
+std::vector<KernelStats> ComputeSystem::getProfileStats() {
+    std::lock_guard<std::mutex> lock(_profileMutex);
+
+    resolveProfile();
+
+    return _profileStats;
+}
+
+void ComputeSystem::countTransfer(TransferDirection direction, const char* site, size_t bytes) {
+    std::lock_guard<std::mutex> lock(_transfersMutex);
+
+    // Only a handful of call sites
+    for (TransferStats &stats : _transfers) {
+        if (stats._direction == direction && stats._site == site) {
+            stats._bytes += bytes;
+            stats._calls++;
+
+            return;
+        }
+    }
+
+    TransferStats stats;
+
+    stats._site = site;
+    stats._direction = direction;
+    stats._bytes = bytes;
+    stats._calls = 1;
+
+    _transfers.push_back(stats);
+}
+
+std::vector<TransferStats> ComputeSystem::getTransferStats() {
+    std::lock_guard<std::mutex> lock(_transfersMutex);
+
+    return _transfers;
+}
+
+void ComputeSystem::resetTransferStats() {
+    std::lock_guard<std::mutex> lock(_transfersMutex);
+
+    _transfers.clear();
+}
+
+void ComputeSystem::startTrace(size_t capacity) {
+    if (_tracing)
+        stopTrace();
+
+    _profilingBeforeTrace = _profiling;
+
+    setProfiling(true);
+
+    std::lock_guard<std::mutex> lock(_profileMutex);
+
+    // Kernels enqueued before have no host time
+    resolveProfile();
+
+    _tracer.reset(new Tracer(capacity));
+
+    _tracing = true;
+}
+
+void ComputeSystem::stopTrace() {
+    if (!_tracing)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_profileMutex);
+
+        resolveProfile();
+
+        _tracing = false;
+    }
+
+    setProfiling(_profilingBeforeTrace);
+}
+
+bool ComputeSystem::saveTrace(const std::string &fileName) {
+    if (_tracer == nullptr)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(_profileMutex);
+
+        resolveProfile();
+    }
+
+    // The tracer has its own lock, stepping is not held up by the write
+    return _tracer->save(fileName);
+}
+
+void ComputeSystem::resetProfile() {
+    std::lock_guard<std::mutex> lock(_profileMutex);
+
+    resolveProfile();
+
+    _profileStepTimings.clear();
+    _profileStats.clear();
+    _profileStep = 0;
+}
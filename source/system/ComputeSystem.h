@@ -9,6 +9,13 @@
 #pragma once
 
 #include <system/Uncopyable.h>
+#include <system/Tracer.h>
+#include <system/Metrics.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 //#define CL_HPP_MINIMUM_OPENCL_VERSION 200
 //#define CL_HPP_TARGET_OPENCL_VERSION 200
@@ -26,6 +33,91 @@
 #define SYS_ALLOW_CL_GL_CONTEXT 0
 
 namespace ogmaneo {
+    /*!
+    \brief Timing of a single profiled kernel launch (see ComputeSystem::setProfiling)
+    Times are device nanoseconds from the OpenCL profiling events, only differences between them are meaningful.
+    */
+    struct KernelTiming {
+        std::string _kernel;
+
+        /*!
+        \brief Part of the hierarchy that enqueued the kernel ("encoder", "predictor"), empty outside of layers
+        */
+        std::string _scope;
+
+        /*!
+        \brief Layer index, -1 outside of layers
+        */
+        int _layer;
+
+        /*!
+        \brief Profiling step the kernel was enqueued in (see beginProfileStep)
+        */
+        int _step;
+
+        //!@{
+        /*!
+        \brief CL_PROFILING_COMMAND_QUEUED, _SUBMIT, _START and _END
+        */
+        cl_ulong _queued;
+        cl_ulong _submit;
+        cl_ulong _start;
+        cl_ulong _end;
+        //!@}
+    };
+
+    /*!
+    \brief Timings of a kernel aggregated over all its launches by the same scope and layer
+    */
+    struct KernelStats {
+        std::string _kernel;
+        std::string _scope;
+        int _layer;
+
+        int _count;
+
+        //!@{
+        /*!
+        \brief Execution time (start to end)
+        */
+        double _totalMs;
+        double _minMs;
+        double _maxMs;
+        //!@}
+
+        /*!
+        \brief Total time spent queued on the host (queued to submit)
+        */
+        double _queuedMs;
+
+        /*!
+        \brief Total time spent waiting on the device (submit to start)
+        */
+        double _waitMs;
+    };
+
+    /*!
+    \brief Direction of a host/device transfer
+    */
+    enum TransferDirection {
+        _hostToDevice, _deviceToHost
+    };
+
+    /*!
+    \brief Bytes and number of transfers between host and device, for one call site and direction
+    */
+    struct TransferStats {
+        /*!
+        \brief Call site ("inputFeed", "predictions", "load", ...)
+        */
+        std::string _site;
+
+        TransferDirection _direction;
+
+        size_t _bytes;
+        size_t _calls;
+    };
+
     /*!
     \brief Compute system
     Holds OpenCL platform, device, context, and command queue
@@ -50,7 +142,71 @@ namespace ogmaneo {
         cl::CommandQueue _queue;
         //!@}
 
+        /*!
+        \brief Kernel launch whose profiling information is not read yet
+        */
+        struct PendingKernel {
+            cl::Event _event;
+            cl::Kernel _kernel;
+            const char* _scope;
+            int _layer;
+
+            /*!
+            \brief Host time of the enqueue, to place the kernel on the host timeline of traces
+            */
+            int64_t _hostQueued;
+        };
+
+        //!@{
+        /*!
+        \brief Profiling state (see setProfiling)
+        The step, pending launches, timings and stats are guarded by _profileMutex, they may be read from other threads (saveTrace, stats).
+        */
+        bool _profiling;
+        const char* _profileScope;
+        int _profileLayer;
+        int _profileStep;
+        std::vector<PendingKernel> _profilePending;
+        std::vector<KernelTiming> _profileStepTimings;
+        std::vector<KernelStats> _profileStats;
+        std::mutex _profileMutex;
+        //!@}
+
+        //!@{
+        /*!
+        \brief Transfer counters (see countTransfer), transfers may be counted from other threads (checkpoints)
+        */
+        std::vector<TransferStats> _transfers;
+        std::mutex _transfersMutex;
+        //!@}
+
+        //!@{
+        /*!
+        \brief Tracing state (see startTrace), the tracer is kept after stopTrace so it can still be saved
+        */
+        std::unique_ptr<Tracer> _tracer;
+        bool _tracing;
+        bool _profilingBeforeTrace;
+        //!@}
+
+        /*!
+        \brief Receiver of the hot path metrics (see setMetricsSink), nullptr if none
+        */
+        std::shared_ptr<MetricsSink> _metricsSink;
+
+        /*!
+        \brief Read back the profiling information of pending launches, into the step timings and stats
+        Call with _profileMutex held.
+        */
+        void resolveProfile();
+
+        void enqueueProfiledKernel(cl::Kernel &kernel, const cl::NDRange &globalRange);
+
     public:
+        ComputeSystem()
+            : _profiling(false), _profileScope(nullptr), _profileLayer(-1), _profileStep(0), _tracing(false), _profilingBeforeTrace(false)
+        {}
+
         /*!
         \brief Create an OpenCL compute system with a given device type.
         Optional: Create from a platform index, device index, and an OpenGL context
@@ -85,5 +241,131 @@ namespace ogmaneo {
         cl::CommandQueue &getQueue() {
             return _queue;
         }
+
+        /*!
+        \brief Enqueue a kernel on the queue, recording its timing if profiling
+        All kernels of the neo layers go through here. When profiling is disabled this is a plain enqueue.
+        Defined in ComputeSystem.cpp, so that the instrumentation only depends on how the library was built.
+        */
+        void enqueueKernel(cl::Kernel &kernel, const cl::NDRange &globalRange);
+
+        /*!
+        \brief Enable or disable per kernel profiling
+        Profiling needs a queue created with CL_QUEUE_PROFILING_ENABLE, so the queue is finished and recreated.
+        Only call this between steps. Disabled by default.
+        */
+        void setProfiling(bool enabled);
+
+        /*!
+        \brief Whether per kernel profiling is enabled
+        */
+        bool isProfiling() const {
+            return _profiling;
+        }
+
+        /*!
+        \brief Tag the kernels enqueued from here on with a scope and layer index
+        \param scope static string (not copied), nullptr outside of layers.
+        */
+        void setProfileTag(const char* scope, int layer) {
+            _profileScope = scope;
+            _profileLayer = layer;
+        }
+
+        //!@{
+        /*!
+        \brief Current profile tag (see setProfileTag)
+        */
+        const char* getProfileScope() const {
+            return _profileScope;
+        }
+
+        int getProfileLayer() const {
+            return _profileLayer;
+        }
+        //!@}
+
+        /*!
+        \brief Start a new profiling step, the timings of the previous step are added to the stats and cleared
+        */
+        void beginProfileStep();
+
+        /*!
+        \brief Timings of the kernels enqueued since the current step began (waits for them to complete)
+        Thread safe, like getProfileStats and resetProfile.
+        */
+        std::vector<KernelTiming> getProfileStepTimings();
+
+        /*!
+        \brief Timings aggregated by kernel, scope and layer since profiling was enabled or reset (waits for pending kernels)
+        */
+        std::vector<KernelStats> getProfileStats();
+
+        /*!
+        \brief Clear the step timings and aggregated stats
+        */
+        void resetProfile();
+
+        /*!
+        \brief Count a transfer between host and device, done by the caller
+        All host/device reads and writes of the neo layers are counted. Device to device copies are not.
+        \param site static string naming the call site.
+        */
+        void countTransfer(TransferDirection direction, const char* site, size_t bytes);
+
+        /*!
+        \brief Transfer counters per call site and direction, since creation or the last reset
+        */
+        std::vector<TransferStats> getTransferStats();
+
+        /*!
+        \brief Clear the transfer counters
+        */
+        void resetTransferStats();
+
+        /*!
+        \brief Start recording a trace of host spans and device kernel intervals, into a ring buffer (see Tracer)
+        Enables profiling (see setProfiling) while tracing, so only call this between steps like setProfiling.
+        Device intervals are added as profiling steps are resolved.
+        \param capacity maximum number of events kept, older ones are overwritten.
+        */
+        void startTrace(size_t capacity = 65536);
+
+        /*!
+        \brief Stop recording, the recorded events are kept until the next startTrace
+        Restores the profiling setting, so only call this between steps like setProfiling.
+        */
+        void stopTrace();
+
+        /*!
+        \brief Tracer to record host spans into, nullptr if not tracing
+        */
+        Tracer* getTracer() {
+            return _tracing ? _tracer.get() : nullptr;
+        }
+
+        /*!
+        \brief Save the recorded trace as Chrome trace JSON (waits for pending kernels)
+        Thread safe, may be called while another thread steps.
+        \return false if nothing was traced or the file could not be written.
+        */
+        bool saveTrace(const std::string &fileName);
+
+        /*!
+        \brief Report the hot path metrics of the neo layers to a sink (see Metrics.h), nullptr to stop
+        Calls, host times, enqueued kernels, buffer swaps and layers skipped between clock resets are reported,
+        tagged with the profile scope and layer. Only built with the OGMANEO_INSTRUMENTATION CMake option, otherwise nothing is reported.
+        Set between steps, the sink is called from the stepping thread.
+        */
+        void setMetricsSink(const std::shared_ptr<MetricsSink> &sink) {
+            _metricsSink = sink;
+        }
+
+        /*!
+        \brief Sink of the hot path metrics, nullptr if none
+        */
+        MetricsSink* getMetricsSink() const {
+            return _metricsSink.get();
+        }
     };
 }
\ No newline at end of file
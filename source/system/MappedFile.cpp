@@ -0,0 +1,158 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#include "MappedFile.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#if defined _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace ogmaneo;
+
+MappedFile::MappedFile()
+    : _data(nullptr), _size(0),
+#if defined _WIN32
+    _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+#else
+    _fd(-1)
+#endif
+{}
+
+bool MappedFile::open(const std::string &fileName) {
+    close();
+
+#if defined _WIN32
+    _file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (_file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER size;
+
+        if (GetFileSizeEx(_file, &size) && size.QuadPart > 0) {
+            _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+            if (_mapping != nullptr) {
+                _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+
+                if (_data != nullptr) {
+                    _size = static_cast<size_t>(size.QuadPart);
+
+                    return true;
+                }
+            }
+        }
+
+        close();
+    }
+#else
+    _fd = ::open(fileName.c_str(), O_RDONLY);
+
+    if (_fd != -1) {
+        struct stat st;
+
+        if (fstat(_fd, &st) == 0 && st.st_size > 0) {
+            void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, _fd, 0);
+
+            if (mapped != MAP_FAILED) {
+                // Pages are consumed front to back by the uploads
+                madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+                _data = static_cast<const uint8_t*>(mapped);
+                _size = static_cast<size_t>(st.st_size);
+
+                return true;
+            }
+        }
+
+        close();
+    }
+#endif
+
+    // Fall back to reading the whole file
+    FILE* file = fopen(fileName.c_str(), "rb");
+
+    if (file == nullptr)
+        return false;
+
+    fseek(file, 0L, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    if (length <= 0) {
+        fclose(file);
+        return false;
+    }
+
+    _buffer.resize(static_cast<size_t>(length));
+    size_t read = fread(_buffer.data(), sizeof(uint8_t), _buffer.size(), file);
+    fclose(file);
+
+    if (read != _buffer.size()) {
+        _buffer.clear();
+        return false;
+    }
+
+    _data = _buffer.data();
+    _size = _buffer.size();
+
+    return true;
+}
+
+void MappedFile::prefetch(const uint8_t* data, size_t size) const {
+#if !defined _WIN32
+    if (_data == nullptr || !_buffer.empty() || data < _data || size == 0)
+        return;
+
+    // madvise needs a page aligned start
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = (static_cast<size_t>(data - _data) / pageSize) * pageSize;
+    size_t end = std::min(static_cast<size_t>(data - _data) + size, _size);
+
+    if (begin < end)
+        madvise(const_cast<uint8_t*>(_data) + begin, end - begin, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::close() {
+#if defined _WIN32
+    if (_data != nullptr && _buffer.empty())
+        UnmapViewOfFile(_data);
+
+    if (_mapping != nullptr)
+        CloseHandle(_mapping);
+
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+#else
+    if (_data != nullptr && _buffer.empty())
+        munmap(const_cast<uint8_t*>(_data), _size);
+
+    if (_fd != -1)
+        ::close(_fd);
+
+    _fd = -1;
+#endif
+
+    _buffer.clear();
+    _buffer.shrink_to_fit();
+
+    _data = nullptr;
+    _size = 0;
+}
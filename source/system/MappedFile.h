@@ -0,0 +1,76 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <system/Uncopyable.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ogmaneo {
+    /*!
+    \brief Read only memory mapped file
+    Maps a whole file into the address space so it can be used in place (no read into a heap copy).
+    Falls back to reading the file into memory on platforms without mapping support.
+    */
+    class MappedFile : private Uncopyable {
+    private:
+        const uint8_t* _data;
+        size_t _size;
+
+#if defined _WIN32
+        void* _file;
+        void* _mapping;
+#else
+        int _fd;
+#endif
+
+        /*!
+        \brief Fallback storage when the file could not be mapped
+        */
+        std::vector<uint8_t> _buffer;
+
+    public:
+        MappedFile();
+
+        ~MappedFile() {
+            close();
+        }
+
+        /*!
+        \brief Map a file, returns false if it could not be opened
+        */
+        bool open(const std::string &fileName);
+
+        /*!
+        \brief Unmap (invalidates data())
+        */
+        void close();
+
+        /*!
+        \brief Hint that a range of the file will be read soon, so it is read ahead (no-op if not supported)
+        */
+        void prefetch(const uint8_t* data, size_t size) const;
+
+        /*!
+        \brief Start of the mapped file (nullptr if not open)
+        */
+        const uint8_t* data() const {
+            return _data;
+        }
+
+        /*!
+        \brief Size of the mapped file in bytes
+        */
+        size_t size() const {
+            return _size;
+        }
+    };
+}
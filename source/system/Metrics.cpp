@@ -0,0 +1,81 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#include "Metrics.h"
+
+#include <algorithm>
+
+using namespace ogmaneo;
+
+MetricStats &MetricsAggregator::find(const char* name, const char* scope, int layer, bool timed) {
+    Key key(name, scope, layer);
+
+    std::unordered_map<Key, size_t, KeyHash>::const_iterator it = _indices.find(key);
+
+    if (it != _indices.end())
+        return _metrics[it->second];
+
+    // First time at these addresses, the same strings may have been seen at others (literals of other translation units)
+    std::string scopeName = scope != nullptr ? scope : "";
+
+    size_t index = 0;
+
+    while (index < _metrics.size() && !(_metrics[index]._name == name && _metrics[index]._scope == scopeName && _metrics[index]._layer == layer))
+        index++;
+
+    if (index == _metrics.size()) {
+        MetricStats stats;
+
+        stats._name = name;
+        stats._scope = scopeName;
+        stats._layer = layer;
+        stats._timed = timed;
+        stats._count = 0;
+        stats._totalMs = 0.0;
+        stats._minMs = 0.0;
+        stats._maxMs = 0.0;
+
+        _metrics.push_back(stats);
+    }
+
+    _indices[key] = index;
+
+    return _metrics[index];
+}
+
+void MetricsAggregator::count(const char* name, const char* scope, int layer, uint64_t n) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    find(name, scope, layer, false)._count += n;
+}
+
+void MetricsAggregator::time(const char* name, const char* scope, int layer, int64_t ns) {
+    double ms = ns * 1e-6;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    MetricStats &stats = find(name, scope, layer, true);
+
+    stats._minMs = stats._count == 0 ? ms : std::min(stats._minMs, ms);
+    stats._maxMs = stats._count == 0 ? ms : std::max(stats._maxMs, ms);
+    stats._totalMs += ms;
+    stats._count++;
+}
+
+std::vector<MetricStats> MetricsAggregator::getMetrics() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _metrics;
+}
+
+void MetricsAggregator::reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _metrics.clear();
+    _indices.clear();
+}
@@ -0,0 +1,169 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <system/Uncopyable.h>
+#include <system/Tracer.h>
+
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace ogmaneo {
+    /*!
+    \brief Receives the hot path metrics of the neo layers (see ComputeSystem::setMetricsSink)
+    Called from the stepping thread, once per timed call or counted event, so implementations should be cheap.
+    All strings are static (not copied by the caller), scope is nullptr and layer -1 outside of layers.
+    */
+    class MetricsSink {
+    public:
+        virtual ~MetricsSink() {}
+
+        /*!
+        \brief Add n to a counter ("kernels", "swaps", "skips")
+        */
+        virtual void count(const char* name, const char* scope, int layer, uint64_t n) = 0;
+
+        /*!
+        \brief One call of a timed function ("sfc.activate", "pl.learn", ...), in host nanoseconds
+        */
+        virtual void time(const char* name, const char* scope, int layer, int64_t ns) = 0;
+    };
+
+    /*!
+    \brief A counter or timer aggregated per scope and layer (see MetricsAggregator)
+    */
+    struct MetricStats {
+        std::string _name;
+        std::string _scope;
+        int _layer;
+
+        /*!
+        \brief Whether this is a timer (calls and times) or a counter (sum only)
+        */
+        bool _timed;
+
+        /*!
+        \brief Number of calls of a timer, or sum of a counter
+        */
+        uint64_t _count;
+
+        //!@{
+        /*!
+        \brief Host time of the calls of a timer, 0 for counters
+        */
+        double _totalMs;
+        double _minMs;
+        double _maxMs;
+        //!@}
+    };
+
+    /*!
+    \brief Sink keeping running totals in memory, thread safe
+    Totals are looked up by the addresses of the static strings, so recording does not allocate once every metric was seen.
+    */
+    class MetricsAggregator : public MetricsSink, private Uncopyable {
+    private:
+        typedef std::tuple<const char*, const char*, int> Key;
+
+        struct KeyHash {
+            size_t operator()(const Key &key) const {
+                return std::hash<const void*>()(std::get<0>(key)) ^ (std::hash<const void*>()(std::get<1>(key)) * 31) ^ (static_cast<size_t>(std::get<2>(key)) * 131);
+            }
+        };
+
+        std::vector<MetricStats> _metrics;
+
+        /*!
+        \brief Index into _metrics, equal strings at different addresses share an entry
+        */
+        std::unordered_map<Key, size_t, KeyHash> _indices;
+
+        mutable std::mutex _mutex;
+
+        MetricStats &find(const char* name, const char* scope, int layer, bool timed);
+
+    public:
+        MetricsAggregator() {}
+
+        void count(const char* name, const char* scope, int layer, uint64_t n) override;
+        void time(const char* name, const char* scope, int layer, int64_t ns) override;
+
+        /*!
+        \brief Totals since creation or the last reset, in order of first occurrence
+        */
+        std::vector<MetricStats> getMetrics() const;
+
+        /*!
+        \brief Clear all totals
+        */
+        void reset();
+    };
+
+    /*!
+    \brief Times a call from construction to destruction, does nothing if sink is nullptr
+    */
+    class MetricScope : private Uncopyable {
+    private:
+        MetricsSink* _sink;
+        const char* _name;
+        const char* _scope;
+        int _layer;
+        int64_t _start;
+
+    public:
+        /*!
+        \param name, scope static strings (not copied).
+        */
+        MetricScope(MetricsSink* sink, const char* name, const char* scope, int layer)
+            : _sink(sink), _name(name), _scope(scope), _layer(layer), _start(0)
+        {
+            if (_sink != nullptr)
+                _start = Tracer::now();
+        }
+
+        ~MetricScope() {
+            if (_sink != nullptr)
+                _sink->time(_name, _scope, _layer, Tracer::now() - _start);
+        }
+    };
+}
+
+/*!
+\brief Hot path instrumentation of the neo layers, compiled in with the OGMANEO_INSTRUMENTATION CMake option
+The macros read the sink of a ComputeSystem, and tag metrics with its current profile scope and layer (see setProfileTag).
+Without a sink they cost a pointer test. When compiled out they expand to nothing, so the neo layers are unchanged.
+*/
+#ifdef OGMANEO_INSTRUMENTATION
+#define OGMA_METRIC_CONCAT_INNER(a, b) a##b
+#define OGMA_METRIC_CONCAT(a, b) OGMA_METRIC_CONCAT_INNER(a, b)
+
+//! Time the rest of the enclosing block under name
+#define OGMA_METRIC_SCOPE(cs, name) \
+    ogmaneo::MetricScope OGMA_METRIC_CONCAT(_metricScope, __LINE__)((cs).getMetricsSink(), name, (cs).getProfileScope(), (cs).getProfileLayer())
+
+//! Add n to counter name of the given scope and layer
+#define OGMA_METRIC_COUNT_AT(cs, name, scope, layer, n) \
+    do { \
+        ogmaneo::MetricsSink* _metricSink = (cs).getMetricsSink(); \
+        if (_metricSink != nullptr) \
+            _metricSink->count(name, scope, layer, static_cast<uint64_t>(n)); \
+    } while (false)
+
+//! Add n to counter name of the current profile scope and layer
+#define OGMA_METRIC_COUNT(cs, name, n) OGMA_METRIC_COUNT_AT(cs, name, (cs).getProfileScope(), (cs).getProfileLayer(), n)
+#else
+#define OGMA_METRIC_SCOPE(cs, name) do {} while (false)
+#define OGMA_METRIC_COUNT_AT(cs, name, scope, layer, n) do {} while (false)
+#define OGMA_METRIC_COUNT(cs, name, n) do {} while (false)
+#endif
@@ -0,0 +1,164 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#include "Tracer.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <set>
+
+using namespace ogmaneo;
+
+namespace {
+    void writeJsonString(std::ostream &os, const std::string &s) {
+        os << "\"";
+
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                os << "\\" << c;
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                os << escaped;
+            }
+            else
+                os << c;
+        }
+
+        os << "\"";
+    }
+}
+
+Tracer::Tracer(size_t capacity)
+    : _next(0), _total(0)
+{
+    _events.resize(std::max<size_t>(capacity, 1));
+}
+
+int64_t Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int Tracer::getThreadTrack() {
+    static std::atomic<int> nextTrack(_deviceTrack + 1);
+
+    thread_local int track = nextTrack++;
+
+    return track;
+}
+
+void Tracer::addEvent(const char* category, const char* name, int track, int layer, int64_t start, int64_t duration) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Slots are reused, so names only allocate while the buffer fills up
+    Event &e = _events[_next];
+
+    e._name.assign(name);
+    e._category = category;
+    e._track = track;
+    e._layer = layer;
+    e._start = start;
+    e._duration = duration;
+
+    _next = (_next + 1) % _events.size();
+    _total++;
+}
+
+void Tracer::addEvent(const char* category, const std::string &name, int track, int layer, int64_t start, int64_t duration) {
+    addEvent(category, name.c_str(), track, layer, start, duration);
+}
+
+size_t Tracer::getNumEvents() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return std::min(_total, _events.size());
+}
+
+size_t Tracer::getNumDropped() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _total > _events.size() ? _total - _events.size() : 0;
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _next = 0;
+    _total = 0;
+}
+
+bool Tracer::save(const std::string &fileName) const {
+    std::vector<Event> events;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Oldest first
+        if (_total > _events.size()) {
+            events.insert(events.end(), _events.begin() + _next, _events.end());
+            events.insert(events.end(), _events.begin(), _events.begin() + _next);
+        }
+        else
+            events.insert(events.end(), _events.begin(), _events.begin() + _next);
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const Event &left, const Event &right) {
+        return left._start < right._start;
+    });
+
+    std::ofstream os(fileName, std::ios::binary);
+
+    if (!os.is_open())
+        return false;
+
+    // Relative to the first event, Chrome traces are in microseconds
+    int64_t origin = events.empty() ? 0 : events.front()._start;
+
+    std::set<int> tracks;
+
+    for (const Event &e : events)
+        tracks.insert(e._track);
+
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"OgmaNeo\"}}";
+
+    for (int track : tracks) {
+        os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track << ",\"args\":{\"name\":";
+        writeJsonString(os, track == _deviceTrack ? std::string("device") : "host " + std::to_string(track));
+        os << "}}";
+
+        // Device below the host threads
+        os << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track << ",\"args\":{\"sort_index\":" << (track == _deviceTrack ? 1000000 : track) << "}}";
+    }
+
+    os.precision(15);
+
+    for (const Event &e : events) {
+        os << ",\n{\"name\":";
+        writeJsonString(os, e._name);
+        os << ",\"cat\":";
+        writeJsonString(os, e._category != nullptr ? e._category : "");
+        os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e._track
+            << ",\"ts\":" << (e._start - origin) * 0.001
+            << ",\"dur\":" << e._duration * 0.001;
+
+        if (e._layer >= 0)
+            os << ",\"args\":{\"layer\":" << e._layer << "}";
+
+        os << "}";
+    }
+
+    os << "\n]}\n";
+
+    os.close();
+
+    return !os.fail();
+}
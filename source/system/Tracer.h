@@ -0,0 +1,124 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <system/Uncopyable.h>
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ogmaneo {
+    /*!
+    \brief Timeline of host spans and device kernel intervals, saved as a Chrome trace (chrome://tracing, Perfetto)
+    Events are kept in a ring buffer of fixed capacity, so once full the oldest events are overwritten
+    and tracing can stay enabled indefinitely. All times are steady clock nanoseconds (see now).
+    */
+    class Tracer : private Uncopyable {
+    public:
+        /*!
+        \brief Track of device intervals, host threads get their own tracks
+        */
+        static const int _deviceTrack = 0;
+
+        struct Event {
+            std::string _name;
+            const char* _category;
+            int _track;
+            int _layer;
+            int64_t _start;
+            int64_t _duration;
+        };
+
+    private:
+        std::vector<Event> _events;
+
+        /*!
+        \brief Next slot to write, and number of events written in total (including overwritten ones)
+        */
+        size_t _next;
+        size_t _total;
+
+        mutable std::mutex _mutex;
+
+    public:
+        /*!
+        \param capacity maximum number of events kept.
+        */
+        Tracer(size_t capacity);
+
+        /*!
+        \brief Steady clock time in nanoseconds
+        */
+        static int64_t now();
+
+        /*!
+        \brief Track of the calling host thread
+        */
+        static int getThreadTrack();
+
+        /*!
+        \brief Add a complete event (thread safe)
+        \param category static string (not copied).
+        \param layer layer index, -1 if not part of a layer.
+        */
+        void addEvent(const char* category, const char* name, int track, int layer, int64_t start, int64_t duration);
+        void addEvent(const char* category, const std::string &name, int track, int layer, int64_t start, int64_t duration);
+
+        /*!
+        \brief Number of events currently kept
+        */
+        size_t getNumEvents() const;
+
+        /*!
+        \brief Number of events overwritten since the last clear
+        */
+        size_t getNumDropped() const;
+
+        /*!
+        \brief Remove all events
+        */
+        void clear();
+
+        /*!
+        \brief Save the kept events as Chrome trace JSON
+        \return false if the file could not be written.
+        */
+        bool save(const std::string &fileName) const;
+    };
+
+    /*!
+    \brief Records a host span from construction to destruction, does nothing if tracer is nullptr
+    */
+    class TraceScope : private Uncopyable {
+    private:
+        Tracer* _tracer;
+        const char* _category;
+        const char* _name;
+        int _layer;
+        int64_t _start;
+
+    public:
+        /*!
+        \param category, name static strings (not copied).
+        */
+        TraceScope(Tracer* tracer, const char* category, const char* name, int layer = -1)
+            : _tracer(tracer), _category(category), _name(name), _layer(layer), _start(0)
+        {
+            if (_tracer != nullptr)
+                _start = Tracer::now();
+        }
+
+        ~TraceScope() {
+            if (_tracer != nullptr)
+                _tracer->addEvent(_category, _name, Tracer::getThreadTrack(), _layer, _start, Tracer::now() - _start);
+        }
+    };
+}
@@ -0,0 +1,161 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Delta checkpoints merged by compactCheckpoint must match a full checkpoint of the same payloads,
+// also when a tile changes in one delta and goes back to its base bytes in a later one. No device needed
+
+#include "TestUtils.h"
+
+#include "neo/Checkpoint.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace ogmaneo;
+
+namespace {
+    typedef std::vector<std::vector<uint8_t>> Payloads;
+
+    const size_t tileSize = checkpoint::deltaTileSize;
+
+    bool save(const std::string &fileName, const Payloads &payloads, const std::string &metadata, CheckpointBase* recordBase, const CheckpointBase* deltaBase) {
+        CheckpointWriter writer;
+
+        if (recordBase != nullptr)
+            writer.recordBase(recordBase);
+
+        if (deltaBase != nullptr)
+            writer.setDeltaBase(deltaBase);
+
+        if (!writer.open(fileName))
+            return false;
+
+        writer.beginSection();
+
+        for (const std::vector<uint8_t> &payload : payloads)
+            writer.writePayload(payload.data(), payload.size());
+
+        writer.endSection(schemas::CheckpointSectionType_CST_FEATURE_LAYER, 0);
+
+        return writer.finish(reinterpret_cast<const uint8_t*>(metadata.data()), metadata.size());
+    }
+
+    bool readFile(const std::string &fileName, std::vector<uint8_t> &data) {
+        FILE* file = fopen(fileName.c_str(), "rb");
+
+        if (file == nullptr)
+            return false;
+
+        data.clear();
+
+        uint8_t buffer[4096];
+        size_t count;
+
+        while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.insert(data.end(), buffer, buffer + count);
+
+        fclose(file);
+
+        return true;
+    }
+
+    // Payloads, metadata and sections of a full checkpoint file
+    void checkFile(const std::string &fileName, const Payloads &payloads, const std::string &metadata, const char* what) {
+        std::vector<uint8_t> data;
+        CheckpointReader reader;
+
+        if (!readFile(fileName, data) || !reader.open(data.data(), data.size()) || reader.isDelta()) {
+            OGMA_CHECK(false, what);
+
+            return;
+        }
+
+        OGMA_CHECK(reader.getNumPayloads() == payloads.size(), what);
+
+        for (uint32_t i = 0; i < reader.getNumPayloads() && i < payloads.size(); i++) {
+            size_t size;
+            const uint8_t* payload = reader.getPayload(i, size);
+
+            OGMA_CHECK(size == payloads[i].size() && memcmp(payload, payloads[i].data(), size) == 0, what);
+        }
+
+        OGMA_CHECK(std::string(reinterpret_cast<const char*>(reader.getMetadata()), reader.getMetadataSize()) == metadata, what);
+
+        OGMA_CHECK(reader.getNumSections() == 1 && reader.getSection(0)->numPayloads() == payloads.size(), what);
+    }
+}
+
+int main() {
+    // Three tiles, one tile, and a payload that grows
+    Payloads state0(3);
+
+    state0[0].assign(3 * tileSize, 0);
+    state0[1].assign(tileSize / 2, 1);
+    state0[2].assign(100, 2);
+
+    for (size_t i = 0; i < state0[0].size(); i++)
+        state0[0][i] = static_cast<uint8_t>(i % 2);
+
+    CheckpointBase base;
+
+    OGMA_CHECK(save("DeltaTest.base", state0, "state0", &base, nullptr), "save base");
+
+    // Tile 1 of payload 0 and payload 1 change
+    Payloads state1 = state0;
+
+    state1[0][tileSize + 5] ^= 1;
+    state1[1][3] = 7;
+
+    OGMA_CHECK(save("DeltaTest.delta1", state1, "state1", nullptr, &base), "save delta1");
+
+    // Tile 1 of payload 0 goes back to its base bytes, tile 2 changes, payload 2 grows
+    Payloads state2 = state1;
+
+    state2[0][tileSize + 5] ^= 1;
+    state2[0][2 * tileSize] ^= 1;
+    state2[2].assign(tileSize + 10, 3);
+
+    OGMA_CHECK(save("DeltaTest.delta2", state2, "state2", nullptr, &base), "save delta2");
+
+    OGMA_CHECK(save("DeltaTest.full", state2, "state2", nullptr, nullptr), "save full");
+
+    std::vector<std::string> deltas;
+    deltas.push_back("DeltaTest.delta1");
+
+    OGMA_CHECK(compactCheckpoint("DeltaTest.base", deltas, "DeltaTest.compact"), "compact delta1");
+    checkFile("DeltaTest.compact", state1, "state1", "base + delta1");
+
+    deltas.push_back("DeltaTest.delta2");
+
+    OGMA_CHECK(compactCheckpoint("DeltaTest.base", deltas, "DeltaTest.compact"), "compact delta1 delta2");
+    checkFile("DeltaTest.compact", state2, "state2", "base + delta1 + delta2");
+    checkFile("DeltaTest.full", state2, "state2", "full save");
+
+    OGMA_CHECK(compactCheckpoint("DeltaTest.base", std::vector<std::string>(), "DeltaTest.compact"), "compact base only");
+    checkFile("DeltaTest.compact", state0, "state0", "base only");
+
+    // A delta of another base is rejected
+    CheckpointBase otherBase;
+
+    OGMA_CHECK(save("DeltaTest.otherBase", state0, "state0", &otherBase, nullptr), "save other base");
+    OGMA_CHECK(save("DeltaTest.otherDelta", state1, "state1", nullptr, &otherBase), "save other delta");
+
+    deltas.push_back("DeltaTest.otherDelta");
+
+    OGMA_CHECK(!compactCheckpoint("DeltaTest.base", deltas, "DeltaTest.compact"), "delta of another base");
+
+    const char* fileNames[] = { "DeltaTest.base", "DeltaTest.delta1", "DeltaTest.delta2", "DeltaTest.full", "DeltaTest.compact",
+        "DeltaTest.otherBase", "DeltaTest.otherDelta" };
+
+    for (const char* fileName : fileNames)
+        remove(fileName);
+
+    return test::result();
+}
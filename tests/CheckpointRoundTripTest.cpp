@@ -0,0 +1,200 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Save, load into a fresh hierarchy and compare, for every file format: plain, streaming checkpoints
+// (full, compact, compressed), merged delta checkpoints and quantized inference exports.
+// Needs an OpenCL device, skipped without one.
+
+#include "TestUtils.h"
+
+#include "neo/Architect.h"
+#include "neo/Checkpoint.h"
+#include "neo/Hierarchy.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace ogmaneo;
+
+namespace {
+    const int inputSize = 16;
+
+    std::shared_ptr<Hierarchy> generate(const std::shared_ptr<Resources> &res, unsigned int seed) {
+        Architect arch;
+        arch.initialize(seed, res);
+
+        arch.addInputLayer(Vec2i(inputSize, inputSize))
+            .setValue("sfc_ff_radius", "4")
+            .setValue("sfc_ff_numSamples", "2");
+
+        arch.addHigherLayer(Vec2i(24, 24), _chunk)
+            .setValue("sfc_chunkSize", Vec2i(6, 6))
+            .setValue("sfc_ff_radius", "4")
+            .setValue("sfc_ff_numSamples", "2")
+            .setValue("p_radius", "4");
+
+        arch.addHigherLayer(Vec2i(16, 16), _distance)
+            .setValue("sfd_chunkSize", Vec2i(4, 4))
+            .setValue("sfd_ff_radius", "4")
+            .setValue("sfd_ff_numSamples", "2")
+            .setValue("p_radius", "4");
+
+        return arch.generateHierarchy();
+    }
+
+    std::vector<ValueField2D> frame(int t) {
+        ValueField2D input(Vec2i(inputSize, inputSize));
+
+        for (int y = 0; y < inputSize; y++)
+            for (int x = 0; x < inputSize; x++)
+                input.setValue(Vec2i(x, y), 0.5f + 0.5f * std::sin(0.4f * x + 0.3f * y + 0.25f * t));
+
+        return std::vector<ValueField2D>(1, input);
+    }
+
+    void step(Hierarchy &h, int t, bool learn) {
+        std::vector<ValueField2D> inputs = frame(t);
+
+        h.activate(inputs);
+
+        if (learn)
+            h.learn(inputs);
+    }
+
+    // Mean absolute difference of the predictions of the next steps, stepping both hierarchies alike
+    float compare(Hierarchy &expected, Hierarchy &actual, int t, bool learn) {
+        double sumError = 0.0;
+        size_t numValues = 0;
+
+        for (int s = 0; s < 8; s++) {
+            step(expected, t + s, learn);
+            step(actual, t + s, learn);
+
+            const std::vector<float> &e = expected.getPredictions()[0].getData();
+            const std::vector<float> &a = actual.getPredictions()[0].getData();
+
+            for (size_t i = 0; i < e.size(); i++)
+                sumError += std::abs(e[i] - a[i]);
+
+            numValues += e.size();
+        }
+
+        return static_cast<float>(sumError / numValues);
+    }
+
+    // Load fileName into a hierarchy of another seed, then check it behaves like h (which is stepped too)
+    void checkLoad(const std::shared_ptr<Resources> &res, Hierarchy &h, const std::string &fileName, int t, bool learn, float tolerance, const char* what) {
+        std::shared_ptr<Hierarchy> loaded = generate(res, 4321);
+
+        try {
+            if (!loaded->load(*res->getComputeSystem(), fileName)) {
+                fprintf(stderr, "%s: unable to read %s\n", what, fileName.c_str());
+
+                OGMA_CHECK(false, what);
+
+                return;
+            }
+        }
+        catch (const std::exception &e) {
+            fprintf(stderr, "%s: %s\n", what, e.what());
+
+            OGMA_CHECK(false, what);
+
+            return;
+        }
+
+        float error = compare(h, *loaded, t, learn);
+
+        if (error > tolerance)
+            fprintf(stderr, "%s: mean prediction error %f\n", what, error);
+
+        OGMA_CHECK(error <= tolerance, what);
+    }
+}
+
+int main() {
+    std::shared_ptr<Resources> res = std::make_shared<Resources>(ComputeSystem::_all);
+
+    ComputeSystem &cs = *res->getComputeSystem();
+
+    if (cs.getDevice()() == nullptr) {
+        printf("Skipped: no OpenCL device\n");
+        return test::skipped;
+    }
+
+    std::shared_ptr<Hierarchy> h = generate(res, 1234);
+
+    int t = 0;
+
+    for (; t < 50; t++)
+        step(*h, t, true);
+
+    // Lossless formats continue exactly, learning included
+    OGMA_CHECK(h->save(cs, "RoundTrip.ohr"), "save");
+    checkLoad(res, *h, "RoundTrip.ohr", t, true, 0.0f, "plain");
+    t += 8;
+
+    OGMA_CHECK(h->saveCheckpoint(cs, "RoundTrip.ock"), "saveCheckpoint");
+    checkLoad(res, *h, "RoundTrip.ock", t, true, 0.0f, "streaming");
+    t += 8;
+
+    OGMA_CHECK(h->saveCheckpoint(cs, "RoundTrip.ock", true), "saveCheckpoint compact");
+    checkLoad(res, *h, "RoundTrip.ock", t, true, 0.0f, "compact");
+    t += 8;
+
+    OGMA_CHECK(h->saveCheckpoint(cs, "RoundTrip.ock", true, true), "saveCheckpoint compressed");
+    checkLoad(res, *h, "RoundTrip.ock", t, true, 0.0f, "compressed");
+    t += 8;
+
+    // A base, deltas after learning and after not learning, merged back
+    OGMA_CHECK(h->saveBaseCheckpoint(cs, "RoundTrip.base"), "saveBaseCheckpoint");
+
+    for (int s = 0; s < 10; s++, t++)
+        step(*h, t, true);
+
+    OGMA_CHECK(h->saveDeltaCheckpoint(cs, "RoundTrip.delta0"), "saveDeltaCheckpoint");
+
+    for (int s = 0; s < 3; s++, t++)
+        step(*h, t, false);
+
+    OGMA_CHECK(h->saveDeltaCheckpoint(cs, "RoundTrip.delta1"), "saveDeltaCheckpoint unchanged");
+
+    std::vector<std::string> deltas;
+    deltas.push_back("RoundTrip.delta0");
+    deltas.push_back("RoundTrip.delta1");
+
+    OGMA_CHECK(compactCheckpoint("RoundTrip.base", deltas, "RoundTrip.ock"), "compactCheckpoint");
+    checkLoad(res, *h, "RoundTrip.ock", t, true, 0.0f, "delta");
+    t += 8;
+
+    // Inference exports only activate, quantization bounds how far the predictions drift
+    OGMA_CHECK(h->exportInference(cs, "RoundTrip.fp32", _float32), "exportInference fp32");
+    checkLoad(res, *h, "RoundTrip.fp32", t, false, 0.0f, "inference fp32");
+    t += 8;
+
+    OGMA_CHECK(h->exportInference(cs, "RoundTrip.fp16", _float16), "exportInference fp16");
+    checkLoad(res, *h, "RoundTrip.fp16", t, false, 0.01f, "inference fp16");
+    t += 8;
+
+    OGMA_CHECK(h->exportInference(cs, "RoundTrip.int8", _int8), "exportInference int8");
+    checkLoad(res, *h, "RoundTrip.int8", t, false, 0.05f, "inference int8");
+    t += 8;
+
+    const char* fileNames[] = { "RoundTrip.ohr", "RoundTrip.ock", "RoundTrip.base", "RoundTrip.delta0", "RoundTrip.delta1",
+        "RoundTrip.fp32", "RoundTrip.fp16", "RoundTrip.int8" };
+
+    for (const char* fileName : fileNames)
+        remove(fileName);
+
+    return test::result();
+}
@@ -0,0 +1,124 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Round trips of compressPixels/decompressPixels, no device needed
+
+#include "TestUtils.h"
+
+#include "neo/Helpers.h"
+
+#include <random>
+
+using namespace ogmaneo;
+
+namespace {
+    // Must match compressedBlockSize of Helpers.cpp
+    const size_t blockSize = 64 * 1024;
+
+    void roundTrip(const char* name, const std::vector<uint8_t> &data, size_t stride) {
+        std::vector<uint8_t> compressed;
+
+        compressPixels(data.data(), data.size(), stride, compressed);
+
+        std::vector<uint8_t> decompressed(data.size(), 0xcd);
+
+        OGMA_CHECK(decompressPixels(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()), name);
+        OGMA_CHECK(decompressed == data, name);
+
+        // Truncated or resized inputs are rejected, not read past
+        if (!compressed.empty())
+            OGMA_CHECK(!decompressPixels(compressed.data(), compressed.size() - 1, decompressed.data(), decompressed.size()), name);
+
+        std::vector<uint8_t> larger(data.size() + 1);
+
+        OGMA_CHECK(!decompressPixels(compressed.data(), compressed.size(), larger.data(), larger.size()), name);
+    }
+}
+
+int main() {
+    std::mt19937 generator(1234);
+    std::uniform_int_distribution<int> byteDist(0, 255);
+
+    // Empty input, a header only
+    {
+        std::vector<uint8_t> empty;
+        std::vector<uint8_t> compressed;
+
+        compressPixels(empty.data(), 0, 4, compressed);
+
+        OGMA_CHECK(!compressed.empty(), "empty");
+        OGMA_CHECK(decompressPixels(compressed.data(), compressed.size(), nullptr, 0), "empty");
+
+        roundTrip("empty", empty, 4);
+    }
+
+    // Compressible floats, with a short final block that is not a multiple of the stride
+    {
+        std::vector<uint8_t> data(3 * blockSize + 4 * 1000 + 3);
+
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = (i % 4 == 3) ? 0x3f : (i / 4096) & 0xff;
+
+        std::vector<uint8_t> compressed;
+
+        compressPixels(data.data(), data.size(), 4, compressed);
+
+        OGMA_CHECK(compressed.size() < data.size(), "compressible");
+
+        roundTrip("short final block", data, 4);
+        roundTrip("single byte", std::vector<uint8_t>(1, 7), 4);
+        roundTrip("no shuffle", data, 1);
+    }
+
+    // Incompressible data, stored raw
+    {
+        std::vector<uint8_t> data(2 * blockSize + 123);
+
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = static_cast<uint8_t>(byteDist(generator));
+
+        std::vector<uint8_t> compressed;
+
+        compressPixels(data.data(), data.size(), 4, compressed);
+
+        // Raw blocks only cost their sizes and the header
+        OGMA_CHECK(compressed.size() <= data.size() + 64, "incompressible");
+
+        roundTrip("incompressible", data, 4);
+    }
+
+    // Runs at the limits of the encoding, longer than a run and a literal sequence
+    {
+        std::vector<uint8_t> data;
+
+        for (size_t length = 1; length < 400; length += 37) {
+            data.insert(data.end(), length, static_cast<uint8_t>(length));
+
+            for (size_t i = 0; i < length; i++)
+                data.push_back(static_cast<uint8_t>(byteDist(generator)));
+        }
+
+        roundTrip("mixed runs", data, 1);
+        roundTrip("mixed runs, stride 2", data, 2);
+    }
+
+    // Corrupt inputs
+    {
+        std::vector<uint8_t> data(blockSize / 2, 0);
+        std::vector<uint8_t> compressed;
+
+        compressPixels(data.data(), data.size(), 4, compressed);
+
+        std::vector<uint8_t> decompressed(data.size());
+
+        OGMA_CHECK(!decompressPixels(nullptr, 0, decompressed.data(), decompressed.size()), "null input");
+        OGMA_CHECK(!decompressPixels(compressed.data(), 4, decompressed.data(), decompressed.size()), "short header");
+    }
+
+    return test::result();
+}
@@ -0,0 +1,202 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Error bounds of quantizeWeights/dequantizeWeights, and the float16 conversion of special values, no device needed
+
+#include "TestUtils.h"
+
+#include "neo/Helpers.h"
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+using namespace ogmaneo;
+
+namespace {
+    std::vector<float> roundTrip(const std::vector<float> &weights, size_t numUnits, size_t numChannels, size_t depth, WeightPrecision precision) {
+        std::vector<uint8_t> quantized;
+
+        quantizeWeights(weights.data(), numUnits, numChannels, depth, precision, quantized);
+
+        std::vector<float> dequantized(weights.size(), -1.0f);
+
+        OGMA_CHECK(dequantizeWeights(quantized.data(), quantized.size(), numUnits, numChannels, depth, precision, dequantized.data()), "dequantize");
+
+        // Sizes of the other precisions are rejected
+        OGMA_CHECK(!dequantizeWeights(quantized.data(), quantized.size() + 1, numUnits, numChannels, depth, precision, dequantized.data()), "size");
+
+        return dequantized;
+    }
+
+    float toHalfAndBack(float value) {
+        return roundTrip(std::vector<float>(1, value), 1, 1, 1, _float16)[0];
+    }
+
+    uint32_t bitsOf(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        return bits;
+    }
+}
+
+int main() {
+    std::mt19937 generator(1234);
+
+    // int8: per unit ranges, the error of a weight is at most half a step of its unit
+    {
+        const size_t numUnits = 37;
+        const size_t numChannels = 5;
+        const size_t depth = 3;
+
+        std::vector<float> weights(numUnits * numChannels * depth);
+        std::vector<float> minima(numUnits, std::numeric_limits<float>::max());
+        std::vector<float> maxima(numUnits, -std::numeric_limits<float>::max());
+
+        for (size_t z = 0; z < depth; z++)
+            for (size_t u = 0; u < numUnits; u++) {
+                // Units of very different magnitudes and offsets, unit 0 all zero
+                std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+                float magnitude = u == 0 ? 0.0f : std::pow(10.0f, static_cast<float>(u % 7) - 3.0f);
+                float offset = static_cast<float>(u % 3) * magnitude;
+
+                for (size_t c = 0; c < numChannels; c++) {
+                    float w = offset + dist(generator) * magnitude;
+
+                    weights[(z * numUnits + u) * numChannels + c] = w;
+
+                    minima[u] = std::min(minima[u], w);
+                    maxima[u] = std::max(maxima[u], w);
+                }
+            }
+
+        std::vector<float> dequantized = roundTrip(weights, numUnits, numChannels, depth, _int8);
+
+        for (size_t z = 0; z < depth; z++)
+            for (size_t u = 0; u < numUnits; u++)
+                for (size_t c = 0; c < numChannels; c++) {
+                    size_t i = (z * numUnits + u) * numChannels + c;
+
+                    float bound = (maxima[u] - minima[u]) / 510.0f * (1.0f + 1e-5f) + std::max(std::abs(minima[u]), std::abs(maxima[u])) * 1e-6f;
+
+                    OGMA_CHECK(std::abs(dequantized[i] - weights[i]) <= bound, "int8 error bound");
+                }
+
+        // The extremes of a unit are exact up to float rounding
+        std::vector<float> extremes(2);
+        extremes[0] = -0.75f;
+        extremes[1] = 0.5f;
+
+        std::vector<float> dequantizedExtremes = roundTrip(extremes, 1, 2, 1, _int8);
+
+        OGMA_CHECK(std::abs(dequantizedExtremes[0] + 0.75f) < 1e-6f && std::abs(dequantizedExtremes[1] - 0.5f) < 1e-6f, "int8 extremes");
+
+        // A narrow unit near 1 (as chunk weights start) keeps the ordering of its weights
+        std::vector<float> narrow(16);
+
+        for (size_t c = 0; c < narrow.size(); c++)
+            narrow[c] = 0.999f + 0.001f * static_cast<float>((c * 7) % narrow.size()) / (narrow.size() - 1);
+
+        std::vector<float> dequantizedNarrow = roundTrip(narrow, 1, narrow.size(), 1, _int8);
+
+        for (size_t c0 = 0; c0 < narrow.size(); c0++)
+            for (size_t c1 = 0; c1 < narrow.size(); c1++) {
+                if (narrow[c0] < narrow[c1])
+                    OGMA_CHECK(dequantizedNarrow[c0] < dequantizedNarrow[c1], "int8 narrow ordering");
+            }
+    }
+
+    // float16: relative error of normal values is at most 2^-11
+    {
+        std::uniform_real_distribution<float> dist(-60000.0f, 60000.0f);
+
+        std::vector<float> weights(1000);
+
+        for (size_t i = 0; i < weights.size(); i++)
+            weights[i] = dist(generator) * std::pow(2.0f, -static_cast<float>(i % 24));
+
+        std::vector<float> dequantized = roundTrip(weights, 10, 10, 10, _float16);
+
+        for (size_t i = 0; i < weights.size(); i++) {
+            if (std::abs(weights[i]) >= std::pow(2.0f, -14.0f))
+                OGMA_CHECK(std::abs(dequantized[i] - weights[i]) <= std::abs(weights[i]) * std::pow(2.0f, -11.0f), "fp16 error bound");
+        }
+    }
+
+    // float16: every half value survives a round trip through float (NaN payloads are not kept)
+    {
+        std::vector<uint8_t> halves(65536 * sizeof(uint16_t));
+
+        for (uint32_t h = 0; h < 65536; h++) {
+            uint16_t half = static_cast<uint16_t>(h);
+
+            memcpy(halves.data() + h * sizeof(uint16_t), &half, sizeof(uint16_t));
+        }
+
+        std::vector<float> values(65536);
+
+        OGMA_CHECK(dequantizeWeights(halves.data(), halves.size(), 65536, 1, 1, _float16, values.data()), "all halves");
+
+        std::vector<uint8_t> requantized;
+
+        quantizeWeights(values.data(), 65536, 1, 1, _float16, requantized);
+
+        for (uint32_t h = 0; h < 65536; h++) {
+            uint16_t half;
+            memcpy(&half, requantized.data() + h * sizeof(uint16_t), sizeof(uint16_t));
+
+            bool isNaN = (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+
+            if (isNaN)
+                OGMA_CHECK(std::isnan(values[h]) && (half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0, "fp16 NaN");
+            else
+                OGMA_CHECK(half == h, "fp16 exact round trip");
+        }
+    }
+
+    // float16: special values
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+
+        OGMA_CHECK(toHalfAndBack(inf) == inf, "inf");
+        OGMA_CHECK(toHalfAndBack(-inf) == -inf, "-inf");
+        OGMA_CHECK(std::isnan(toHalfAndBack(std::numeric_limits<float>::quiet_NaN())), "NaN");
+
+        // Overflow, the largest half is 65504, 65520 is halfway to the next (inf) and rounds to even
+        OGMA_CHECK(toHalfAndBack(65504.0f) == 65504.0f, "largest half");
+        OGMA_CHECK(toHalfAndBack(65519.0f) == 65504.0f, "below overflow");
+        OGMA_CHECK(toHalfAndBack(65520.0f) == inf, "overflow");
+        OGMA_CHECK(toHalfAndBack(-1e10f) == -inf, "-overflow");
+
+        // Half denormals, down to 2^-24
+        const float smallest = std::pow(2.0f, -24.0f);
+
+        OGMA_CHECK(toHalfAndBack(smallest) == smallest, "smallest denormal");
+        OGMA_CHECK(toHalfAndBack(-3.0f * smallest) == -3.0f * smallest, "denormal");
+        OGMA_CHECK(toHalfAndBack(1023.0f * smallest) == 1023.0f * smallest, "largest denormal");
+        OGMA_CHECK(toHalfAndBack(std::pow(2.0f, -14.0f)) == std::pow(2.0f, -14.0f), "smallest normal");
+
+        // Rounding to the nearest denormal, ties to even
+        OGMA_CHECK(toHalfAndBack(1.4f * smallest) == smallest, "round down");
+        OGMA_CHECK(toHalfAndBack(1.6f * smallest) == 2.0f * smallest, "round up");
+        OGMA_CHECK(toHalfAndBack(2.5f * smallest) == 2.0f * smallest, "tie to even");
+        OGMA_CHECK(toHalfAndBack(0.5f * smallest) == 0.0f, "tie to zero");
+        OGMA_CHECK(toHalfAndBack(0.75f * smallest) == smallest, "above tie");
+
+        // Underflow keeps the sign, float denormals included
+        OGMA_CHECK(bitsOf(toHalfAndBack(-1e-10f)) == 0x80000000u, "-underflow");
+        OGMA_CHECK(bitsOf(toHalfAndBack(1e-40f)) == 0u, "float denormal");
+        OGMA_CHECK(bitsOf(toHalfAndBack(-0.0f)) == 0x80000000u, "-0");
+    }
+
+    return test::result();
+}
@@ -0,0 +1,48 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+
+/*!
+\brief Minimal checks shared by the unit tests, registered with CTest (OGMANEO_BUILD_TESTS)
+A failed check is reported and the test continues, test::result gives the exit code.
+Tests that need an OpenCL device exit with test::skipped when none is available.
+*/
+namespace test {
+    inline int &numFailures() {
+        static int failures = 0;
+
+        return failures;
+    }
+
+    inline void check(bool condition, const char* expression, const char* what, const char* file, int line) {
+        if (!condition) {
+            fprintf(stderr, "%s:%d: check failed (%s): %s\n", file, line, what, expression);
+
+            numFailures()++;
+        }
+    }
+
+    //! Exit code of a main that checked, 1 if any check failed
+    inline int result() {
+        if (numFailures() > 0) {
+            fprintf(stderr, "%d checks failed\n", numFailures());
+
+            return 1;
+        }
+
+        return 0;
+    }
+
+    //! CTest SKIP_RETURN_CODE of the tests
+    const int skipped = 77;
+}
+
+#define OGMA_CHECK(condition, what) test::check((condition), #condition, (what), __FILE__, __LINE__)
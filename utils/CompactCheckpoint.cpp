@@ -0,0 +1,35 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Merges a base checkpoint and delta checkpoints (see Hierarchy::saveDeltaCheckpoint)
+// into a full checkpoint, that Hierarchy::load can read
+
+#include "neo/Checkpoint.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <base> <delta> [<delta> ...] <output>\n", argv[0]);
+        fprintf(stderr, "Deltas are given oldest first. Each holds all changes since the base, so the last one gives the state.\n");
+        return 1;
+    }
+
+    std::string baseFileName(argv[1]);
+    std::vector<std::string> deltaFileNames(argv + 2, argv + argc - 1);
+    std::string fileName(argv[argc - 1]);
+
+    if (!ogmaneo::compactCheckpoint(baseFileName, deltaFileNames, fileName)) {
+        fprintf(stderr, "Unable to compact %s and its deltas into %s\n", baseFileName.c_str(), fileName.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+// ----------------------------------------------------------------------------
+//  OgmaNeo
+//  Copyright(c) 2016-2017 Ogma Intelligent Systems Corp. All rights reserved.
+//
+//  This copy of OgmaNeo is licensed to you under the terms described
+//  in the OGMANEO_LICENSE.md file included in this distribution.
+// ----------------------------------------------------------------------------
+
+// Exports a hierarchy as an inference-only model (see Hierarchy::exportInference), then runs
+// the float and the exported model side by side on a recorded sequence and reports how far
+// their predictions drift apart
+
+#include "neo/Architect.h"
+#include "neo/Hierarchy.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "Usage: %s <architecture> <model> <sequence> <int8|fp16> [<export>]\n", argv[0]);
+        fprintf(stderr, "The sequence is raw float32 frames, each holding every input layer (row major) in order.\n");
+        return 1;
+    }
+
+    std::string precisionName(argv[4]);
+
+    ogmaneo::WeightPrecision precision;
+
+    if (precisionName == "int8")
+        precision = ogmaneo::_int8;
+    else if (precisionName == "fp16")
+        precision = ogmaneo::_float16;
+    else {
+        fprintf(stderr, "Unknown precision %s\n", precisionName.c_str());
+        return 1;
+    }
+
+    std::string exportFileName = argc == 6 ? std::string(argv[5]) : std::string(argv[2]) + "." + precisionName;
+
+    std::shared_ptr<ogmaneo::Resources> res = std::make_shared<ogmaneo::Resources>(ogmaneo::ComputeSystem::_gpu);
+
+    ogmaneo::ComputeSystem &cs = *res->getComputeSystem();
+
+    ogmaneo::Architect arch;
+    arch.initialize(1234, res);
+    arch.load(argv[1]);
+
+    std::shared_ptr<ogmaneo::Hierarchy> model = arch.generateHierarchy();
+    std::shared_ptr<ogmaneo::Hierarchy> inference = arch.generateHierarchy();
+
+    try {
+        if (!model->load(cs, argv[2])) {
+            fprintf(stderr, "Unable to read %s\n", argv[2]);
+            return 1;
+        }
+
+        if (!model->exportInference(cs, exportFileName, precision)) {
+            fprintf(stderr, "Unable to write %s\n", exportFileName.c_str());
+            return 1;
+        }
+
+        if (!inference->load(cs, exportFileName)) {
+            fprintf(stderr, "Unable to read %s\n", exportFileName.c_str());
+            return 1;
+        }
+    }
+    catch (const std::exception &e) {
+        // The model does not match the architecture
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    FILE* sequence = fopen(argv[3], "rb");
+
+    if (sequence == nullptr) {
+        fprintf(stderr, "Unable to open %s\n", argv[3]);
+        return 1;
+    }
+
+    std::vector<ogmaneo::ValueField2D> inputs;
+
+    for (int i = 0; i < model->getNumInputs(); i++)
+        inputs.push_back(ogmaneo::ValueField2D(model->getInputSize(i)));
+
+    size_t numSteps = 0;
+    size_t numValues = 0;
+    double sumError = 0.0;
+    double sumSquaredError = 0.0;
+    float maxError = 0.0f;
+
+    for (;;) {
+        bool complete = true;
+
+        for (ogmaneo::ValueField2D &input : inputs)
+            complete = complete && fread(input.getData().data(), sizeof(float), input.getData().size(), sequence) == input.getData().size();
+
+        if (!complete)
+            break;
+
+        model->activate(inputs);
+        inference->activate(inputs);
+
+        float stepMaxError = 0.0f;
+
+        for (int i = 0; i < model->getNumInputs(); i++) {
+            const std::vector<float> &expected = model->getPredictions()[i].getData();
+            const std::vector<float> &actual = inference->getPredictions()[i].getData();
+
+            for (size_t j = 0; j < expected.size(); j++) {
+                float error = std::abs(expected[j] - actual[j]);
+
+                sumError += error;
+                sumSquaredError += static_cast<double>(error) * error;
+                stepMaxError = std::max(stepMaxError, error);
+            }
+
+            numValues += expected.size();
+        }
+
+        maxError = std::max(maxError, stepMaxError);
+
+        printf("%zu %f\n", numSteps, stepMaxError);
+
+        numSteps++;
+    }
+
+    fclose(sequence);
+
+    if (numSteps == 0) {
+        fprintf(stderr, "%s holds no complete frame\n", argv[3]);
+        return 1;
+    }
+
+    printf("Steps: %zu\n", numSteps);
+    printf("Mean absolute error: %f\n", sumError / numValues);
+    printf("RMS error: %f\n", std::sqrt(sumSquaredError / numValues));
+    printf("Max absolute error: %f\n", maxError);
+
+    return 0;
+}